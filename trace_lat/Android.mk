@@ -0,0 +1,20 @@
+LOCAL_PATH:= $(call my-dir)
+
+#
+# wl12xx data path latency analyzer, runs on the target or the host
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := trace_lat.c
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := wl12xx_trace_lat
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := trace_lat.c
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := wl12xx_trace_lat
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,414 @@
+/*
+ * Per-frame latency breakdown of the wl12xx data path
+ *
+ * Reads the text of an ftrace recording of the wl12xx events and reports
+ * where each frame spent its time:
+ *
+ * TX  queue  op_tx enqueue -> descriptor prepared by the TX work
+ *     bus    prepared -> burst written to the chip
+ *     fw     burst written -> TX result read back
+ * RX  bus    FW status read -> RX burst read
+ *     drv    burst read -> frame parsed
+ *     stack  frame parsed -> handed to mac80211
+ *
+ * Recording:
+ *   echo 1 > /sys/kernel/debug/tracing/events/wl12xx/enable
+ *   cat /sys/kernel/debug/tracing/trace_pipe > wl12xx.trace
+ *   wl12xx_trace_lat [-v] wl12xx.trace
+ *
+ * With -v every completed frame is printed, otherwise only the per-stage
+ * summary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#define HASH_SIZE	4096
+#define MAX_PENDING	256
+
+enum stage {
+	TX_QUEUE,
+	TX_BUS,
+	TX_FW,
+	TX_TOTAL,
+	RX_BUS,
+	RX_DRV,
+	RX_STACK,
+	RX_TOTAL,
+	STAGE_MAX
+};
+
+static const char * const stage_names[STAGE_MAX] = {
+	[TX_QUEUE]	= "tx queue",
+	[TX_BUS]	= "tx bus",
+	[TX_FW]		= "tx fw",
+	[TX_TOTAL]	= "tx total",
+	[RX_BUS]	= "rx bus",
+	[RX_DRV]	= "rx drv",
+	[RX_STACK]	= "rx stack",
+	[RX_TOTAL]	= "rx total",
+};
+
+/* a frame in flight, timestamps in seconds, 0 when not seen yet */
+struct frame {
+	unsigned long long skb;
+	unsigned int len;
+	double t[4];
+	struct frame *next;
+};
+
+struct samples {
+	double *val;
+	size_t num;
+	size_t size;
+};
+
+static struct frame *tx_frames[HASH_SIZE];
+static struct frame *rx_frames[HASH_SIZE];
+static struct samples stats[STAGE_MAX];
+
+/* prepared TX frames waiting for their burst to be written */
+static struct frame *tx_pending[MAX_PENDING];
+static int num_pending;
+
+static double last_irq, last_rx_read;
+static bool verbose;
+static unsigned long lost_frames;
+
+static unsigned int hash(unsigned long long skb)
+{
+	return (skb ^ (skb >> 12) ^ (skb >> 24)) % HASH_SIZE;
+}
+
+static struct frame *frame_find(struct frame **table, unsigned long long skb,
+				bool unlink)
+{
+	struct frame **p = &table[hash(skb)];
+	struct frame *f;
+
+	for (; *p; p = &(*p)->next) {
+		f = *p;
+		if (f->skb != skb)
+			continue;
+		if (unlink)
+			*p = f->next;
+		return f;
+	}
+
+	return NULL;
+}
+
+static struct frame *frame_add(struct frame **table, unsigned long long skb)
+{
+	struct frame *f;
+	unsigned int h = hash(skb);
+
+	/* the skb was freed and reused without us seeing the end */
+	f = frame_find(table, skb, true);
+	if (f)
+		lost_frames++;
+	else
+		f = malloc(sizeof(*f));
+	if (!f) {
+		perror("malloc");
+		exit(1);
+	}
+
+	memset(f, 0, sizeof(*f));
+	f->skb = skb;
+	f->next = table[h];
+	table[h] = f;
+	return f;
+}
+
+static void sample_add(enum stage stage, double start, double end)
+{
+	struct samples *s = &stats[stage];
+
+	if (start == 0 || end < start)
+		return;
+
+	if (s->num == s->size) {
+		s->size = s->size ? s->size * 2 : 1024;
+		s->val = realloc(s->val, s->size * sizeof(*s->val));
+		if (!s->val) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+
+	s->val[s->num++] = (end - start) * 1000000;
+}
+
+/* value of " key:" in the event fields */
+static bool field(const char *fields, const char *key,
+		  unsigned long long *val, int base)
+{
+	char pattern[32];
+	const char *p;
+	char *end;
+
+	snprintf(pattern, sizeof(pattern), " %s:", key);
+	p = strstr(fields, pattern);
+	if (!p)
+		return false;
+
+	*val = strtoull(p + strlen(pattern), &end, base);
+	return end != p + strlen(pattern);
+}
+
+static void tx_enqueue(double ts, const char *fields)
+{
+	unsigned long long skb, len = 0;
+	struct frame *f;
+
+	if (!field(fields, "skb", &skb, 16))
+		return;
+
+	field(fields, "len", &len, 10);
+	f = frame_add(tx_frames, skb);
+	f->len = len;
+	f->t[0] = ts;
+}
+
+static void tx_prepare(double ts, const char *fields)
+{
+	unsigned long long skb;
+	struct frame *f;
+
+	if (!field(fields, "skb", &skb, 16))
+		return;
+
+	/* enqueued before the recording started */
+	f = frame_find(tx_frames, skb, false);
+	if (!f)
+		f = frame_add(tx_frames, skb);
+
+	f->t[1] = ts;
+	if (num_pending < MAX_PENDING)
+		tx_pending[num_pending++] = f;
+}
+
+static void tx_burst(double ts)
+{
+	int i;
+
+	for (i = 0; i < num_pending; i++)
+		tx_pending[i]->t[2] = ts;
+	num_pending = 0;
+}
+
+static void tx_complete(double ts, const char *fields)
+{
+	unsigned long long skb, status = 0;
+	struct frame *f;
+	int i;
+
+	if (!field(fields, "skb", &skb, 16))
+		return;
+
+	f = frame_find(tx_frames, skb, true);
+	if (!f)
+		return;
+
+	/* completed before its burst was traced, don't leave it dangling */
+	for (i = 0; i < num_pending; i++) {
+		if (tx_pending[i] == f) {
+			tx_pending[i] = tx_pending[--num_pending];
+			break;
+		}
+	}
+
+	f->t[3] = ts;
+	field(fields, "status", &status, 10);
+
+	sample_add(TX_QUEUE, f->t[0], f->t[1]);
+	sample_add(TX_BUS, f->t[1], f->t[2]);
+	sample_add(TX_FW, f->t[2], f->t[3]);
+	sample_add(TX_TOTAL, f->t[0], f->t[3]);
+
+	if (verbose && f->t[0] && f->t[1] && f->t[2])
+		printf("%.6f tx skb %llx len %u status %llu queue %.0f "
+		       "bus %.0f fw %.0f us\n", ts, skb, f->len, status,
+		       (f->t[1] - f->t[0]) * 1000000,
+		       (f->t[2] - f->t[1]) * 1000000,
+		       (f->t[3] - f->t[2]) * 1000000);
+	free(f);
+}
+
+static void rx_frame(double ts, const char *fields)
+{
+	unsigned long long skb, len = 0;
+	struct frame *f;
+
+	if (!field(fields, "skb", &skb, 16))
+		return;
+
+	field(fields, "len", &len, 10);
+	f = frame_add(rx_frames, skb);
+	f->len = len;
+	f->t[0] = last_irq;
+	f->t[1] = last_rx_read;
+	f->t[2] = ts;
+}
+
+static void rx_deliver(double ts, const char *fields)
+{
+	unsigned long long skb;
+	struct frame *f;
+
+	if (!field(fields, "skb", &skb, 16))
+		return;
+
+	f = frame_find(rx_frames, skb, true);
+	if (!f)
+		return;
+
+	f->t[3] = ts;
+
+	sample_add(RX_BUS, f->t[0], f->t[1]);
+	sample_add(RX_DRV, f->t[1], f->t[2]);
+	sample_add(RX_STACK, f->t[2], f->t[3]);
+	sample_add(RX_TOTAL, f->t[0], f->t[3]);
+
+	if (verbose && f->t[0] && f->t[1])
+		printf("%.6f rx skb %llx len %u bus %.0f drv %.0f "
+		       "stack %.0f us\n", ts, skb, f->len,
+		       (f->t[1] - f->t[0]) * 1000000,
+		       (f->t[2] - f->t[1]) * 1000000,
+		       (f->t[3] - f->t[2]) * 1000000);
+	free(f);
+}
+
+/*
+ * "<task>-<pid> [<cpu>] <flags> <secs>.<usecs>: wl12xx_<event>: <fields>",
+ * the flags column is optional.
+ */
+static void parse_line(const char *line)
+{
+	const char *ev, *p, *fields;
+	char name[32];
+	double ts;
+	size_t len;
+
+	ev = strstr(line, ": wl12xx_");
+	if (!ev)
+		return;
+
+	for (p = ev; p > line && p[-1] != ' '; p--)
+		;
+	if (sscanf(p, "%lf", &ts) != 1)
+		return;
+
+	ev += 2;
+	fields = strchr(ev, ':');
+	if (!fields)
+		return;
+
+	len = fields - ev;
+	if (len >= sizeof(name))
+		return;
+	memcpy(name, ev, len);
+	name[len] = '\0';
+
+	if (!strcmp(name, "wl12xx_tx_enqueue"))
+		tx_enqueue(ts, fields);
+	else if (!strcmp(name, "wl12xx_tx_prepare"))
+		tx_prepare(ts, fields);
+	else if (!strcmp(name, "wl12xx_tx_burst"))
+		tx_burst(ts);
+	else if (!strcmp(name, "wl12xx_tx_complete"))
+		tx_complete(ts, fields);
+	else if (!strcmp(name, "wl12xx_irq"))
+		last_irq = ts;
+	else if (!strcmp(name, "wl12xx_rx_read"))
+		last_rx_read = ts;
+	else if (!strcmp(name, "wl12xx_rx_frame"))
+		rx_frame(ts, fields);
+	else if (!strcmp(name, "wl12xx_rx_deliver"))
+		rx_deliver(ts, fields);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(struct samples *s, int pct)
+{
+	size_t i = (s->num * pct) / 100;
+
+	return s->val[i < s->num ? i : s->num - 1];
+}
+
+static void print_summary(void)
+{
+	struct samples *s;
+	double sum;
+	size_t i;
+	int stage;
+
+	printf("%-10s %8s %10s %10s %10s %10s %10s\n", "stage (us)", "frames",
+	       "avg", "p50", "p90", "p99", "max");
+
+	for (stage = 0; stage < STAGE_MAX; stage++) {
+		s = &stats[stage];
+		if (!s->num)
+			continue;
+
+		qsort(s->val, s->num, sizeof(*s->val), cmp_double);
+		for (sum = 0, i = 0; i < s->num; i++)
+			sum += s->val[i];
+
+		printf("%-10s %8zu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+		       stage_names[stage], s->num, sum / s->num,
+		       percentile(s, 50), percentile(s, 90),
+		       percentile(s, 99), s->val[s->num - 1]);
+	}
+
+	if (lost_frames)
+		printf("%lu frames lost track of\n", lost_frames);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-v] [trace file]\n"
+		"reads the trace from stdin if no file is given\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in = stdin;
+	char line[1024];
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-v")) {
+			verbose = true;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (i < argc) {
+		in = fopen(argv[i], "r");
+		if (!in) {
+			perror(argv[i]);
+			return 1;
+		}
+	}
+
+	while (fgets(line, sizeof(line), in))
+		parse_line(line);
+
+	if (in != stdin)
+		fclose(in);
+
+	print_summary();
+	return 0;
+}
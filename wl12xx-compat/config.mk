@@ -662,6 +662,8 @@ CONFIG_BRCMUTIL=m
 ifdef CONFIG_CRC7
 #CONFIG_WL1251=m
 CONFIG_WL12XX=m
+# software chip model, for bench runs without hardware
+#CONFIG_WL12XX_SIM=m
 endif #CONFIG_CRC7
 
 CONFIG_MWIFIEX=m
@@ -34,6 +34,30 @@
 #include "reg.h"
 #include "ps.h"
 
+/*
+ * ACX commands are built in a buffer preallocated with the device, all of
+ * them run under wl->mutex and release it before returning. Fall back to
+ * kzalloc if it's taken or too small.
+ */
+static void *wl1271_acx_alloc(struct wl1271 *wl, size_t size)
+{
+	if (likely(!wl->acx_buf_used && size <= WL1271_ACX_BUF_SIZE)) {
+		wl->acx_buf_used = true;
+		memset(wl->acx_buf, 0, size);
+		return wl->acx_buf;
+	}
+
+	return kzalloc(size, GFP_KERNEL);
+}
+
+static void wl1271_acx_free(struct wl1271 *wl, void *buf)
+{
+	if (buf == wl->acx_buf)
+		wl->acx_buf_used = false;
+	else
+		kfree(buf);
+}
+
 int wl1271_acx_wake_up_conditions(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 				  u8 wake_up_event, u8 listen_interval)
 {
@@ -43,7 +67,7 @@ int wl1271_acx_wake_up_conditions(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	wl1271_debug(DEBUG_ACX, "acx wake up conditions (wake_up_event %d listen_interval %d)",
 		     wake_up_event, listen_interval);
 
-	wake_up = kzalloc(sizeof(*wake_up), GFP_KERNEL);
+	wake_up = wl1271_acx_alloc(wl, sizeof(*wake_up));
 	if (!wake_up) {
 		ret = -ENOMEM;
 		goto out;
@@ -61,7 +85,7 @@ int wl1271_acx_wake_up_conditions(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(wake_up);
+	wl1271_acx_free(wl, wake_up);
 	return ret;
 }
 
@@ -72,7 +96,7 @@ int wl1271_acx_sleep_auth(struct wl1271 *wl, u8 sleep_auth)
 
 	wl1271_debug(DEBUG_ACX, "acx sleep auth");
 
-	auth = kzalloc(sizeof(*auth), GFP_KERNEL);
+	auth = wl1271_acx_alloc(wl, sizeof(*auth));
 	if (!auth) {
 		ret = -ENOMEM;
 		goto out;
@@ -83,7 +107,7 @@ int wl1271_acx_sleep_auth(struct wl1271 *wl, u8 sleep_auth)
 	ret = wl1271_cmd_configure(wl, ACX_SLEEP_AUTH, auth, sizeof(*auth));
 
 out:
-	kfree(auth);
+	wl1271_acx_free(wl, auth);
 	return ret;
 }
 
@@ -98,7 +122,7 @@ int wl1271_acx_tx_power(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	if (power < 0 || power > 25)
 		return -EINVAL;
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -114,7 +138,7 @@ int wl1271_acx_tx_power(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -125,7 +149,7 @@ int wl1271_acx_feature_cfg(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 
 	wl1271_debug(DEBUG_ACX, "acx feature cfg");
 
-	feature = kzalloc(sizeof(*feature), GFP_KERNEL);
+	feature = wl1271_acx_alloc(wl, sizeof(*feature));
 	if (!feature) {
 		ret = -ENOMEM;
 		goto out;
@@ -144,7 +168,7 @@ int wl1271_acx_feature_cfg(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 	}
 
 out:
-	kfree(feature);
+	wl1271_acx_free(wl, feature);
 	return ret;
 }
 
@@ -169,7 +193,7 @@ int wl1271_acx_rx_msdu_life_time(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx rx msdu life time");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -184,7 +208,7 @@ int wl1271_acx_rx_msdu_life_time(struct wl1271 *wl)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -196,7 +220,7 @@ int wl1271_acx_slot(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx slot");
 
-	slot = kzalloc(sizeof(*slot), GFP_KERNEL);
+	slot = wl1271_acx_alloc(wl, sizeof(*slot));
 	if (!slot) {
 		ret = -ENOMEM;
 		goto out;
@@ -213,7 +237,7 @@ int wl1271_acx_slot(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(slot);
+	wl1271_acx_free(wl, slot);
 	return ret;
 }
 
@@ -225,7 +249,7 @@ int wl1271_acx_group_address_tbl(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx group address tbl");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -250,7 +274,7 @@ int wl1271_acx_group_address_tbl(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -260,7 +284,7 @@ int wl1271_acx_service_period_timeout(struct wl1271 *wl,
 	struct acx_rx_timeout *rx_timeout;
 	int ret;
 
-	rx_timeout = kzalloc(sizeof(*rx_timeout), GFP_KERNEL);
+	rx_timeout = wl1271_acx_alloc(wl, sizeof(*rx_timeout));
 	if (!rx_timeout) {
 		ret = -ENOMEM;
 		goto out;
@@ -281,7 +305,7 @@ int wl1271_acx_service_period_timeout(struct wl1271 *wl,
 	}
 
 out:
-	kfree(rx_timeout);
+	wl1271_acx_free(wl, rx_timeout);
 	return ret;
 }
 
@@ -300,7 +324,7 @@ int wl1271_acx_rts_threshold(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx rts threshold: %d", rts_threshold);
 
-	rts = kzalloc(sizeof(*rts), GFP_KERNEL);
+	rts = wl1271_acx_alloc(wl, sizeof(*rts));
 	if (!rts) {
 		ret = -ENOMEM;
 		goto out;
@@ -316,7 +340,7 @@ int wl1271_acx_rts_threshold(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(rts);
+	wl1271_acx_free(wl, rts);
 	return ret;
 }
 
@@ -328,7 +352,7 @@ int wl1271_acx_dco_itrim_params(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx dco itrim parameters");
 
-	dco = kzalloc(sizeof(*dco), GFP_KERNEL);
+	dco = wl1271_acx_alloc(wl, sizeof(*dco));
 	if (!dco) {
 		ret = -ENOMEM;
 		goto out;
@@ -345,7 +369,7 @@ int wl1271_acx_dco_itrim_params(struct wl1271 *wl)
 	}
 
 out:
-	kfree(dco);
+	wl1271_acx_free(wl, dco);
 	return ret;
 }
 
@@ -361,7 +385,7 @@ int wl1271_acx_beacon_filter_opt(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	    wl->conf.conn.bcn_filt_mode == CONF_BCN_FILT_MODE_DISABLED)
 		goto out;
 
-	beacon_filter = kzalloc(sizeof(*beacon_filter), GFP_KERNEL);
+	beacon_filter = wl1271_acx_alloc(wl, sizeof(*beacon_filter));
 	if (!beacon_filter) {
 		ret = -ENOMEM;
 		goto out;
@@ -384,7 +408,7 @@ int wl1271_acx_beacon_filter_opt(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(beacon_filter);
+	wl1271_acx_free(wl, beacon_filter);
 	return ret;
 }
 
@@ -398,7 +422,7 @@ int wl1271_acx_beacon_filter_table(struct wl1271 *wl,
 
 	wl1271_debug(DEBUG_ACX, "acx beacon filter table");
 
-	ie_table = kzalloc(sizeof(*ie_table), GFP_KERNEL);
+	ie_table = wl1271_acx_alloc(wl, sizeof(*ie_table));
 	if (!ie_table) {
 		ret = -ENOMEM;
 		goto out;
@@ -440,7 +464,7 @@ int wl1271_acx_beacon_filter_table(struct wl1271 *wl,
 	}
 
 out:
-	kfree(ie_table);
+	wl1271_acx_free(wl, ie_table);
 	return ret;
 }
 
@@ -457,7 +481,7 @@ int wl1271_acx_conn_monit_params(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	wl1271_debug(DEBUG_ACX, "acx connection monitor parameters: %s",
 		     enable ? "enabled" : "disabled");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -481,7 +505,7 @@ int wl1271_acx_conn_monit_params(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -493,7 +517,7 @@ int wl1271_acx_sg_enable(struct wl1271 *wl, bool enable)
 
 	wl1271_debug(DEBUG_ACX, "acx sg enable");
 
-	pta = kzalloc(sizeof(*pta), GFP_KERNEL);
+	pta = wl1271_acx_alloc(wl, sizeof(*pta));
 	if (!pta) {
 		ret = -ENOMEM;
 		goto out;
@@ -511,7 +535,7 @@ int wl1271_acx_sg_enable(struct wl1271 *wl, bool enable)
 	}
 
 out:
-	kfree(pta);
+	wl1271_acx_free(wl, pta);
 	return ret;
 }
 
@@ -523,7 +547,7 @@ int wl12xx_acx_sg_cfg(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx sg cfg");
 
-	param = kzalloc(sizeof(*param), GFP_KERNEL);
+	param = wl1271_acx_alloc(wl, sizeof(*param));
 	if (!param) {
 		ret = -ENOMEM;
 		goto out;
@@ -541,7 +565,7 @@ int wl12xx_acx_sg_cfg(struct wl1271 *wl)
 	}
 
 out:
-	kfree(param);
+	wl1271_acx_free(wl, param);
 	return ret;
 }
 
@@ -552,7 +576,7 @@ int wl1271_acx_cca_threshold(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx cca threshold");
 
-	detection = kzalloc(sizeof(*detection), GFP_KERNEL);
+	detection = wl1271_acx_alloc(wl, sizeof(*detection));
 	if (!detection) {
 		ret = -ENOMEM;
 		goto out;
@@ -567,7 +591,7 @@ int wl1271_acx_cca_threshold(struct wl1271 *wl)
 		wl1271_warning("failed to set cca threshold: %d", ret);
 
 out:
-	kfree(detection);
+	wl1271_acx_free(wl, detection);
 	return ret;
 }
 
@@ -578,7 +602,7 @@ int wl1271_acx_bcn_dtim_options(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 
 	wl1271_debug(DEBUG_ACX, "acx bcn dtim options");
 
-	bb = kzalloc(sizeof(*bb), GFP_KERNEL);
+	bb = wl1271_acx_alloc(wl, sizeof(*bb));
 	if (!bb) {
 		ret = -ENOMEM;
 		goto out;
@@ -597,7 +621,7 @@ int wl1271_acx_bcn_dtim_options(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 	}
 
 out:
-	kfree(bb);
+	wl1271_acx_free(wl, bb);
 	return ret;
 }
 
@@ -608,7 +632,7 @@ int wl1271_acx_aid(struct wl1271 *wl, struct wl12xx_vif *wlvif, u16 aid)
 
 	wl1271_debug(DEBUG_ACX, "acx aid");
 
-	acx_aid = kzalloc(sizeof(*acx_aid), GFP_KERNEL);
+	acx_aid = wl1271_acx_alloc(wl, sizeof(*acx_aid));
 	if (!acx_aid) {
 		ret = -ENOMEM;
 		goto out;
@@ -624,7 +648,7 @@ int wl1271_acx_aid(struct wl1271 *wl, struct wl12xx_vif *wlvif, u16 aid)
 	}
 
 out:
-	kfree(acx_aid);
+	wl1271_acx_free(wl, acx_aid);
 	return ret;
 }
 
@@ -635,7 +659,7 @@ int wl1271_acx_event_mbox_mask(struct wl1271 *wl, u32 event_mask)
 
 	wl1271_debug(DEBUG_ACX, "acx event mbox mask");
 
-	mask = kzalloc(sizeof(*mask), GFP_KERNEL);
+	mask = wl1271_acx_alloc(wl, sizeof(*mask));
 	if (!mask) {
 		ret = -ENOMEM;
 		goto out;
@@ -653,7 +677,7 @@ int wl1271_acx_event_mbox_mask(struct wl1271 *wl, u32 event_mask)
 	}
 
 out:
-	kfree(mask);
+	wl1271_acx_free(wl, mask);
 	return ret;
 }
 
@@ -665,7 +689,7 @@ int wl1271_acx_set_preamble(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx_set_preamble");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -681,7 +705,7 @@ int wl1271_acx_set_preamble(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -693,7 +717,7 @@ int wl1271_acx_cts_protect(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx_set_ctsprotect");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -709,7 +733,7 @@ int wl1271_acx_cts_protect(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -737,7 +761,7 @@ int wl1271_acx_sta_rate_policies(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 
 	wl1271_debug(DEBUG_ACX, "acx rate policies");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 
 	if (!acx) {
 		ret = -ENOMEM;
@@ -792,7 +816,7 @@ int wl1271_acx_sta_rate_policies(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -805,7 +829,7 @@ int wl1271_acx_ap_rate_policy(struct wl1271 *wl, struct conf_tx_rate_class *c,
 	wl1271_debug(DEBUG_ACX, "acx ap rate policy %d rates 0x%x",
 		     idx, c->enabled_rates);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -825,7 +849,7 @@ int wl1271_acx_ap_rate_policy(struct wl1271 *wl, struct conf_tx_rate_class *c,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -838,7 +862,7 @@ int wl1271_acx_ac_cfg(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	wl1271_debug(DEBUG_ACX, "acx ac cfg %d cw_ming %d cw_max %d "
 		     "aifs %d txop %d", ac, cw_min, cw_max, aifsn, txop);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 
 	if (!acx) {
 		ret = -ENOMEM;
@@ -859,7 +883,7 @@ int wl1271_acx_ac_cfg(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -873,7 +897,7 @@ int wl1271_acx_tid_cfg(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx tid config");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 
 	if (!acx) {
 		ret = -ENOMEM;
@@ -896,7 +920,7 @@ int wl1271_acx_tid_cfg(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -914,7 +938,7 @@ int wl1271_acx_frag_threshold(struct wl1271 *wl, u32 frag_threshold)
 
 	wl1271_debug(DEBUG_ACX, "acx frag threshold: %d", frag_threshold);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 
 	if (!acx) {
 		ret = -ENOMEM;
@@ -929,7 +953,7 @@ int wl1271_acx_frag_threshold(struct wl1271 *wl, u32 frag_threshold)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -940,7 +964,7 @@ int wl1271_acx_tx_config_options(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx tx config options");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 
 	if (!acx) {
 		ret = -ENOMEM;
@@ -956,7 +980,7 @@ int wl1271_acx_tx_config_options(struct wl1271 *wl)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -968,7 +992,7 @@ int wl12xx_acx_mem_cfg(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "wl1271 mem cfg");
 
-	mem_conf = kzalloc(sizeof(*mem_conf), GFP_KERNEL);
+	mem_conf = wl1271_acx_alloc(wl, sizeof(*mem_conf));
 	if (!mem_conf) {
 		ret = -ENOMEM;
 		goto out;
@@ -999,7 +1023,7 @@ int wl12xx_acx_mem_cfg(struct wl1271 *wl)
 	}
 
 out:
-	kfree(mem_conf);
+	wl1271_acx_free(wl, mem_conf);
 	return ret;
 }
 
@@ -1008,7 +1032,7 @@ int wl1271_acx_host_if_cfg_bitmap(struct wl1271 *wl, u32 host_cfg_bitmap)
 	struct wl1271_acx_host_config_bitmap *bitmap_conf;
 	int ret;
 
-	bitmap_conf = kzalloc(sizeof(*bitmap_conf), GFP_KERNEL);
+	bitmap_conf = wl1271_acx_alloc(wl, sizeof(*bitmap_conf));
 	if (!bitmap_conf) {
 		ret = -ENOMEM;
 		goto out;
@@ -1024,7 +1048,7 @@ int wl1271_acx_host_if_cfg_bitmap(struct wl1271 *wl, u32 host_cfg_bitmap)
 	}
 
 out:
-	kfree(bitmap_conf);
+	wl1271_acx_free(wl, bitmap_conf);
 
 	return ret;
 }
@@ -1069,7 +1093,7 @@ int wl1271_acx_init_rx_interrupt(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "wl1271 rx interrupt config");
 
-	rx_conf = kzalloc(sizeof(*rx_conf), GFP_KERNEL);
+	rx_conf = wl1271_acx_alloc(wl, sizeof(*rx_conf));
 	if (!rx_conf) {
 		ret = -ENOMEM;
 		goto out;
@@ -1088,7 +1112,7 @@ int wl1271_acx_init_rx_interrupt(struct wl1271 *wl)
 	}
 
 out:
-	kfree(rx_conf);
+	wl1271_acx_free(wl, rx_conf);
 	return ret;
 }
 
@@ -1103,7 +1127,7 @@ int wl1271_acx_bet_enable(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	if (enable && wl->conf.conn.bet_enable == CONF_BET_MODE_DISABLE)
 		goto out;
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1120,7 +1144,7 @@ int wl1271_acx_bet_enable(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1132,7 +1156,7 @@ int wl1271_acx_arp_ip_filter(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx arp ip filter, enable: %d", enable);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1153,7 +1177,7 @@ int wl1271_acx_arp_ip_filter(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1165,7 +1189,7 @@ int wl1271_acx_pm_config(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx pm config");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1181,7 +1205,7 @@ int wl1271_acx_pm_config(struct wl1271 *wl)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1193,7 +1217,7 @@ int wl1271_acx_keep_alive_mode(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx keep alive mode: %d", enable);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1209,7 +1233,7 @@ int wl1271_acx_keep_alive_mode(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1221,7 +1245,7 @@ int wl1271_acx_keep_alive_config(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx keep alive config");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1241,7 +1265,7 @@ int wl1271_acx_keep_alive_config(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1253,7 +1277,7 @@ int wl1271_acx_rssi_snr_trigger(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx rssi snr trigger");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1282,7 +1306,7 @@ int wl1271_acx_rssi_snr_trigger(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1295,7 +1319,7 @@ int wl1271_acx_rssi_snr_avg_weights(struct wl1271 *wl,
 
 	wl1271_debug(DEBUG_ACX, "acx rssi snr avg weights");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1314,7 +1338,7 @@ int wl1271_acx_rssi_snr_avg_weights(struct wl1271 *wl,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1330,7 +1354,7 @@ int wl1271_acx_set_ht_capabilities(struct wl1271 *wl,
 		     "sta supp: %d sta cap: %d", ht_cap->ht_supported,
 		     ht_cap->cap);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1361,7 +1385,7 @@ int wl1271_acx_set_ht_capabilities(struct wl1271 *wl,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1374,7 +1398,7 @@ int wl1271_acx_set_ht_information(struct wl1271 *wl,
 
 	wl1271_debug(DEBUG_ACX, "acx ht information setting");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1397,7 +1421,7 @@ int wl1271_acx_set_ht_information(struct wl1271 *wl,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1410,7 +1434,7 @@ int wl12xx_acx_set_ba_initiator_policy(struct wl1271 *wl,
 
 	wl1271_debug(DEBUG_ACX, "acx ba initiator policy");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1432,7 +1456,7 @@ int wl12xx_acx_set_ba_initiator_policy(struct wl1271 *wl,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1445,7 +1469,7 @@ int wl12xx_acx_set_ba_receiver_session(struct wl1271 *wl, u8 tid_index,
 
 	wl1271_debug(DEBUG_ACX, "acx ba receiver session setting");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1465,7 +1489,7 @@ int wl12xx_acx_set_ba_receiver_session(struct wl1271 *wl, u8 tid_index,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1475,7 +1499,7 @@ int wl12xx_acx_tsf_info(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	struct wl12xx_acx_fw_tsf_information *tsf_info;
 	int ret;
 
-	tsf_info = kzalloc(sizeof(*tsf_info), GFP_KERNEL);
+	tsf_info = wl1271_acx_alloc(wl, sizeof(*tsf_info));
 	if (!tsf_info) {
 		ret = -ENOMEM;
 		goto out;
@@ -1494,7 +1518,7 @@ int wl12xx_acx_tsf_info(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 		((u64) le32_to_cpu(tsf_info->current_tsf_high) << 32);
 
 out:
-	kfree(tsf_info);
+	wl1271_acx_free(wl, tsf_info);
 	return ret;
 }
 
@@ -1507,7 +1531,7 @@ int wl1271_acx_ps_rx_streaming(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx ps rx streaming");
 
-	rx_streaming = kzalloc(sizeof(*rx_streaming), GFP_KERNEL);
+	rx_streaming = wl1271_acx_alloc(wl, sizeof(*rx_streaming));
 	if (!rx_streaming) {
 		ret = -ENOMEM;
 		goto out;
@@ -1543,7 +1567,7 @@ int wl1271_acx_ps_rx_streaming(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 		}
 	}
 out:
-	kfree(rx_streaming);
+	wl1271_acx_free(wl, rx_streaming);
 	return ret;
 }
 
@@ -1554,7 +1578,7 @@ int wl1271_acx_ap_max_tx_retry(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 
 	wl1271_debug(DEBUG_ACX, "acx ap max tx retry");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx)
 		return -ENOMEM;
 
@@ -1568,7 +1592,7 @@ int wl1271_acx_ap_max_tx_retry(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1579,7 +1603,7 @@ int wl12xx_acx_config_ps(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 
 	wl1271_debug(DEBUG_ACX, "acx config ps");
 
-	config_ps = kzalloc(sizeof(*config_ps), GFP_KERNEL);
+	config_ps = wl1271_acx_alloc(wl, sizeof(*config_ps));
 	if (!config_ps) {
 		ret = -ENOMEM;
 		goto out;
@@ -1598,7 +1622,7 @@ int wl12xx_acx_config_ps(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 	}
 
 out:
-	kfree(config_ps);
+	wl1271_acx_free(wl, config_ps);
 	return ret;
 }
 
@@ -1609,7 +1633,7 @@ int wl1271_acx_set_inconnection_sta(struct wl1271 *wl, u8 *addr)
 
 	wl1271_debug(DEBUG_ACX, "acx set inconnaction sta %pM", addr);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx)
 		return -ENOMEM;
 
@@ -1623,7 +1647,7 @@ int wl1271_acx_set_inconnection_sta(struct wl1271 *wl, u8 *addr)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1634,7 +1658,7 @@ int wl1271_acx_fm_coex(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx fm coex setting");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1663,7 +1687,7 @@ int wl1271_acx_fm_coex(struct wl1271 *wl)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1675,7 +1699,7 @@ int wl12xx_acx_set_rate_mgmt_params(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx set rate mgmt params");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx)
 		return -ENOMEM;
 
@@ -1705,7 +1729,7 @@ int wl12xx_acx_set_rate_mgmt_params(struct wl1271 *wl)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1717,7 +1741,7 @@ int wl12xx_acx_config_hangover(struct wl1271 *wl)
 
 	wl1271_debug(DEBUG_ACX, "acx config hangover");
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1744,7 +1768,7 @@ int wl12xx_acx_config_hangover(struct wl1271 *wl)
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 
 }
@@ -1758,7 +1782,7 @@ int wl1271_acx_toggle_rx_data_filter(struct wl1271 *wl, bool enable,
 	wl1271_debug(DEBUG_ACX, "acx toggle rx data filter en: %d act: %d",
 		     enable, default_action);
 
-	acx = kzalloc(sizeof(*acx), GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, sizeof(*acx));
 	if (!acx) {
 		ret = -ENOMEM;
 		goto out;
@@ -1775,7 +1799,7 @@ int wl1271_acx_toggle_rx_data_filter(struct wl1271 *wl, bool enable,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1818,7 +1842,7 @@ int wl1271_acx_set_rx_data_filter(struct wl1271 *wl, u8 index, bool enable,
 	}
 
 	acx_size = roundup(sizeof(*acx) + fields_size, 4);
-	acx = kzalloc(acx_size, GFP_KERNEL);
+	acx = wl1271_acx_alloc(wl, acx_size);
 
 	if (!acx)
 		return -ENOMEM;
@@ -1843,7 +1867,7 @@ int wl1271_acx_set_rx_data_filter(struct wl1271 *wl, u8 index, bool enable,
 	}
 
 out:
-	kfree(acx);
+	wl1271_acx_free(wl, acx);
 	return ret;
 }
 
@@ -1855,7 +1879,7 @@ int wl12xx_acx_sta_get_rssi(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 
 	wl1271_debug(DEBUG_ACX, "acx roaming statistics table");
 
-	stat_info = kzalloc(sizeof(*stat_info), GFP_KERNEL);
+	stat_info = wl1271_acx_alloc(wl, sizeof(*stat_info));
 	if (!stat_info)
 		return -ENOMEM;
 
@@ -1872,6 +1896,6 @@ int wl12xx_acx_sta_get_rssi(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	*rssi = stat_info->rssi_beacon;
 
 out:
-	kfree(stat_info);
+	wl1271_acx_free(wl, stat_info);
 	return ret;
 }
@@ -114,109 +114,166 @@ out:
 	return ret;
 }
 
-static int wl1271_boot_upload_firmware_chunk(struct wl1271 *wl, void *buf,
-					     size_t fw_data_len, u32 dest)
+void wl12xx_boot_phase_end(struct wl1271 *wl, enum wl12xx_boot_phase phase,
+			   ktime_t start)
 {
-	struct wl1271_partition_set partition;
-	int addr, chunk_num, partition_limit;
-	u8 *p, *chunk;
-	int ret;
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
 
-	/* whal_FwCtrl_LoadFwImageSm() */
+	wl->stats.boot_phase_us[phase] = us;
+	if (us > wl->stats.boot_phase_max_us[phase])
+		wl->stats.boot_phase_max_us[phase] = us;
+}
+
+void wl12xx_boot_free_fw(struct wl12xx_fw_image *img)
+{
+	int i;
+
+	for (i = 0; i < img->num_chunks; i++)
+		kfree(img->chunks[i].data);
+
+	kfree(img->chunks);
+	img->chunks = NULL;
+	img->num_chunks = 0;
+	img->len = 0;
+}
+
+/*
+ * Split the firmware image into kmalloc'd pieces of at most
+ * WL12XX_FW_UPLOAD_CHUNK_SIZE bytes. This is done once per image, so that
+ * every boot (and every recovery) can hand the pieces to the bus as they
+ * are, instead of bouncing the whole image through a temporary buffer.
+ */
+int wl12xx_boot_prepare_fw(struct wl12xx_fw_image *img, const u8 *fw,
+			   size_t fw_len)
+{
+	const u8 *p = fw, *end = fw + fw_len;
+	struct wl12xx_fw_chunk *chunks;
+	u32 records, i, addr, len, off, piece;
+	int num = 0, n = 0;
+
+	if (fw_len < sizeof(u32))
+		goto out_bad;
+
+	records = be32_to_cpup((__be32 *) p);
+	p += sizeof(u32);
 
-	wl1271_debug(DEBUG_BOOT, "starting firmware upload");
+	wl1271_debug(DEBUG_BOOT, "firmware chunks in image: %u", records);
 
-	wl1271_debug(DEBUG_BOOT, "fw_data_len %zd chunk_size %d",
-		     fw_data_len, CHUNK_SIZE);
+	/* validate the image and count the pieces first */
+	for (i = 0; i < records; i++) {
+		if (end - p < 2 * sizeof(u32))
+			goto out_bad;
 
-	if ((fw_data_len % 4) != 0) {
-		wl1271_error("firmware length not multiple of four");
-		return -EIO;
+		len = be32_to_cpup((__be32 *) (p + sizeof(u32)));
+		p += 2 * sizeof(u32);
+
+		if (len > WL12XX_FW_MAX_RECORD_LEN) {
+			wl1271_info("firmware chunk too long: %u", len);
+			return -EINVAL;
+		}
+
+		if ((len % 4) != 0) {
+			wl1271_error("firmware length not multiple of four");
+			return -EIO;
+		}
+
+		if (len > end - p)
+			goto out_bad;
+
+		num += DIV_ROUND_UP(len, WL12XX_FW_UPLOAD_CHUNK_SIZE);
+		p += len;
 	}
 
-	chunk = kmalloc(CHUNK_SIZE, GFP_KERNEL);
-	if (!chunk) {
-		wl1271_error("allocation for firmware upload chunk failed");
+	chunks = kcalloc(num, sizeof(*chunks), GFP_KERNEL);
+	if (!chunks)
 		return -ENOMEM;
-	}
 
-	memcpy(&partition, &wl12xx_part_table[PART_DOWN], sizeof(partition));
-	partition.mem.start = dest;
-	ret = wl1271_set_partition(wl, &partition);
-	if (ret < 0)
-		goto out;
+	p = fw + sizeof(u32);
+	for (i = 0; i < records; i++) {
+		addr = be32_to_cpup((__be32 *) p);
+		len = be32_to_cpup((__be32 *) (p + sizeof(u32)));
+		p += 2 * sizeof(u32);
 
-	/* 10.1 set partition limit and chunk num */
-	chunk_num = 0;
-	partition_limit = wl12xx_part_table[PART_DOWN].mem.size;
+		for (off = 0; off < len; off += piece) {
+			piece = min_t(u32, len - off,
+				      WL12XX_FW_UPLOAD_CHUNK_SIZE);
 
-	while (chunk_num < fw_data_len / CHUNK_SIZE) {
-		/* 10.2 update partition, if needed */
-		addr = dest + (chunk_num + 2) * CHUNK_SIZE;
-		if (addr > partition_limit) {
-			addr = dest + chunk_num * CHUNK_SIZE;
-			partition_limit = chunk_num * CHUNK_SIZE +
-				wl12xx_part_table[PART_DOWN].mem.size;
-			partition.mem.start = addr;
-			ret = wl1271_set_partition(wl, &partition);
-			if (ret < 0)
-				goto out;
-		}
+			chunks[n].data = kmemdup(p + off, piece, GFP_KERNEL);
+			if (!chunks[n].data)
+				goto out_nomem;
 
-		/* 10.3 upload the chunk */
-		addr = dest + chunk_num * CHUNK_SIZE;
-		p = buf + chunk_num * CHUNK_SIZE;
-		memcpy(chunk, p, CHUNK_SIZE);
-		wl1271_debug(DEBUG_BOOT, "uploading fw chunk 0x%p to 0x%x",
-			     p, addr);
-		ret = wl1271_write(wl, addr, chunk, CHUNK_SIZE, false);
-		if (ret < 0)
-			goto out;
+			chunks[n].addr = addr + off;
+			chunks[n].len = piece;
+			n++;
+		}
 
-		chunk_num++;
+		p += len;
 	}
 
-	/* 10.4 upload the last chunk */
-	addr = dest + chunk_num * CHUNK_SIZE;
-	p = buf + chunk_num * CHUNK_SIZE;
-	memcpy(chunk, p, fw_data_len % CHUNK_SIZE);
-	wl1271_debug(DEBUG_BOOT, "uploading fw last chunk (%zd B) 0x%p to 0x%x",
-		     fw_data_len % CHUNK_SIZE, p, addr);
-	ret = wl1271_write(wl, addr, chunk, fw_data_len % CHUNK_SIZE, false);
+	img->chunks = chunks;
+	img->num_chunks = n;
+	img->len = fw_len;
 
-out:
-	kfree(chunk);
-	return ret;
+	return 0;
+
+out_nomem:
+	wl1271_error("could not allocate memory for the firmware");
+	while (n--)
+		kfree(chunks[n].data);
+	kfree(chunks);
+	return -ENOMEM;
+
+out_bad:
+	wl1271_error("firmware image is truncated");
+	return -EILSEQ;
 }
 
 static int wl1271_boot_upload_firmware(struct wl1271 *wl)
 {
-	u32 chunks, addr, len;
-	int ret = 0;
-	u8 *fw;
+	struct wl1271_partition_set partition;
+	struct wl12xx_fw_chunk *chunk;
+	u32 part_start = 0, part_size;
+	bool part_valid = false;
+	int i, ret = 0;
 
-	fw = wl->fw;
-	chunks = be32_to_cpup((__be32 *) fw);
-	fw += sizeof(u32);
+	/* whal_FwCtrl_LoadFwImageSm() */
 
-	wl1271_debug(DEBUG_BOOT, "firmware chunks to be uploaded: %u", chunks);
+	if (!wl->fw || !wl->fw->chunks)
+		return -ENODEV;
 
-	while (chunks--) {
-		addr = be32_to_cpup((__be32 *) fw);
-		fw += sizeof(u32);
-		len = be32_to_cpup((__be32 *) fw);
-		fw += sizeof(u32);
+	wl1271_debug(DEBUG_BOOT, "firmware pieces to be uploaded: %d",
+		     wl->fw->num_chunks);
 
-		if (len > 300000) {
-			wl1271_info("firmware chunk too long: %u", len);
-			return -EINVAL;
+	memcpy(&partition, &wl12xx_part_table[PART_DOWN], sizeof(partition));
+	part_size = partition.mem.size;
+	wl->stats.fw_upload_part_switches = 0;
+
+	for (i = 0; i < wl->fw->num_chunks; i++) {
+		chunk = &wl->fw->chunks[i];
+
+		/*
+		 * Only move the download window when the piece does not fit
+		 * in it, and then start it at the piece so that the following
+		 * ones are likely to fit as well.
+		 */
+		if (!part_valid || chunk->addr < part_start ||
+		    chunk->addr + chunk->len > part_start + part_size) {
+			part_start = chunk->addr;
+			partition.mem.start = part_start;
+			ret = wl1271_set_partition(wl, &partition);
+			if (ret < 0)
+				break;
+
+			part_valid = true;
+			wl->stats.fw_upload_part_switches++;
 		}
-		wl1271_debug(DEBUG_BOOT, "chunk %d addr 0x%x len %u",
-			     chunks, addr, len);
-		ret = wl1271_boot_upload_firmware_chunk(wl, fw, len, addr);
-		if (ret != 0)
+
+		wl1271_debug(DEBUG_BOOT, "uploading fw piece %d (%u B) to 0x%x",
+			     i, chunk->len, chunk->addr);
+		ret = wl1271_write(wl, chunk->addr, chunk->data, chunk->len,
+				   false);
+		if (ret < 0)
 			break;
-		fw += len;
 	}
 
 	return ret;
@@ -376,14 +433,26 @@ out_badnvs:
 
 static int wl1271_boot_enable_interrupts(struct wl1271 *wl)
 {
+	u32 intr_mask = WL1271_INTR_MASK;
 	int ret;
 
+	/*
+	 * Let command completion raise the IRQ, so wl1271_cmd_send() can
+	 * sleep instead of polling. With edge triggered interrupts another
+	 * pending event would hide the edge, so keep polling there.
+	 */
+	if (!(wl->platform_quirks & WL12XX_PLATFORM_QUIRK_EDGE_IRQ))
+		intr_mask |= WL1271_ACX_INTR_CMD_COMPLETE;
+
 	wl1271_enable_interrupts(wl);
 	ret = wl1271_write32(wl, ACX_REG_INTERRUPT_MASK,
-			     WL1271_ACX_INTR_ALL & ~(WL1271_INTR_MASK));
+			     WL1271_ACX_INTR_ALL & ~intr_mask);
 	if (ret < 0)
 		goto out;
 
+	if (intr_mask & WL1271_ACX_INTR_CMD_COMPLETE)
+		set_bit(WL1271_FLAG_CMD_COMPLETE_IRQ, &wl->flags);
+
 	ret = wl1271_write32(wl, HI_CFG, HI_CFG_DEF_VAL);
 
 out:
@@ -815,6 +884,7 @@ int wl1271_load_firmware(struct wl1271 *wl)
 	int ret = 0;
 	u32 tmp, clk;
 	int selected_clock = -1;
+	ktime_t start;
 
 	ret = wl12xx_init_pll_clock(wl, &selected_clock);
 	if (ret < 0)
@@ -850,6 +920,7 @@ int wl1271_load_firmware(struct wl1271 *wl)
 		goto out;
 
 	/* Disable interrupts */
+	clear_bit(WL1271_FLAG_CMD_COMPLETE_IRQ, &wl->flags);
 	ret = wl1271_write32(wl, ACX_REG_INTERRUPT_MASK, WL1271_ACX_INTR_ALL);
 	if (ret < 0)
 		goto out;
@@ -859,10 +930,13 @@ int wl1271_load_firmware(struct wl1271 *wl)
 		goto out;
 
 	/* 2. start processing NVS file */
+	start = ktime_get();
 	ret = wl1271_boot_upload_nvs(wl);
 	if (ret < 0)
 		goto out;
 
+	wl12xx_boot_phase_end(wl, WL12XX_BOOT_PHASE_NVS, start);
+
 	/* write firmware's last address (ie. it's length) to
 	 * ACX_EEPROMLESS_IND_REG */
 	wl1271_debug(DEBUG_BOOT, "ACX_EEPROMLESS_IND_REG");
@@ -892,10 +966,13 @@ int wl1271_load_firmware(struct wl1271 *wl)
 			goto out;
 	}
 
+	start = ktime_get();
 	ret = wl1271_boot_upload_firmware(wl);
 	if (ret < 0)
 		goto out;
 
+	wl12xx_boot_phase_end(wl, WL12XX_BOOT_PHASE_FW, start);
+
 	/* update loaded fw type */
 	wl->fw_type = wl->saved_fw_type;
 out:
@@ -905,6 +982,7 @@ EXPORT_SYMBOL_GPL(wl1271_load_firmware);
 
 int wl1271_boot(struct wl1271 *wl)
 {
+	ktime_t start;
 	int ret;
 
 	/* polarity must be set before the firmware is loaded */
@@ -918,10 +996,13 @@ int wl1271_boot(struct wl1271 *wl)
 		return ret;
 
 	/* 10.5 start firmware */
+	start = ktime_get();
 	ret = wl1271_boot_run_firmware(wl);
 	if (ret < 0)
 		goto out;
 
+	wl12xx_boot_phase_end(wl, WL12XX_BOOT_PHASE_RUN_FW, start);
+
 	ret = wl1271_write32(wl, ACX_REG_INTERRUPT_MASK,
 			     WL1271_ACX_ALL_EVENTS_VECTOR);
 	if (ret < 0)
@@ -24,12 +24,26 @@
 #ifndef __BOOT_H__
 #define __BOOT_H__
 
+#include <linux/ktime.h>
+
 #include "wl12xx.h"
 
 int wl1271_boot(struct wl1271 *wl);
 int wl1271_load_firmware(struct wl1271 *wl);
 int wl128x_boot_clk(struct wl1271 *wl, int *selected_clock);
 int wl127x_boot_clk(struct wl1271 *wl);
+int wl12xx_boot_prepare_fw(struct wl12xx_fw_image *img, const u8 *fw,
+			   size_t fw_len);
+void wl12xx_boot_free_fw(struct wl12xx_fw_image *img);
+void wl12xx_boot_phase_end(struct wl1271 *wl, enum wl12xx_boot_phase phase,
+			   ktime_t start);
+
+/*
+ * Largest firmware piece written in one go: what the SPI glue accepts in
+ * a single transfer on 4K pages, well within the download partition.
+ */
+#define WL12XX_FW_UPLOAD_CHUNK_SIZE (32 * 1024)
+#define WL12XX_FW_MAX_RECORD_LEN    300000
 
 #define WL1271_NO_SUBBANDS 8
 #define WL1271_NO_POWER_LEVELS 4
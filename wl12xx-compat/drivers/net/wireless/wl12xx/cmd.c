@@ -27,6 +27,8 @@
 #include <linux/etherdevice.h>
 #include <linux/ieee80211.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/wl12xx.h>
 
 #include "wl12xx.h"
 #include "debug.h"
@@ -40,6 +42,108 @@
 
 #define WL1271_CMD_FAST_POLL_COUNT       50
 
+static void wl1271_cmd_lat_add(struct wl1271_cmd_lat *lat, u32 us)
+{
+	int bucket = fls(us >> WL1271_CMD_LAT_HIST_SHIFT);
+
+	lat->count++;
+	lat->total_us += us;
+	lat->max_us = max(lat->max_us, us);
+	lat->hist[min(bucket, WL1271_CMD_LAT_HIST_LEN - 1)]++;
+}
+
+/* must be called before the command box is read back into buf */
+static void wl1271_cmd_record_latency(struct wl1271 *wl, u16 id, void *buf,
+				      ktime_t start)
+{
+	struct wl1271_cmd_lat_stats *stats = wl->stats.cmd_lat;
+	struct acx_header *acx = buf;
+	u16 acx_id;
+	u32 us;
+
+	if (!stats || id >= CMD_LAST_COMMAND)
+		return;
+
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+	wl1271_cmd_lat_add(&stats->cmd[id], us);
+
+	if (id != CMD_CONFIGURE && id != CMD_INTERROGATE)
+		return;
+
+	acx_id = le16_to_cpu(acx->id);
+	if (acx_id < WL1271_CMD_LAT_ACX_IDS)
+		wl1271_cmd_lat_add(&stats->acx[acx_id], us);
+}
+
+/*
+ * Wait for the FW to complete the command just triggered. Sleep on the
+ * command complete IRQ when the hardirq is free to signal it, otherwise (the
+ * IRQ is disabled or command complete masked, as during boot and recovery,
+ * an IRQ is already pending and its thread is blocked on wl->mutex, or it
+ * didn't come in time) poll the interrupt status.
+ */
+static int wl1271_cmd_wait_complete(struct wl1271 *wl)
+{
+	DECLARE_COMPLETION_ONSTACK(compl);
+	unsigned long timeout;
+	unsigned long flags;
+	bool armed = false;
+	u16 poll_count = 0;
+	u32 intr;
+	int ret;
+
+	timeout = jiffies + msecs_to_jiffies(WL1271_COMMAND_TIMEOUT);
+
+	if (!(wl->platform_quirks & WL12XX_PLATFORM_QUIRK_EDGE_IRQ)) {
+		spin_lock_irqsave(&wl->wl_lock, flags);
+		if (test_bit(WL1271_FLAG_CMD_COMPLETE_IRQ, &wl->flags) &&
+		    !atomic_read(&wl->irq_disable_depth) &&
+		    !test_bit(WL1271_FLAG_IRQ_RUNNING, &wl->flags)) {
+			wl->cmd_compl = &compl;
+			armed = true;
+		}
+		spin_unlock_irqrestore(&wl->wl_lock, flags);
+	}
+
+	if (armed) {
+		wait_for_completion_timeout(&compl,
+				msecs_to_jiffies(WL1271_CMD_IRQ_TIMEOUT));
+
+		spin_lock_irqsave(&wl->wl_lock, flags);
+		wl->cmd_compl = NULL;
+		spin_unlock_irqrestore(&wl->wl_lock, flags);
+	}
+
+	ret = wl1271_read32(wl, ACX_REG_INTERRUPT_NO_CLEAR, &intr);
+	if (ret < 0)
+		return ret;
+
+	if (armed && (intr & WL1271_ACX_INTR_CMD_COMPLETE)) {
+		wl->stats.cmd_irq_completions++;
+		return 0;
+	}
+
+	while (!(intr & WL1271_ACX_INTR_CMD_COMPLETE)) {
+		if (time_after(jiffies, timeout)) {
+			wl1271_error("command complete timeout");
+			return -ETIMEDOUT;
+		}
+
+		poll_count++;
+		if (poll_count < WL1271_CMD_FAST_POLL_COUNT)
+			udelay(10);
+		else
+			msleep(1);
+
+		ret = wl1271_read32(wl, ACX_REG_INTERRUPT_NO_CLEAR, &intr);
+		if (ret < 0)
+			return ret;
+	}
+
+	wl->stats.cmd_poll_completions++;
+	return 0;
+}
+
 /*
  * send command to firmware
  *
@@ -52,11 +156,10 @@ int wl1271_cmd_send(struct wl1271 *wl, u16 id, void *buf, size_t len,
 		    size_t res_len)
 {
 	struct wl1271_cmd_header *cmd;
-	unsigned long timeout;
-	u32 intr;
+	ktime_t start;
 	int ret = 0;
 	u16 status;
-	u16 poll_count = 0;
+	u32 trig;
 
 	cmd = buf;
 	cmd->id = cpu_to_le16(id);
@@ -64,37 +167,29 @@ int wl1271_cmd_send(struct wl1271 *wl, u16 id, void *buf, size_t len,
 	WARN_ON_ONCE(len % 4 != 0);
 	WARN_ON_ONCE(test_bit(WL1271_FLAG_IN_ELP, &wl->flags));
 
+	start = ktime_get();
+
 	ret = wl1271_write(wl, wl->cmd_box_addr, buf, len, false);
 	if (ret < 0)
 		goto fail;
 
-	ret = wl1271_write32(wl, ACX_REG_INTERRUPT_TRIG, INTR_TRIG_CMD);
+	/* an event ack still owed to the FW goes out with the trigger */
+	trig = INTR_TRIG_CMD;
+	if (wl->event_acks_pending) {
+		trig |= INTR_TRIG_EVENT_ACK;
+		wl->event_acks_pending--;
+		wl->stats.event_acks_folded++;
+	}
+
+	ret = wl1271_write32(wl, ACX_REG_INTERRUPT_TRIG, trig);
 	if (ret < 0)
 		goto fail;
 
-	timeout = jiffies + msecs_to_jiffies(WL1271_COMMAND_TIMEOUT);
-
-	ret = wl1271_read32(wl, ACX_REG_INTERRUPT_NO_CLEAR, &intr);
+	ret = wl1271_cmd_wait_complete(wl);
 	if (ret < 0)
 		goto fail;
 
-	while (!(intr & WL1271_ACX_INTR_CMD_COMPLETE)) {
-		if (time_after(jiffies, timeout)) {
-			wl1271_error("command complete timeout");
-			ret = -ETIMEDOUT;
-			goto fail;
-		}
-
-		poll_count++;
-		if (poll_count < WL1271_CMD_FAST_POLL_COUNT)
-			udelay(10);
-		else
-			msleep(1);
-
-		ret = wl1271_read32(wl, ACX_REG_INTERRUPT_NO_CLEAR, &intr);
-		if (ret < 0)
-			goto fail;
-	}
+	wl1271_cmd_record_latency(wl, id, buf, start);
 
 	/* read back the status code of the command */
 	if (res_len == 0)
@@ -470,6 +565,9 @@ int wl12xx_cmd_role_disable(struct wl1271 *wl, u8 *role_id)
 	__clear_bit(*role_id, wl->roles_map);
 	*role_id = WL12XX_INVALID_ROLE_ID;
 
+	/* a new role may reuse the id, drop the templates set on this one */
+	wl->scan.probe_templ_valid = 0;
+
 out_free:
 	kfree(cmd);
 
@@ -489,6 +587,12 @@ int wl12xx_allocate_link(struct wl1271 *wl, struct wl12xx_vif *wlvif, u8 *hlid)
 	__set_bit(link, wl->links_map);
 	__set_bit(link, wlvif->links_map);
 	spin_unlock_irqrestore(&wl->wl_lock, flags);
+
+	/* a new peer starts with no scheduler history */
+	memset(wl->links[link].tx_deficit, 0,
+	       sizeof(wl->links[link].tx_deficit));
+	wl->links[link].tx_rate = 0;
+
 	*hlid = link;
 	return 0;
 }
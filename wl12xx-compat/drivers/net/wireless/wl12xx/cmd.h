@@ -207,6 +207,35 @@ enum cmd_templ {
 #define WL1271_COMMAND_TIMEOUT     250
 #endif
 
+/*
+ * How long to sleep waiting for the command complete IRQ before falling
+ * back to polling, in ms
+ */
+#define WL1271_CMD_IRQ_TIMEOUT     20
+
+/* Command latency histogram: bucket 0 counts [0, 16) us, bucket i [8, 16) << i */
+#define WL1271_CMD_LAT_HIST_SHIFT  4
+#define WL1271_CMD_LAT_HIST_LEN    12
+
+/* ACX ids are below this, see enum in acx.h */
+#define WL1271_CMD_LAT_ACX_IDS     0x50
+
+struct wl1271_cmd_lat {
+	unsigned int count;
+	u32 max_us;
+	u64 total_us;
+	unsigned int hist[WL1271_CMD_LAT_HIST_LEN];
+};
+
+/* Per command and per ACX (for CMD_CONFIGURE/CMD_INTERROGATE) latencies */
+struct wl1271_cmd_lat_stats {
+	struct wl1271_cmd_lat cmd[CMD_LAST_COMMAND];
+	struct wl1271_cmd_lat acx[WL1271_CMD_LAT_ACX_IDS];
+};
+
+/* preallocated ACX command buffer size */
+#define WL1271_ACX_BUF_SIZE        512
+
 #define WL1271_CMD_TEMPL_DFLT_SIZE 252
 #define WL1271_CMD_TEMPL_MAX_SIZE  512
 #define WL1271_EVENT_TIMEOUT       1500
@@ -989,6 +989,23 @@ struct conf_conn_settings {
 	 * interrogating the FW status for each packets.
 	 */
 	u16 elp_timeout;
+
+	/*
+	 * Choose the ELP entry delay from the measured idle gaps between
+	 * activity and the measured wakeup latency, using elp_timeout as the
+	 * upper bound. Not used with forced_ps.
+	 *
+	 * Range: 0 - 1
+	 */
+	u8 elp_adaptive;
+
+	/*
+	 * Idle gaps longer than this many times the average wakeup latency
+	 * are not worth staying awake for.
+	 *
+	 * Range: 1 - 255
+	 */
+	u8 elp_break_even;
 };
 
 enum {
@@ -1348,6 +1365,13 @@ struct conf_drv_settings {
 	struct conf_rate_policy_settings rate;
 	struct conf_hangover_settings hangover;
 	u8 hci_io_ds;
+
+	/*
+	 * Period of the background firmware statistics refresh, in msecs.
+	 * 0 (the default) disables it. The refresh skips a chip in ELP,
+	 * debugfs then reads stale statistics on demand.
+	 */
+	u32 fw_stats_period;
 };
 
 #endif
@@ -25,6 +25,7 @@
 
 #include <linux/skbuff.h>
 #include <linux/slab.h>
+#include <linux/math64.h>
 
 #include "wl12xx.h"
 #include "debug.h"
@@ -110,16 +111,19 @@ static void wl1271_debugfs_update_stats(struct wl1271 *wl)
 
 	mutex_lock(&wl->mutex);
 
-	ret = wl1271_ps_elp_wakeup(wl);
+	/* fw_stats_work only refreshes the cache while the chip is awake */
+
+	if (wl->state != WL1271_STATE_ON ||
+	    !time_after(jiffies, wl->stats.fw_stats_update +
+			msecs_to_jiffies(WL1271_DEBUGFS_STATS_LIFETIME)))
+		goto out;
+
+	/* the command is built while the chip wakes up */
+	ret = wl1271_ps_elp_wakeup_start(wl);
 	if (ret < 0)
 		goto out;
 
-	if (wl->state == WL1271_STATE_ON &&
-	    time_after(jiffies, wl->stats.fw_stats_update +
-		       msecs_to_jiffies(WL1271_DEBUGFS_STATS_LIFETIME))) {
-		wl1271_acx_statistics(wl, wl->stats.fw_stats);
-		wl->stats.fw_stats_update = jiffies;
-	}
+	wl12xx_update_fw_stats(wl);
 
 	wl1271_ps_elp_sleep(wl);
 
@@ -227,6 +231,20 @@ DEBUGFS_FWSTATS_FILE(rxpipe, tx_xfr_host_int_trig_rx_data, "%u");
 DEBUGFS_READONLY_FILE(retry_count, "%u", wl->stats.retry_count);
 DEBUGFS_READONLY_FILE(excessive_retries, "%u",
 		      wl->stats.excessive_retries);
+DEBUGFS_READONLY_FILE(tx_sg_bursts, "%u", wl->stats.tx_sg_bursts);
+DEBUGFS_READONLY_FILE(tx_sg_bytes, "%llu",
+		      (unsigned long long)wl->stats.tx_sg_bytes);
+DEBUGFS_READONLY_FILE(tx_copy_bursts, "%u", wl->stats.tx_copy_bursts);
+DEBUGFS_READONLY_FILE(tx_copy_bytes, "%llu",
+		      (unsigned long long)wl->stats.tx_copy_bytes);
+DEBUGFS_READONLY_FILE(rx_zc_recycled, "%u", wl->stats.rx_zc_recycled);
+DEBUGFS_READONLY_FILE(rx_zc_allocated, "%u", wl->stats.rx_zc_allocated);
+DEBUGFS_READONLY_FILE(rx_zc_busy, "%u", wl->stats.rx_zc_busy);
+DEBUGFS_READONLY_FILE(cmd_irq_completions, "%u",
+		      wl->stats.cmd_irq_completions);
+DEBUGFS_READONLY_FILE(cmd_poll_completions, "%u",
+		      wl->stats.cmd_poll_completions);
+DEBUGFS_READONLY_FILE(scan_templ_reused, "%u", wl->stats.scan_templ_reused);
 
 static ssize_t tx_queue_len_read(struct file *file, char __user *userbuf,
 				 size_t count, loff_t *ppos)
@@ -248,6 +266,536 @@ static const struct file_operations tx_queue_len_ops = {
 	.llseek = default_llseek,
 };
 
+static ssize_t aggr_buf_size_write(struct wl1271 *wl, bool tx,
+				   const char __user *user_buf, size_t count)
+{
+	unsigned long value;
+	int ret;
+
+	ret = kstrtoul_from_user(user_buf, count, 10, &value);
+	if (ret < 0) {
+		wl1271_warning("illegal value in %s_aggr_buf_size",
+			       tx ? "tx" : "rx");
+		return -EINVAL;
+	}
+
+	if (value < WL1271_AGGR_BUFFER_SIZE_MIN ||
+	    value > WL1271_AGGR_BUFFER_SIZE_MAX) {
+		wl1271_warning("%s_aggr_buf_size must be between %lu and %lu",
+			       tx ? "tx" : "rx", WL1271_AGGR_BUFFER_SIZE_MIN,
+			       WL1271_AGGR_BUFFER_SIZE_MAX);
+		return -ERANGE;
+	}
+
+	mutex_lock(&wl->mutex);
+	ret = wl12xx_set_aggr_buf_size(wl, tx, value);
+	mutex_unlock(&wl->mutex);
+
+	return ret < 0 ? ret : count;
+}
+
+static ssize_t tx_aggr_buf_size_read(struct file *file, char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+
+	return wl1271_format_buffer(user_buf, count, ppos, "%u\n",
+				    wl->tx_aggr_buf_size);
+}
+
+static ssize_t tx_aggr_buf_size_write(struct file *file,
+				      const char __user *user_buf,
+				      size_t count, loff_t *ppos)
+{
+	return aggr_buf_size_write(file->private_data, true, user_buf, count);
+}
+
+static const struct file_operations tx_aggr_buf_size_ops = {
+	.read = tx_aggr_buf_size_read,
+	.write = tx_aggr_buf_size_write,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static ssize_t rx_aggr_buf_size_read(struct file *file, char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+
+	return wl1271_format_buffer(user_buf, count, ppos, "%u\n",
+				    wl->rx_aggr_buf_size);
+}
+
+static ssize_t rx_aggr_buf_size_write(struct file *file,
+				      const char __user *user_buf,
+				      size_t count, loff_t *ppos)
+{
+	return aggr_buf_size_write(file->private_data, false, user_buf, count);
+}
+
+static const struct file_operations rx_aggr_buf_size_ops = {
+	.read = rx_aggr_buf_size_read,
+	.write = rx_aggr_buf_size_write,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static const char * const aggr_flush_names[WL1271_AGGR_FLUSH_MAX] = {
+	[WL1271_AGGR_FLUSH_BUF_FULL]	= "buf_full",
+	[WL1271_AGGR_FLUSH_FW_BUSY]	= "fw_busy",
+	[WL1271_AGGR_FLUSH_QUEUE_EMPTY]	= "queue_empty",
+	[WL1271_AGGR_FLUSH_OTHER]	= "other",
+};
+
+static int aggr_stats_print(char *buf, int len, const char *dir,
+			    unsigned int *hist, unsigned int *flush)
+{
+	int res = 0;
+	int i;
+
+	res += scnprintf(buf + res, len - res, "%s bytes per transaction:\n",
+			 dir);
+	for (i = 0; i < WL1271_AGGR_HIST_LEN; i++) {
+		u32 lo = i ? (1 << (WL1271_AGGR_HIST_SHIFT + i - 1)) : 0;
+
+		if (i == WL1271_AGGR_HIST_LEN - 1)
+			res += scnprintf(buf + res, len - res,
+					 "  %6u+       %u\n", lo, hist[i]);
+		else
+			res += scnprintf(buf + res, len - res,
+					 "  %6u-%-6u %u\n", lo,
+					 (1 << (WL1271_AGGR_HIST_SHIFT + i)) - 1,
+					 hist[i]);
+	}
+
+	res += scnprintf(buf + res, len - res, "%s flush reasons:\n", dir);
+	for (i = 0; i < WL1271_AGGR_FLUSH_MAX; i++)
+		res += scnprintf(buf + res, len - res, "  %-12s %u\n",
+				 aggr_flush_names[i], flush[i]);
+
+	return res;
+}
+
+static ssize_t aggr_stats_read(struct file *file, char __user *user_buf,
+			       size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	int res = 0;
+	ssize_t ret;
+	char *buf;
+
+#define AGGR_STATS_BUF_LEN 1024
+
+	buf = kmalloc(AGGR_STATS_BUF_LEN, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&wl->mutex);
+	res += aggr_stats_print(buf + res, AGGR_STATS_BUF_LEN - res, "tx",
+				wl->stats.tx_aggr_hist,
+				wl->stats.tx_aggr_flush);
+	res += aggr_stats_print(buf + res, AGGR_STATS_BUF_LEN - res, "rx",
+				wl->stats.rx_aggr_hist,
+				wl->stats.rx_aggr_flush);
+	mutex_unlock(&wl->mutex);
+
+	ret = simple_read_from_buffer(user_buf, count, ppos, buf, res);
+	kfree(buf);
+	return ret;
+}
+
+static const struct file_operations aggr_stats_ops = {
+	.read = aggr_stats_read,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static ssize_t tx_sched_read(struct file *file, char __user *user_buf,
+			     size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+
+	return wl1271_format_buffer(user_buf, count, ppos, "%d\n",
+				    wl->tx_sched);
+}
+
+static ssize_t tx_sched_write(struct file *file,
+			      const char __user *user_buf,
+			      size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	unsigned long value;
+	int ret;
+
+	ret = kstrtoul_from_user(user_buf, count, 10, &value);
+	if (ret < 0) {
+		wl1271_warning("illegal value in tx_sched");
+		return -EINVAL;
+	}
+
+	if (value != WL12XX_TX_SCHED_RR && value != WL12XX_TX_SCHED_DRR) {
+		wl1271_warning("tx_sched must be %d (rr) or %d (drr)",
+			       WL12XX_TX_SCHED_RR, WL12XX_TX_SCHED_DRR);
+		return -ERANGE;
+	}
+
+	/* the TX work runs under the mutex, so this is between dequeues */
+	mutex_lock(&wl->mutex);
+	wl->tx_sched = value;
+	mutex_unlock(&wl->mutex);
+
+	return count;
+}
+
+static const struct file_operations tx_sched_ops = {
+	.read = tx_sched_read,
+	.write = tx_sched_write,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static int cmd_lat_print(char *buf, int len, const char *type, int id,
+			 struct wl1271_cmd_lat *lat)
+{
+	int res;
+	int i;
+
+	res = scnprintf(buf, len, "%s 0x%02x: %6u %6llu %6u |", type, id,
+			lat->count,
+			(unsigned long long)div_u64(lat->total_us, lat->count),
+			lat->max_us);
+	for (i = 0; i < WL1271_CMD_LAT_HIST_LEN; i++)
+		res += scnprintf(buf + res, len - res, " %u", lat->hist[i]);
+	res += scnprintf(buf + res, len - res, "\n");
+
+	return res;
+}
+
+static ssize_t cmd_latency_read(struct file *file, char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	struct wl1271_cmd_lat_stats *stats = wl->stats.cmd_lat;
+	int res = 0;
+	ssize_t ret;
+	char *buf;
+	int i;
+
+#define CMD_LAT_LINE_LEN 160
+#define CMD_LAT_BUF_LEN \
+	((CMD_LAST_COMMAND + WL1271_CMD_LAT_ACX_IDS + 1) * CMD_LAT_LINE_LEN)
+
+	buf = kmalloc(CMD_LAT_BUF_LEN, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	res += scnprintf(buf + res, CMD_LAT_BUF_LEN - res,
+			 "id         count avg_us max_us | "
+			 "<16us, then doubling buckets\n");
+
+	mutex_lock(&wl->mutex);
+
+	for (i = 0; i < CMD_LAST_COMMAND; i++)
+		if (stats->cmd[i].count)
+			res += cmd_lat_print(buf + res, CMD_LAT_BUF_LEN - res,
+					     "cmd", i, &stats->cmd[i]);
+
+	for (i = 0; i < WL1271_CMD_LAT_ACX_IDS; i++)
+		if (stats->acx[i].count)
+			res += cmd_lat_print(buf + res, CMD_LAT_BUF_LEN - res,
+					     "acx", i, &stats->acx[i]);
+
+	mutex_unlock(&wl->mutex);
+
+	ret = simple_read_from_buffer(user_buf, count, ppos, buf, res);
+	kfree(buf);
+	return ret;
+}
+
+static const struct file_operations cmd_latency_ops = {
+	.read = cmd_latency_read,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static ssize_t irq_stats_read(struct file *file, char __user *user_buf,
+			      size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	u64 ops, pkts;
+	char buf[768];
+	int res = 0;
+	int i;
+
+	mutex_lock(&wl->mutex);
+
+	ops = wl->stats.irq_bus_ops;
+	pkts = wl->stats.irq_packets;
+
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "irq runs: %u bus ops: %llu frames: %llu\n",
+			 wl->stats.irq_runs, (unsigned long long)ops,
+			 (unsigned long long)pkts);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "bus ops per run (x100): %llu per frame (x100): %llu\n",
+			 wl->stats.irq_runs ? (unsigned long long)
+				div64_u64(ops * 100, wl->stats.irq_runs) : 0ULL,
+			 pkts ? (unsigned long long)
+				div64_u64(ops * 100, pkts) : 0ULL);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "bus ops per run histogram:");
+	for (i = 0; i < WL12XX_IRQ_BUS_OPS_HIST_LEN; i++)
+		res += scnprintf(buf + res, sizeof(buf) - res, " %u",
+				 wl->stats.irq_bus_ops_hist[i]);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "\nall bus ops: %llu tx result acks deferred: %u\n",
+			 (unsigned long long)wl->stats.bus_ops,
+			 wl->stats.tx_result_acks_deferred);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "event mailboxes: %u dual reads: %u acks folded: %u\n"
+			 "event work runs: %u events: %u\n",
+			 wl->stats.event_mboxes, wl->stats.event_dual_reads,
+			 wl->stats.event_acks_folded, wl->stats.event_work_runs,
+			 wl->stats.event_work_events);
+
+	mutex_unlock(&wl->mutex);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, res);
+}
+
+static const struct file_operations irq_stats_ops = {
+	.read = irq_stats_read,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+/* a counter of another CPU, without a torn read on 32 bit */
+static u64 wl12xx_pcpu_read(struct wl1271 *wl, int cpu, const u64 *counter)
+{
+#if BITS_PER_LONG == 32
+	const struct u64_stats_sync *syncp = per_cpu_ptr(wl->pcpu_syncp, cpu);
+	unsigned int start;
+	u64 val;
+
+	do {
+		start = u64_stats_fetch_begin(syncp);
+		val = *counter;
+	} while (u64_stats_fetch_retry(syncp, start));
+
+	return val;
+#else
+	return ACCESS_ONCE(*counter);
+#endif
+}
+
+static int stats_snapshot_open(struct inode *inode, struct file *file)
+{
+	struct wl1271 *wl = inode->i_private;
+	struct wl12xx_stats_snapshot *snap;
+	const u64 *src;
+	u64 *dst;
+	int cpu, i;
+
+	BUILD_BUG_ON(sizeof(struct wl12xx_pcpu_stats) % sizeof(u64));
+
+	snap = kzalloc(sizeof(*snap), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	snap->magic = WL12XX_STATS_SNAPSHOT_MAGIC;
+	snap->version = WL12XX_STATS_SNAPSHOT_VERSION;
+	snap->len = sizeof(*snap);
+	snap->timestamp_ns = ktime_to_ns(ktime_get());
+
+	dst = (u64 *)&snap->counters;
+	for_each_possible_cpu(cpu) {
+		src = (const u64 *)per_cpu_ptr(wl->pcpu_stats, cpu);
+		for (i = 0; i < sizeof(snap->counters) / sizeof(u64); i++)
+			dst[i] += wl12xx_pcpu_read(wl, cpu, &src[i]);
+	}
+
+	/* single writer under wl->mutex, a racy copy is good enough */
+	memcpy(snap->tx_aggr_flush, wl->stats.tx_aggr_flush,
+	       sizeof(snap->tx_aggr_flush));
+	memcpy(snap->rx_aggr_flush, wl->stats.rx_aggr_flush,
+	       sizeof(snap->rx_aggr_flush));
+	snap->elp_wakeups = wl->stats.elp_wakeups;
+	snap->elp_wake_max_us = wl->stats.elp_wake_max_us;
+
+	snap->fw_stats_age_ms = jiffies_to_msecs(jiffies -
+						 wl->stats.fw_stats_update);
+	spin_lock(&wl->fw_stats_lock);
+	memcpy(&snap->fw, wl->stats.fw_stats, sizeof(snap->fw));
+	spin_unlock(&wl->fw_stats_lock);
+
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t stats_snapshot_read(struct file *file, char __user *user_buf,
+				   size_t count, loff_t *ppos)
+{
+	return simple_read_from_buffer(user_buf, count, ppos,
+				       file->private_data,
+				       sizeof(struct wl12xx_stats_snapshot));
+}
+
+static int stats_snapshot_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations stats_snapshot_ops = {
+	.read = stats_snapshot_read,
+	.open = stats_snapshot_open,
+	.release = stats_snapshot_release,
+	.llseek = default_llseek,
+};
+
+static ssize_t boot_timings_read(struct file *file, char __user *user_buf,
+				 size_t count, loff_t *ppos)
+{
+	static const char * const phase_names[WL12XX_BOOT_PHASE_MAX] = {
+		[WL12XX_BOOT_PHASE_NVS]		= "nvs_upload",
+		[WL12XX_BOOT_PHASE_FW]		= "fw_upload",
+		[WL12XX_BOOT_PHASE_RUN_FW]	= "run_firmware",
+		[WL12XX_BOOT_PHASE_HW_INIT]	= "hw_init",
+	};
+	struct wl1271 *wl = file->private_data;
+	char buf[768];
+	int res = 0;
+	int i;
+
+	mutex_lock(&wl->mutex);
+
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "phase          last_us     max_us\n");
+	for (i = 0; i < WL12XX_BOOT_PHASE_MAX; i++)
+		res += scnprintf(buf + res, sizeof(buf) - res,
+				 "%-12s %9u %10u\n", phase_names[i],
+				 wl->stats.boot_phase_us[i],
+				 wl->stats.boot_phase_max_us[i]);
+
+	if (wl->fw)
+		res += scnprintf(buf + res, sizeof(buf) - res,
+				 "fw_pieces: %d (%zu B), "
+				 "partition switches: %u\n",
+				 wl->fw->num_chunks, wl->fw->len,
+				 wl->stats.fw_upload_part_switches);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "fw_cache: hits %u misses %u preloads %u\n",
+			 wl->stats.fw_cache_hits, wl->stats.fw_cache_misses,
+			 wl->stats.fw_preloads);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "recovery_light (IRQ handler rerun, up to %u ms "
+			 "wait, no soft reset): %u ms %u max %u escalated %u\n",
+			 WL12XX_RECOVERY_LIGHT_TIMEOUT,
+			 wl->stats.recoveries[WL12XX_RECOVERY_LIGHT],
+			 wl->stats.recovery_ms[WL12XX_RECOVERY_LIGHT],
+			 wl->stats.recovery_max_ms[WL12XX_RECOVERY_LIGHT],
+			 wl->stats.recovery_escalations);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "recovery_full: %u ms %u max %u\n",
+			 wl->stats.recoveries[WL12XX_RECOVERY_FULL],
+			 wl->stats.recovery_ms[WL12XX_RECOVERY_FULL],
+			 wl->stats.recovery_max_ms[WL12XX_RECOVERY_FULL]);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "recovery_to_boot_ms: %u max %u\n",
+			 wl->stats.recovery_boot_ms,
+			 wl->stats.recovery_boot_max_ms);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "ifup_to_first_frame_ms: %u max %u\n",
+			 wl->stats.ttff_ms, wl->stats.ttff_max_ms);
+
+	mutex_unlock(&wl->mutex);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, res);
+}
+
+static const struct file_operations boot_timings_ops = {
+	.read = boot_timings_read,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static ssize_t scan_stats_read(struct file *file, char __user *user_buf,
+			       size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	char buf[256];
+	u32 avg = 0;
+	int res;
+
+	mutex_lock(&wl->mutex);
+
+	if (wl->stats.scan_ttfc_count)
+		avg = div_u64(wl->stats.scan_ttfc_total_us,
+			      wl->stats.scan_ttfc_count);
+
+	res = scnprintf(buf, sizeof(buf),
+			"scans: %u commands %u without candidates %u\n"
+			"scan_ms: %u max %u\n"
+			"first_candidate_us: %u avg %u max %u\n",
+			wl->stats.scans, wl->stats.scan_cmds,
+			wl->stats.scans_no_candidate,
+			wl->stats.scan_ms, wl->stats.scan_max_ms,
+			wl->stats.scan_ttfc_us, avg,
+			wl->stats.scan_ttfc_max_us);
+
+	mutex_unlock(&wl->mutex);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, res);
+}
+
+static const struct file_operations scan_stats_ops = {
+	.read = scan_stats_read,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static ssize_t rx_napi_stats_read(struct file *file, char __user *user_buf,
+				  size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	u64 frames = wl->stats.rx_napi_frames;
+	unsigned int polls = wl->stats.rx_napi_polls;
+	char buf[512];
+	int res = 0;
+	int i;
+
+	/* updated by the poll without wl->mutex, a racy read will do */
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "enabled: %d budget: %d coalesce: %u\n",
+			 wl->rx_napi, wl->rx_napi ? wl->napi.weight : 0,
+			 wl->rx_napi_coalesce);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "kicks: %u passes ended at coalesce threshold: %u\n",
+			 wl->stats.rx_napi_kicks,
+			 wl->stats.rx_napi_coalesce_kicks);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "polls: %u frames: %llu per poll (x100): %llu "
+			 "budget exhausted: %u\n",
+			 polls, (unsigned long long)frames,
+			 polls ? (unsigned long long)
+				div64_u64(frames * 100, polls) : 0ULL,
+			 wl->stats.rx_napi_exhausted);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "frames per poll histogram (0 1 2-3 4-7 ...):");
+	for (i = 0; i < WL12XX_RX_NAPI_HIST_LEN; i++)
+		res += scnprintf(buf + res, sizeof(buf) - res, " %u",
+				 wl->stats.rx_napi_hist[i]);
+	res += scnprintf(buf + res, sizeof(buf) - res, "\n");
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, res);
+}
+
+static const struct file_operations rx_napi_stats_ops = {
+	.read = rx_napi_stats_read,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
 static ssize_t gpio_power_read(struct file *file, char __user *user_buf,
 			  size_t count, loff_t *ppos)
 {
@@ -532,6 +1080,90 @@ static const struct file_operations elp_timeout_ops = {
 	.llseek = default_llseek,
 };
 
+static ssize_t elp_adaptive_read(struct file *file, char __user *user_buf,
+				 size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+
+	return wl1271_format_buffer(user_buf, count,
+				    ppos, "%d\n",
+				    wl->conf.conn.elp_adaptive);
+}
+
+static ssize_t elp_adaptive_write(struct file *file,
+				  const char __user *user_buf,
+				  size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	unsigned long value;
+	int ret;
+
+	ret = kstrtoul_from_user(user_buf, count, 10, &value);
+	if (ret < 0) {
+		wl1271_warning("illegal value in elp_adaptive");
+		return -EINVAL;
+	}
+
+	if (value > 1) {
+		wl1271_warning("elp_adaptive must be 0 or 1");
+		return -ERANGE;
+	}
+
+	mutex_lock(&wl->mutex);
+
+	wl->conf.conn.elp_adaptive = value;
+
+	mutex_unlock(&wl->mutex);
+	return count;
+}
+
+static const struct file_operations elp_adaptive_ops = {
+	.read = elp_adaptive_read,
+	.write = elp_adaptive_write,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static ssize_t elp_stats_read(struct file *file, char __user *user_buf,
+			      size_t count, loff_t *ppos)
+{
+	struct wl1271 *wl = file->private_data;
+	char buf[512];
+	int res = 0;
+	int i;
+
+	mutex_lock(&wl->mutex);
+
+	wl1271_ps_elp_rate_update(wl);
+
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "wakeups: %u per second: %u max_us: %u "
+			 "overlapped: %u\n",
+			 wl->stats.elp_wakeups, wl->stats.elp_wakeups_per_sec,
+			 wl->stats.elp_wake_max_us,
+			 wl->stats.elp_wake_overlapped);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "wakeup latency (<128us, then doubling):");
+	for (i = 0; i < WL1271_ELP_WAKE_HIST_LEN; i++)
+		res += scnprintf(buf + res, sizeof(buf) - res, " %u",
+				 wl->stats.elp_wake_hist[i]);
+	res += scnprintf(buf + res, sizeof(buf) - res,
+			 "\navg wakeup us: %u avg idle gap us: %u "
+			 "entry delay ms: %u\n",
+			 wl->elp_wake_avg_us, wl->elp_gap_avg_us,
+			 wl->elp_entry_delay);
+
+	mutex_unlock(&wl->mutex);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, res);
+}
+
+static const struct file_operations elp_stats_ops = {
+	.read = elp_stats_read,
+	.open = wl1271_open_file_generic,
+	.llseek = default_llseek,
+};
+
 
 static ssize_t driver_state_read(struct file *file, char __user *user_buf,
 				 size_t count, loff_t *ppos)
@@ -574,10 +1206,14 @@ static ssize_t driver_state_read(struct file *file, char __user *user_buf,
 	DRIVER_STATE_PRINT_INT(tx_allocated_pkts[3]);
 	DRIVER_STATE_PRINT_INT(tx_frames_cnt);
 	DRIVER_STATE_PRINT_LHEX(tx_frames_map[0]);
-	DRIVER_STATE_PRINT_INT(tx_queue_count[0]);
-	DRIVER_STATE_PRINT_INT(tx_queue_count[1]);
-	DRIVER_STATE_PRINT_INT(tx_queue_count[2]);
-	DRIVER_STATE_PRINT_INT(tx_queue_count[3]);
+	DRIVER_STATE_PRINT_GENERIC(tx_queue_count[0], "%d",
+				   atomic_read(&wl->tx_queue_count[0]));
+	DRIVER_STATE_PRINT_GENERIC(tx_queue_count[1], "%d",
+				   atomic_read(&wl->tx_queue_count[1]));
+	DRIVER_STATE_PRINT_GENERIC(tx_queue_count[2], "%d",
+				   atomic_read(&wl->tx_queue_count[2]));
+	DRIVER_STATE_PRINT_GENERIC(tx_queue_count[3], "%d",
+				   atomic_read(&wl->tx_queue_count[3]));
 	DRIVER_STATE_PRINT_INT(tx_packets_count);
 	DRIVER_STATE_PRINT_INT(tx_results_count);
 	DRIVER_STATE_PRINT_LHEX(flags);
@@ -1166,6 +1802,26 @@ static int wl1271_debugfs_add_files(struct wl1271 *wl,
 	DEBUGFS_ADD(tx_queue_len, rootdir);
 	DEBUGFS_ADD(retry_count, rootdir);
 	DEBUGFS_ADD(excessive_retries, rootdir);
+	DEBUGFS_ADD(tx_sg_bursts, rootdir);
+	DEBUGFS_ADD(tx_sg_bytes, rootdir);
+	DEBUGFS_ADD(tx_copy_bursts, rootdir);
+	DEBUGFS_ADD(tx_copy_bytes, rootdir);
+	DEBUGFS_ADD(rx_zc_recycled, rootdir);
+	DEBUGFS_ADD(rx_zc_allocated, rootdir);
+	DEBUGFS_ADD(rx_zc_busy, rootdir);
+	DEBUGFS_ADD(tx_aggr_buf_size, rootdir);
+	DEBUGFS_ADD(rx_aggr_buf_size, rootdir);
+	DEBUGFS_ADD(aggr_stats, rootdir);
+	DEBUGFS_ADD(tx_sched, rootdir);
+	DEBUGFS_ADD(cmd_irq_completions, rootdir);
+	DEBUGFS_ADD(cmd_poll_completions, rootdir);
+	DEBUGFS_ADD(cmd_latency, rootdir);
+	DEBUGFS_ADD(boot_timings, rootdir);
+	DEBUGFS_ADD(irq_stats, rootdir);
+	DEBUGFS_ADD(stats_snapshot, rootdir);
+	DEBUGFS_ADD(scan_templ_reused, rootdir);
+	DEBUGFS_ADD(scan_stats, rootdir);
+	DEBUGFS_ADD(rx_napi_stats, rootdir);
 
 	DEBUGFS_ADD(gpio_power, rootdir);
 	DEBUGFS_ADD(start_recovery, rootdir);
@@ -1179,6 +1835,8 @@ static int wl1271_debugfs_add_files(struct wl1271 *wl,
 	DEBUGFS_ADD(forced_ps, rootdir);
 	DEBUGFS_ADD(split_scan_timeout, rootdir);
 	DEBUGFS_ADD(elp_timeout, rootdir);
+	DEBUGFS_ADD(elp_adaptive, rootdir);
+	DEBUGFS_ADD(elp_stats, rootdir);
 
 	streaming = debugfs_create_dir("rx_streaming", rootdir);
 	if (!streaming || IS_ERR(streaming))
@@ -1204,9 +1862,57 @@ void wl1271_debugfs_reset(struct wl1271 *wl)
 	if (!wl->stats.fw_stats)
 		return;
 
+	spin_lock(&wl->fw_stats_lock);
 	memset(wl->stats.fw_stats, 0, sizeof(*wl->stats.fw_stats));
+	spin_unlock(&wl->fw_stats_lock);
 	wl->stats.retry_count = 0;
 	wl->stats.excessive_retries = 0;
+	wl->stats.tx_sg_bursts = 0;
+	wl->stats.tx_sg_bytes = 0;
+	wl->stats.tx_copy_bursts = 0;
+	wl->stats.tx_copy_bytes = 0;
+	wl->stats.rx_zc_recycled = 0;
+	wl->stats.rx_zc_allocated = 0;
+	wl->stats.rx_zc_busy = 0;
+	memset(wl->stats.tx_aggr_hist, 0, sizeof(wl->stats.tx_aggr_hist));
+	memset(wl->stats.rx_aggr_hist, 0, sizeof(wl->stats.rx_aggr_hist));
+	memset(wl->stats.tx_aggr_flush, 0, sizeof(wl->stats.tx_aggr_flush));
+	memset(wl->stats.rx_aggr_flush, 0, sizeof(wl->stats.rx_aggr_flush));
+	wl->stats.cmd_irq_completions = 0;
+	wl->stats.cmd_poll_completions = 0;
+	wl->stats.scan_templ_reused = 0;
+	wl->stats.scans = 0;
+	wl->stats.scan_cmds = 0;
+	wl->stats.scans_no_candidate = 0;
+	wl->stats.scan_ms = 0;
+	wl->stats.scan_max_ms = 0;
+	wl->stats.scan_ttfc_us = 0;
+	wl->stats.scan_ttfc_max_us = 0;
+	wl->stats.scan_ttfc_total_us = 0;
+	wl->stats.scan_ttfc_count = 0;
+	memset(wl->stats.cmd_lat, 0, sizeof(*wl->stats.cmd_lat));
+	wl->stats.irq_runs = 0;
+	wl->stats.irq_bus_ops = 0;
+	wl->stats.irq_packets = 0;
+	memset(wl->stats.irq_bus_ops_hist, 0,
+	       sizeof(wl->stats.irq_bus_ops_hist));
+	wl->stats.rx_napi_coalesce_kicks = 0;
+	wl->stats.rx_napi_kicks = 0;
+	wl->stats.rx_napi_polls = 0;
+	wl->stats.rx_napi_frames = 0;
+	wl->stats.rx_napi_exhausted = 0;
+	memset(wl->stats.rx_napi_hist, 0, sizeof(wl->stats.rx_napi_hist));
+	wl->stats.tx_result_acks_deferred = 0;
+	wl->stats.event_mboxes = 0;
+	wl->stats.event_dual_reads = 0;
+	wl->stats.event_acks_folded = 0;
+	wl->stats.event_work_runs = 0;
+	wl->stats.event_work_events = 0;
+	wl->stats.elp_wakeups = 0;
+	wl->stats.elp_wakeups_per_sec = 0;
+	memset(wl->stats.elp_wake_hist, 0, sizeof(wl->stats.elp_wake_hist));
+	wl->stats.elp_wake_max_us = 0;
+	wl->stats.elp_wake_overlapped = 0;
 }
 
 int wl1271_debugfs_init(struct wl1271 *wl)
@@ -1232,6 +1938,12 @@ int wl1271_debugfs_init(struct wl1271 *wl)
 
 	wl->stats.fw_stats_update = jiffies;
 
+	wl->stats.cmd_lat = kzalloc(sizeof(*wl->stats.cmd_lat), GFP_KERNEL);
+	if (!wl->stats.cmd_lat) {
+		ret = -ENOMEM;
+		goto err_cmd_lat;
+	}
+
 	ret = wl1271_debugfs_add_files(wl, rootdir);
 
 	if (ret < 0)
@@ -1240,6 +1952,10 @@ int wl1271_debugfs_init(struct wl1271 *wl)
 	return 0;
 
 err_file:
+	kfree(wl->stats.cmd_lat);
+	wl->stats.cmd_lat = NULL;
+
+err_cmd_lat:
 	kfree(wl->stats.fw_stats);
 	wl->stats.fw_stats = NULL;
 
@@ -1252,6 +1968,8 @@ err:
 
 void wl1271_debugfs_exit(struct wl1271 *wl)
 {
+	kfree(wl->stats.cmd_lat);
+	wl->stats.cmd_lat = NULL;
 	kfree(wl->stats.fw_stats);
 	wl->stats.fw_stats = NULL;
 }
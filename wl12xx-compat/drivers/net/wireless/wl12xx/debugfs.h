@@ -25,6 +25,38 @@
 #define __DEBUGFS_H__
 
 #include "wl12xx.h"
+#include "acx.h"
+
+#define WL12XX_STATS_SNAPSHOT_MAGIC	0x574c5353	/* "WLSS" */
+#define WL12XX_STATS_SNAPSHOT_VERSION	1
+
+/*
+ * Contents of the stats_snapshot file, in host byte order except for the
+ * FW counters in fw, which are copied as the FW wrote them, little endian.
+ * Each open takes a new snapshot without wl->mutex or waking the chip,
+ * pollers reopen the file. New fields are only appended, with the version
+ * bumped.
+ */
+struct wl12xx_stats_snapshot {
+	u32 magic;
+	u16 version;
+	u16 reserved;
+	u32 len;
+	/* age of the FW counters in fw, in msecs */
+	u32 fw_stats_age_ms;
+	/* CLOCK_MONOTONIC time of the snapshot, in nsecs */
+	u64 timestamp_ns;
+
+	struct wl12xx_pcpu_stats counters;
+
+	u32 tx_aggr_flush[WL1271_AGGR_FLUSH_MAX];
+	u32 rx_aggr_flush[WL1271_AGGR_FLUSH_MAX];
+	u32 elp_wakeups;
+	u32 elp_wake_max_us;
+
+	/* raw FW block, little endian */
+	struct acx_statistics fw;
+} __packed;
 
 int wl1271_debugfs_init(struct wl1271 *wl);
 void wl1271_debugfs_exit(struct wl1271 *wl);
@@ -30,13 +30,20 @@
 #include "scan.h"
 #include "wl12xx_80211.h"
 
+/*
+ * Events whose handling sends commands or calls into mac80211 at length.
+ * They are left to wl1271_event_work() so the IRQ loop gets back to RX and
+ * TX sooner, several of them in a row are handled in one run.
+ */
+#define WL1271_EVENT_DEFERRED	(SCAN_COMPLETE_EVENT_ID | \
+				 RSSI_SNR_TRIGGER_0_EVENT_ID | \
+				 BA_SESSION_RX_CONSTRAINT_EVENT_ID)
+
 static void wl1271_event_rssi_trigger(struct wl1271 *wl,
-				      struct wl12xx_vif *wlvif,
-				      struct event_mailbox *mbox)
+				      struct wl12xx_vif *wlvif, s8 metric)
 {
 	struct ieee80211_vif *vif = wl12xx_wlvif_to_vif(wlvif);
 	enum nl80211_cqm_rssi_threshold_event event;
-	s8 metric = mbox->rssi_snr_trigger_metric[0];
 
 	wl1271_debug(DEBUG_EVENT, "RSSI trigger metric: %d", metric);
 
@@ -75,6 +82,15 @@ static void wl1271_stop_ba_event(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 	}
 }
 
+/* vifs without a role only take the events meant for any role */
+static u8 wl1271_event_role_bit(u8 role_id)
+{
+	if (role_id < WL12XX_MAX_ROLES)
+		return BIT(role_id);
+
+	return BIT(WL12XX_MAX_ROLES);
+}
+
 static void wl12xx_event_soft_gemini_sense(struct wl1271 *wl,
 					       u8 enable)
 {
@@ -159,13 +175,10 @@ static int wl1271_event_process(struct wl1271 *wl, struct event_mailbox *mbox)
 		--wl->log_wakes;
 	}
 
-	if (vector & SCAN_COMPLETE_EVENT_ID) {
+	if (vector & SCAN_COMPLETE_EVENT_ID)
 		wl1271_debug(DEBUG_EVENT, "status: 0x%x",
 			     mbox->scheduled_scan_status);
 
-		wl1271_scan_stm(wl, wl->scan_vif);
-	}
-
 	if (vector & PERIODIC_SCAN_REPORT_EVENT_ID) {
 		wl1271_debug(DEBUG_EVENT, "PERIODIC_SCAN_REPORT_EVENT "
 			     "(status 0x%0x)", mbox->scheduled_scan_status);
@@ -203,30 +216,35 @@ static int wl1271_event_process(struct wl1271 *wl, struct event_mailbox *mbox)
 		beacon_loss = true;
 	}
 
+	/* the latest metric is all the work needs to report */
 	if (vector & RSSI_SNR_TRIGGER_0_EVENT_ID) {
-		/* TODO: check actual multi-role support */
 		wl1271_debug(DEBUG_EVENT, "RSSI_SNR_TRIGGER_0_EVENT");
-		wl12xx_for_each_wlvif_sta(wl, wlvif) {
-			wl1271_event_rssi_trigger(wl, wlvif, mbox);
-		}
+		wl->event_rssi_metric = mbox->rssi_snr_trigger_metric[0];
 	}
 
 	if (vector & BA_SESSION_RX_CONSTRAINT_EVENT_ID) {
 		u8 role_id = mbox->role_id;
+		u8 roles;
+
 		wl1271_debug(DEBUG_EVENT, "BA_SESSION_RX_CONSTRAINT_EVENT_ID. "
 			     "ba_allowed = 0x%x, role_id=%d",
 			     mbox->rx_ba_allowed, role_id);
 
-		wl12xx_for_each_wlvif(wl, wlvif) {
-			if (role_id != 0xff && role_id != wlvif->role_id)
-				continue;
-
-			wlvif->ba_allowed = !!mbox->rx_ba_allowed;
-			if (!wlvif->ba_allowed)
-				wl1271_stop_ba_event(wl, wlvif);
-		}
+		/* 0xff is any role, a later event overrides an earlier one */
+		if (role_id == 0xff)
+			roles = BIT(WL12XX_MAX_ROLES + 1) - 1;
+		else
+			roles = wl1271_event_role_bit(role_id);
+
+		wl->event_ba_roles |= roles;
+		if (mbox->rx_ba_allowed)
+			wl->event_ba_allowed |= roles;
+		else
+			wl->event_ba_allowed &= ~roles;
 	}
 
+	wl->event_work_vector |= vector & WL1271_EVENT_DEFERRED;
+
 	if (vector & CHANNEL_SWITCH_COMPLETE_EVENT_ID) {
 		wl1271_debug(DEBUG_EVENT, "CHANNEL_SWITCH_COMPLETE_EVENT_ID. "
 					  "status = 0x%x",
@@ -360,6 +378,10 @@ int wl1271_event_mbox_config(struct wl1271 *wl)
 	if (ret < 0)
 		return ret;
 
+	/* nothing is owed to a freshly booted FW */
+	wl->event_acks_pending = 0;
+	wl->event_work_vector = 0;
+
 	wl->mbox_ptr[1] = wl->mbox_ptr[0] + sizeof(struct event_mailbox);
 
 	wl1271_debug(DEBUG_EVENT, "MBOX ptrs: 0x%x 0x%x",
@@ -368,28 +390,119 @@ int wl1271_event_mbox_config(struct wl1271 *wl)
 	return 0;
 }
 
-int wl1271_event_handle(struct wl1271 *wl, u8 mbox_num)
+/*
+ * Let the FW know it can reuse the mailboxes read so far. wl1271_cmd_send()
+ * takes one ack along with its trigger, this sends what is left.
+ */
+int wl1271_event_ack_flush(struct wl1271 *wl)
 {
 	int ret;
 
-	wl1271_debug(DEBUG_EVENT, "EVENT on mbox %d", mbox_num);
+	while (wl->event_acks_pending) {
+		ret = wl1271_write32(wl, ACX_REG_INTERRUPT_TRIG,
+				     INTR_TRIG_EVENT_ACK);
+		if (ret < 0)
+			return ret;
+
+		wl->event_acks_pending--;
+	}
 
-	if (mbox_num > 1)
+	return 0;
+}
+
+/*
+ * Handle the mailboxes flagged in @intr. The acks are left pending, the
+ * caller flushes them unless the event work was queued to do it.
+ */
+int wl1271_event_handle(struct wl1271 *wl, u32 intr)
+{
+	int first = (intr & WL1271_ACX_INTR_EVENT_A) ? 0 : 1;
+	int last = (intr & WL1271_ACX_INTR_EVENT_B) ? 1 : 0;
+	int i, ret;
+
+	wl1271_debug(DEBUG_EVENT, "EVENT on mbox %d..%d", first, last);
+
+	if (first > last)
 		return -EINVAL;
 
-	/* first we read the mbox descriptor */
-	ret = wl1271_read(wl, wl->mbox_ptr[mbox_num], wl->mbox,
-			  sizeof(struct event_mailbox), false);
+	/* the mailboxes are adjacent, one read takes both */
+	ret = wl1271_read(wl, wl->mbox_ptr[first], &wl->mbox[first],
+			  (last - first + 1) * sizeof(struct event_mailbox),
+			  false);
 	if (ret < 0)
 		return ret;
 
-	/* process the descriptor */
-	ret = wl1271_event_process(wl, wl->mbox);
+	wl->event_acks_pending += last - first + 1;
+	wl->stats.event_mboxes += last - first + 1;
+	if (first != last)
+		wl->stats.event_dual_reads++;
+
+	for (i = first; i <= last; i++) {
+		ret = wl1271_event_process(wl, &wl->mbox[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (wl->event_work_vector)
+		ieee80211_queue_work(wl->hw, &wl->event_work);
+
+	return 0;
+}
+
+void wl1271_event_work(struct work_struct *work)
+{
+	struct wl1271 *wl = container_of(work, struct wl1271, event_work);
+	struct wl12xx_vif *wlvif;
+	u32 vector;
+	u8 role;
+	int ret;
+
+	mutex_lock(&wl->mutex);
+
+	vector = wl->event_work_vector;
+	wl->event_work_vector = 0;
+
+	if (unlikely(wl->state != WL1271_STATE_ON) || !vector)
+		goto out;
+
+	ret = wl1271_ps_elp_wakeup(wl);
 	if (ret < 0)
-		return ret;
+		goto out;
+
+	wl->stats.event_work_runs++;
+	wl->stats.event_work_events += hweight32(vector);
+
+	/* the next scan command takes the mailbox ack along */
+	if ((vector & SCAN_COMPLETE_EVENT_ID) && wl->scan_vif)
+		wl1271_scan_stm(wl, wl->scan_vif);
+
+	if (vector & RSSI_SNR_TRIGGER_0_EVENT_ID) {
+		/* TODO: check actual multi-role support */
+		wl12xx_for_each_wlvif_sta(wl, wlvif) {
+			wl1271_event_rssi_trigger(wl, wlvif,
+						  wl->event_rssi_metric);
+		}
+	}
+
+	if (vector & BA_SESSION_RX_CONSTRAINT_EVENT_ID) {
+		wl12xx_for_each_wlvif(wl, wlvif) {
+			role = wl1271_event_role_bit(wlvif->role_id);
+			if (!(wl->event_ba_roles & role))
+				continue;
+
+			wlvif->ba_allowed = !!(wl->event_ba_allowed & role);
+			if (!wlvif->ba_allowed)
+				wl1271_stop_ba_event(wl, wlvif);
+		}
+		wl->event_ba_roles = 0;
+	}
+
+	ret = wl1271_event_ack_flush(wl);
+	if (ret < 0)
+		wl12xx_queue_recovery_work(wl);
 
-	/* then we let the firmware know it can go on...*/
-	ret = wl1271_write32(wl, ACX_REG_INTERRUPT_TRIG, INTR_TRIG_EVENT_ACK);
+	wl1271_ps_elp_sleep(wl);
 
-	return ret;
+out:
+	mutex_unlock(&wl->mutex);
 }
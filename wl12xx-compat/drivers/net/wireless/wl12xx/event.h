@@ -134,6 +134,8 @@ struct event_mailbox {
 
 int wl1271_event_unmask(struct wl1271 *wl);
 int wl1271_event_mbox_config(struct wl1271 *wl);
-int wl1271_event_handle(struct wl1271 *wl, u8 mbox);
+int wl1271_event_handle(struct wl1271 *wl, u32 intr);
+int wl1271_event_ack_flush(struct wl1271 *wl);
+void wl1271_event_work(struct work_struct *work);
 
 #endif
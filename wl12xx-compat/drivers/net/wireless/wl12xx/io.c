@@ -116,16 +116,19 @@ bool wl1271_set_block_size(struct wl1271 *wl)
 
 void wl1271_disable_interrupts(struct wl1271 *wl)
 {
+	atomic_inc(&wl->irq_disable_depth);
 	disable_irq(wl->irq);
 }
 
 void wlcore_disable_interrupts_nosync(struct wl1271 *wl)
 {
+	atomic_inc(&wl->irq_disable_depth);
 	disable_irq_nosync(wl->irq);
 }
 
 void wl1271_enable_interrupts(struct wl1271 *wl)
 {
+	atomic_dec(&wl->irq_disable_depth);
 	enable_irq(wl->irq);
 }
 
@@ -27,6 +27,7 @@
 
 #include <linux/irqreturn.h>
 #include "reg.h"
+#include "ps.h"
 
 #define HW_ACCESS_MEMORY_MAX_RANGE	0x1FFC0
 
@@ -55,6 +56,22 @@ void wlcore_synchronize_interrupts(struct wl1271 *wl);
 void wl1271_io_reset(struct wl1271 *wl);
 void wl1271_io_init(struct wl1271 *wl);
 
+/* Bus access must wait for an ELP wakeup that is still in progress */
+static inline int __must_check wl1271_io_wait_awake(struct wl1271 *wl)
+{
+	if (unlikely(test_bit(WL1271_FLAG_ELP_WAKING, &wl->flags)))
+		return wl1271_ps_elp_wakeup_finish(wl);
+
+	return 0;
+}
+
+static inline void wl1271_io_count(struct wl1271 *wl, size_t len)
+{
+	wl->stats.bus_ops++;
+	wl12xx_pcpu_inc(wl, bus_ops);
+	wl12xx_pcpu_add(wl, bus_bytes, len);
+}
+
 /* Raw target IO, address is not translated */
 static inline int __must_check wl1271_raw_write(struct wl1271 *wl, int addr,
 						void *buf, size_t len, bool
@@ -65,6 +82,11 @@ static inline int __must_check wl1271_raw_write(struct wl1271 *wl, int addr,
 	if (test_bit(WL1271_FLAG_IO_FAILED, &wl->flags))
 		return -EIO;
 
+	ret = wl1271_io_wait_awake(wl);
+	if (ret < 0)
+		return ret;
+
+	wl1271_io_count(wl, len);
 	ret = wl->if_ops->write(wl->dev, addr, buf, len, fixed);
 	if (ret && wl->state != WL1271_STATE_OFF)
 		set_bit(WL1271_FLAG_IO_FAILED, &wl->flags);
@@ -72,6 +94,32 @@ static inline int __must_check wl1271_raw_write(struct wl1271 *wl, int addr,
 	return ret;
 }
 
+static inline int __must_check wl1271_raw_write_sg(struct wl1271 *wl,
+						   int addr,
+						   struct scatterlist *sgl,
+						   unsigned int nents,
+						   size_t len, bool fixed)
+{
+	int ret;
+
+	if (test_bit(WL1271_FLAG_IO_FAILED, &wl->flags))
+		return -EIO;
+
+	ret = wl1271_io_wait_awake(wl);
+	if (ret < 0)
+		return ret;
+
+	ret = wl->if_ops->write_sg(wl->dev, addr, sgl, nents, len, fixed);
+	if (ret != -EOPNOTSUPP)
+		wl1271_io_count(wl, len);
+
+	/* -EOPNOTSUPP means nothing was sent, the caller will fall back */
+	if (ret && ret != -EOPNOTSUPP && wl->state != WL1271_STATE_OFF)
+		set_bit(WL1271_FLAG_IO_FAILED, &wl->flags);
+
+	return ret;
+}
+
 static inline int __must_check wl1271_raw_read(struct wl1271 *wl, int addr,
 					       void *buf, size_t len, bool
 					       fixed)
@@ -81,6 +129,11 @@ static inline int __must_check wl1271_raw_read(struct wl1271 *wl, int addr,
 	if (test_bit(WL1271_FLAG_IO_FAILED, &wl->flags))
 		return -EIO;
 
+	ret = wl1271_io_wait_awake(wl);
+	if (ret < 0)
+		return ret;
+
+	wl1271_io_count(wl, len);
 	ret = wl->if_ops->read(wl->dev, addr, buf, len, fixed);
 	if (ret && wl->state != WL1271_STATE_OFF)
 		set_bit(WL1271_FLAG_IO_FAILED, &wl->flags);
@@ -157,6 +210,18 @@ static inline int __must_check wl1271_write(struct wl1271 *wl, int addr,
 	return wl1271_raw_write(wl, physical, buf, len, fixed);
 }
 
+static inline int __must_check wl1271_write_sg(struct wl1271 *wl, int addr,
+					       struct scatterlist *sgl,
+					       unsigned int nents,
+					       size_t len, bool fixed)
+{
+	int physical;
+
+	physical = wl1271_translate_addr(wl, addr);
+
+	return wl1271_raw_write_sg(wl, physical, sgl, nents, len, fixed);
+}
+
 static inline int __must_check wl1271_read_hwaddr(struct wl1271 *wl,
 						  int hwaddr, void *buf,
 						  size_t len, bool fixed)
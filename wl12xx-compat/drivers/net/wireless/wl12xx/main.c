@@ -27,9 +27,9 @@
 #include <linux/spi/spi.h>
 #include <linux/crc32.h>
 #include <linux/etherdevice.h>
-#include <linux/vmalloc.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/wl12xx.h>
 #include <linux/sched.h>
 #include <linux/interrupt.h>
@@ -52,6 +52,7 @@
 #include "testmode.h"
 #include "scan.h"
 #include "version.h"
+#include "trace.h"
 
 #define WL1271_BOOT_RETRIES 3
 
@@ -265,6 +266,8 @@ static struct conf_drv_settings default_conf = {
 		.keep_alive_interval         = 10000,
 		.max_listen_interval         = 20,
 		.elp_timeout                 = 200,
+		.elp_adaptive                = 0,
+		.elp_break_even              = 20,
 	},
 	.itrim = {
 		.enable = false,
@@ -370,6 +373,7 @@ static struct conf_drv_settings default_conf = {
 		.read_panic                   = 0,
 	},
 	.hci_io_ds = HCI_IO_DS_6MA,
+	.fw_stats_period = 0,
 	.rate = {
 		.rate_retry_score = 32000,
 		.per_add = 8192,
@@ -408,6 +412,11 @@ static struct conf_drv_settings default_conf = {
 
 static char *fwlog_param;
 static bool bug_on_recovery;
+static bool rx_zerocopy_param;
+static int rx_napi_budget_param = 64;
+static unsigned int rx_napi_coalesce_param = 32;
+static unsigned int tx_aggr_size_param = WL1271_AGGR_BUFFER_SIZE;
+static unsigned int rx_aggr_size_param = WL1271_AGGR_BUFFER_SIZE;
 static char *fref_param;
 static char *tcxo_param;
 
@@ -651,6 +660,65 @@ static void wl1271_rx_streaming_timer(unsigned long data)
 	ieee80211_queue_work(wl->hw, &wlvif->rx_streaming_disable_work);
 }
 
+/* wl->mutex must be taken and the chip awake */
+int wl12xx_update_fw_stats(struct wl1271 *wl)
+{
+	int ret;
+
+	ret = wl1271_acx_statistics(wl, wl->fw_stats_buf);
+	if (ret < 0)
+		return ret;
+
+	/* allocated with the debugfs entries */
+	if (wl->stats.fw_stats) {
+		spin_lock(&wl->fw_stats_lock);
+		memcpy(wl->stats.fw_stats, wl->fw_stats_buf,
+		       sizeof(*wl->fw_stats_buf));
+		spin_unlock(&wl->fw_stats_lock);
+	}
+
+	wl->stats.fw_stats_update = jiffies;
+	return 0;
+}
+
+static void wl12xx_fw_stats_work(struct work_struct *work)
+{
+	struct delayed_work *dwork;
+	struct wl1271 *wl;
+
+	dwork = container_of(work, struct delayed_work, work);
+	wl = container_of(dwork, struct wl1271, fw_stats_work);
+
+	mutex_lock(&wl->mutex);
+
+	if (unlikely(wl->state != WL1271_STATE_ON) ||
+	    !wl->conf.fw_stats_period)
+		goto out;
+
+	/*
+	 * Only sample a chip that is awake anyway. Waking it would keep it
+	 * up for another ELP delay and feed a fake idle gap to the adaptive
+	 * ELP average. The chip can't enter ELP while we hold the mutex.
+	 */
+	if (test_bit(WL1271_FLAG_IN_ELP, &wl->flags))
+		goto out_rearm;
+
+	wl12xx_update_fw_stats(wl);
+
+out_rearm:
+	ieee80211_queue_delayed_work(wl->hw, &wl->fw_stats_work,
+				msecs_to_jiffies(wl->conf.fw_stats_period));
+out:
+	mutex_unlock(&wl->mutex);
+}
+
+/*
+ * A TX stall is handled without a FW reboot at most once per period, the
+ * light recovery polls the FW this often while it waits (msecs).
+ */
+#define WL12XX_RECOVERY_LIGHT_PERIOD	60000
+#define WL12XX_RECOVERY_LIGHT_POLL	20
+
 /* wl->mutex must be taken */
 void wl12xx_rearm_tx_watchdog_locked(struct wl1271 *wl)
 {
@@ -719,6 +787,15 @@ static void wl12xx_tx_watchdog_work(struct work_struct *work)
 
 	wl1271_error("Tx stuck (in FW) for %d ms. Starting recovery",
 		     wl->conf.tx.tx_watchdog_timeout);
+
+	/*
+	 * A stall now and then is mostly a lost interrupt, try to keep the
+	 * FW. Don't downgrade a recovery that is already on its way.
+	 */
+	if (!test_bit(WL1271_FLAG_RECOVERY_IN_PROGRESS, &wl->flags))
+		wl->recovery_light_ok = !wl->recovery_light_last ||
+			time_after(jiffies, wl->recovery_light_last +
+				   msecs_to_jiffies(WL12XX_RECOVERY_LIGHT_PERIOD));
 	wl12xx_queue_recovery_work(wl);
 
 out:
@@ -1005,31 +1082,146 @@ static int wl12xx_fw_status(struct wl1271 *wl,
 	return 0;
 }
 
-static void wl1271_flush_deferred_work(struct wl1271 *wl)
+/*
+ * Pass up to @budget received frames to the network stack in one burst,
+ * from the NAPI poll when @napi is set, from process context otherwise.
+ */
+static int wl12xx_deliver_rx(struct wl1271 *wl, struct napi_struct *napi,
+			     int budget)
 {
+	struct sk_buff_head rx_list;
 	struct sk_buff *skb;
+	unsigned long flags;
+	int count = 0;
+
+	__skb_queue_head_init(&rx_list);
+	spin_lock_irqsave(&wl->deferred_rx_queue.lock, flags);
+	while (count < budget &&
+	       (skb = __skb_dequeue(&wl->deferred_rx_queue))) {
+		__skb_queue_tail(&rx_list, skb);
+		count++;
+	}
+	spin_unlock_irqrestore(&wl->deferred_rx_queue.lock, flags);
+
+	if (!count)
+		return 0;
+
+	/* don't walk the list just to find the tracepoint off */
+	if (trace_wl12xx_rx_deliver_enabled())
+		skb_queue_walk(&rx_list, skb)
+			trace_wl12xx_rx_deliver(wl, skb);
+
+	if (napi)
+		ieee80211_rx_list(wl->hw, &rx_list, napi);
+	else
+		ieee80211_rx_list_ni(wl->hw, &rx_list);
+
+	return count;
+}
 
-	/* Pass all received frames to the network stack */
-	while ((skb = skb_dequeue(&wl->deferred_rx_queue)))
-		ieee80211_rx_ni(wl->hw, skb);
+static void wl12xx_flush_deferred_tx(struct wl1271 *wl)
+{
+	struct sk_buff *skb;
 
 	/* Return sent skbs to the network stack */
 	while ((skb = skb_dequeue(&wl->deferred_tx_queue)))
 		ieee80211_tx_status_ni(wl->hw, skb);
 }
 
+static void wl1271_flush_deferred_work(struct wl1271 *wl)
+{
+	/* mac80211 RX calls must not run concurrently with the poll */
+	if (wl->rx_napi)
+		napi_disable(&wl->napi);
+
+	wl12xx_deliver_rx(wl, NULL, INT_MAX);
+
+	if (wl->rx_napi)
+		napi_enable(&wl->napi);
+
+	wl12xx_flush_deferred_tx(wl);
+}
+
 static void wl1271_netstack_work(struct work_struct *work)
 {
 	struct wl1271 *wl =
 		container_of(work, struct wl1271, netstack_work);
 
+	/* RX is left to the NAPI poll */
+	if (wl->rx_napi) {
+		wl12xx_flush_deferred_tx(wl);
+		return;
+	}
+
 	do {
 		wl1271_flush_deferred_work(wl);
 	} while (skb_queue_len(&wl->deferred_rx_queue));
 }
 
+static int wl12xx_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct wl1271 *wl = container_of(napi, struct wl1271, napi);
+	int count;
+
+	count = wl12xx_deliver_rx(wl, napi, budget);
+
+	/* single poller, racy readers are fine with that */
+	wl->stats.rx_napi_polls++;
+	wl->stats.rx_napi_frames += count;
+	wl->stats.rx_napi_hist[min_t(int, fls(count),
+				     WL12XX_RX_NAPI_HIST_LEN - 1)]++;
+
+	if (count == budget) {
+		wl->stats.rx_napi_exhausted++;
+		return count;
+	}
+
+	/*
+	 * Idle again, the next burst read by the IRQ thread schedules us.
+	 * Frames queued after our dequeue found NAPI still scheduled, so
+	 * pick them up now.
+	 */
+	napi_complete(napi);
+	if (!skb_queue_empty(&wl->deferred_rx_queue))
+		napi_schedule(napi);
+
+	return count;
+}
+
+/*
+ * Schedule the poll for what the IRQ handler queued. Called once wl->mutex
+ * is released, so the next bus reads don't wait for the delivery. Bottom
+ * halves are disabled around it, so local_bh_enable() runs the poll right
+ * away rather than leaving it pending until the next interrupt or
+ * ksoftirqd.
+ */
+static void wl12xx_rx_napi_kick(struct wl1271 *wl)
+{
+	if (!wl->rx_napi || skb_queue_empty(&wl->deferred_rx_queue))
+		return;
+
+	local_bh_disable();
+	napi_schedule(&wl->napi);
+	local_bh_enable();
+}
+
 #define WL1271_IRQ_MAX_LOOPS 256
 
+/* frames moved in one pass that make another FW status read worthwhile */
+#define WL1271_IRQ_LOOP_MIN_PKTS 4
+
+static void wl12xx_irq_update_bus_stats(struct wl1271 *wl, u64 bus_ops,
+					u32 packets)
+{
+	u32 ops = bus_ops;
+
+	wl->stats.irq_runs++;
+	wl->stats.irq_bus_ops += bus_ops;
+	wl->stats.irq_packets += packets;
+	wl->stats.irq_bus_ops_hist[min_t(u32, ops,
+					 WL12XX_IRQ_BUS_OPS_HIST_LEN - 1)]++;
+}
+
 static int wl12xx_irq_locked(struct wl1271 *wl)
 {
 	int ret = 0;
@@ -1038,6 +1230,10 @@ static int wl12xx_irq_locked(struct wl1271 *wl)
 	bool done = false;
 	unsigned int defer_count;
 	unsigned long flags;
+	u64 bus_ops = wl->stats.bus_ops;
+	u32 rx_start = wl->rx_counter, rx_counter = rx_start;
+	u32 tx_start = wl->tx_results_count, tx_results = tx_start;
+	u32 pkts;
 
 	/*
 	 * In case edge triggered interrupt must be used, we cannot iterate
@@ -1051,7 +1247,8 @@ static int wl12xx_irq_locked(struct wl1271 *wl)
 	if (unlikely(wl->state == WL1271_STATE_OFF))
 		goto out;
 
-	ret = wl1271_ps_elp_wakeup(wl);
+	/* the FW status read below waits for the chip if it must */
+	ret = wl1271_ps_elp_wakeup_start(wl);
 	if (ret < 0)
 		goto out;
 
@@ -1070,6 +1267,7 @@ static int wl12xx_irq_locked(struct wl1271 *wl)
 
 		intr = le32_to_cpu(wl->fw_status->intr);
 		intr &= WL1271_INTR_MASK;
+		trace_wl12xx_irq(wl, intr);
 		if (!intr) {
 			done = true;
 			continue;
@@ -1116,23 +1314,53 @@ static int wl12xx_irq_locked(struct wl1271 *wl)
 					goto out;
 			}
 
-			/* Make sure the deferred queues don't get too long */
-			defer_count = skb_queue_len(&wl->deferred_tx_queue) +
-				      skb_queue_len(&wl->deferred_rx_queue);
-			if (defer_count > WL1271_DEFERRED_QUEUE_LIMIT)
-				wl1271_flush_deferred_work(wl);
-		}
+			/*
+			 * On a level triggered line a new interrupt simply
+			 * fires the handler again, so after a light pass don't
+			 * spend a bus transaction on a status read that will
+			 * most likely find nothing. Under load keep looping,
+			 * that is cheaper than another IRQ round trip.
+			 */
+			pkts = (wl->rx_counter - rx_counter) +
+			       (wl->tx_results_count - tx_results);
+			if (pkts < WL1271_IRQ_LOOP_MIN_PKTS)
+				done = true;
+			rx_counter = wl->rx_counter;
+			tx_results = wl->tx_results_count;
 
-		if (intr & WL1271_ACX_INTR_EVENT_A) {
-			wl1271_debug(DEBUG_IRQ, "WL1271_ACX_INTR_EVENT_A");
-			ret = wl1271_event_handle(wl, 0);
-			if (ret < 0)
-				goto out;
+			/*
+			 * With NAPI the RX backlog is delivered once the
+			 * mutex is released, so end the pass early when it
+			 * gets long. The level triggered line fires again for
+			 * whatever the chip still holds.
+			 */
+			defer_count = skb_queue_len(&wl->deferred_rx_queue);
+			if (wl->rx_napi) {
+				if (wl->rx_napi_coalesce &&
+				    defer_count >= wl->rx_napi_coalesce) {
+					wl->stats.rx_napi_coalesce_kicks++;
+					done = true;
+				}
+				/* napi_disable() may sleep on the poll */
+				defer_count = 0;
+			}
+
+			/* Make sure the deferred queues don't get too long */
+			defer_count += skb_queue_len(&wl->deferred_tx_queue);
+			if (defer_count > WL1271_DEFERRED_QUEUE_LIMIT) {
+				if (wl->rx_napi)
+					wl12xx_flush_deferred_tx(wl);
+				else
+					wl1271_flush_deferred_work(wl);
+			}
 		}
 
-		if (intr & WL1271_ACX_INTR_EVENT_B) {
-			wl1271_debug(DEBUG_IRQ, "WL1271_ACX_INTR_EVENT_B");
-			ret = wl1271_event_handle(wl, 1);
+		if (intr & (WL1271_ACX_INTR_EVENT_A |
+			    WL1271_ACX_INTR_EVENT_B)) {
+			wl1271_debug(DEBUG_IRQ, "WL1271_ACX_INTR_EVENT 0x%x",
+				     intr & (WL1271_ACX_INTR_EVENT_A |
+					     WL1271_ACX_INTR_EVENT_B));
+			ret = wl1271_event_handle(wl, intr);
 			if (ret < 0)
 				goto out;
 		}
@@ -1143,11 +1371,30 @@ static int wl12xx_irq_locked(struct wl1271 *wl)
 
 		if (intr & WL1271_ACX_INTR_HW_AVAILABLE)
 			wl1271_debug(DEBUG_IRQ, "WL1271_ACX_INTR_HW_AVAILABLE");
+
+		/* the same holds for event only interrupts */
+		if (!(intr & WL1271_ACX_INTR_DATA))
+			done = true;
+	}
+
+	/* mailboxes not handed over to the event work are acked here */
+	if (!wl->event_work_vector) {
+		ret = wl1271_event_ack_flush(wl);
+		if (ret < 0)
+			goto out;
 	}
 
 	wl1271_ps_elp_sleep(wl);
 
+	wl12xx_irq_update_bus_stats(wl, wl->stats.bus_ops - bus_ops,
+				    wl->rx_counter - rx_start +
+				    wl->tx_results_count - tx_start);
+
 out:
+	/* whatever was read so far goes up even if the loop failed */
+	if (wl->rx_napi && !skb_queue_empty(&wl->deferred_rx_queue))
+		wl->stats.rx_napi_kicks++;
+
 	return ret;
 }
 
@@ -1178,44 +1425,35 @@ static irqreturn_t wl12xx_irq(int irq, void *cookie)
 
 	mutex_unlock(&wl->mutex);
 
+	wl12xx_rx_napi_kick(wl);
+
 	return IRQ_HANDLED;
 }
 
-static int wl12xx_fetch_firmware(struct wl1271 *wl, bool plt)
+static const char *wl12xx_fw_name(struct wl1271 *wl,
+				  enum wl12xx_fw_type fw_type)
 {
-	const struct firmware *fw;
-	const char *fw_name;
-	enum wl12xx_fw_type fw_type;
-	int ret;
-	u8 open_count;
+	bool wl128x = wl->chip.id == CHIP_ID_1283_PG20;
 
-	open_count = ieee80211_get_open_count(wl->hw, NULL);
-	if (plt) {
-		fw_type = WL12XX_FW_TYPE_PLT;
-		if (wl->chip.id == CHIP_ID_1283_PG20)
-			fw_name = WL128X_PLT_FW_NAME;
-		else
-			fw_name	= WL127X_PLT_FW_NAME;
-	} else {
-		if (open_count > 1) {
-			fw_type = WL12XX_FW_TYPE_MULTI;
-			if (wl->chip.id == CHIP_ID_1283_PG20)
-				fw_name = WL128X_FW_NAME_MULTI;
-			else
-				fw_name = WL127X_FW_NAME_MULTI;
-		} else {
-			fw_type = WL12XX_FW_TYPE_NORMAL;
-			if (wl->chip.id == CHIP_ID_1283_PG20)
-				fw_name = WL128X_FW_NAME_SINGLE;
-			else
-				fw_name = WL127X_FW_NAME_SINGLE;
-		}
+	switch (fw_type) {
+	case WL12XX_FW_TYPE_PLT:
+		return wl128x ? WL128X_PLT_FW_NAME : WL127X_PLT_FW_NAME;
+	case WL12XX_FW_TYPE_MULTI:
+		return wl128x ? WL128X_FW_NAME_MULTI : WL127X_FW_NAME_MULTI;
+	default:
+		return wl128x ? WL128X_FW_NAME_SINGLE : WL127X_FW_NAME_SINGLE;
 	}
+}
 
-	if (wl->saved_fw_type == fw_type)
-		return 0;
+static int wl12xx_load_fw_image(struct wl1271 *wl,
+				enum wl12xx_fw_type fw_type,
+				struct wl12xx_fw_image *img)
+{
+	const struct firmware *fw;
+	const char *fw_name = wl12xx_fw_name(wl, fw_type);
+	int ret;
 
-	wl1271_debug(DEBUG_BOOT, "booting firmware %s", fw_name);
+	wl1271_debug(DEBUG_BOOT, "loading firmware %s", fw_name);
 
 	ret = request_firmware(&fw, fw_name, wl->dev);
 
@@ -1231,24 +1469,122 @@ static int wl12xx_fetch_firmware(struct wl1271 *wl, bool plt)
 		goto out;
 	}
 
-	vfree(wl->fw);
-	wl->saved_fw_type = WL12XX_FW_TYPE_NONE;
-	wl->fw_len = fw->size;
-	wl->fw = vmalloc(wl->fw_len);
+	ret = wl12xx_boot_prepare_fw(img, fw->data, fw->size);
+out:
+	release_firmware(fw);
 
-	if (!wl->fw) {
-		wl1271_error("could not allocate memory for the firmware");
-		ret = -ENOMEM;
+	return ret;
+}
+
+static void wl12xx_fw_preload_complete(const struct firmware *fw,
+				       void *context)
+{
+	struct wl1271 *wl = context;
+	struct wl12xx_fw_image img = { NULL };
+	enum wl12xx_fw_type fw_type = wl->fw_preload_type;
+
+	/* a build without the alternate image is not an error */
+	if (!fw) {
+		wl1271_debug(DEBUG_BOOT, "no firmware %s to preload",
+			     wl12xx_fw_name(wl, fw_type));
 		goto out;
 	}
 
-	memcpy(wl->fw, fw->data, wl->fw_len);
-	ret = 0;
-	wl->saved_fw_type = fw_type;
-out:
+	if (fw->size % 4 ||
+	    wl12xx_boot_prepare_fw(&img, fw->data, fw->size) < 0)
+		wl1271_warning("could not preload firmware %s",
+			       wl12xx_fw_name(wl, fw_type));
 	release_firmware(fw);
 
-	return ret;
+	mutex_lock(&wl->mutex);
+	/* keep it only if nobody loaded it or switched to PLT meanwhile */
+	if (img.chunks && !wl->fw_cache[fw_type].chunks &&
+	    wl->saved_fw_type != WL12XX_FW_TYPE_PLT) {
+		wl->fw_cache[fw_type] = img;
+		memset(&img, 0, sizeof(img));
+		wl->stats.fw_preloads++;
+	}
+	mutex_unlock(&wl->mutex);
+
+	wl12xx_boot_free_fw(&img);
+out:
+	complete(&wl->fw_preload_compl);
+}
+
+/* wl->mutex must be taken */
+static void wl12xx_fw_preload(struct wl1271 *wl, enum wl12xx_fw_type fw_type)
+{
+	int ret;
+
+	if (wl->fw_cache[fw_type].chunks)
+		return;
+
+	/* a single request at a time, it is retried on the next boot */
+	if (!try_wait_for_completion(&wl->fw_preload_compl))
+		return;
+
+	wl->fw_preload_type = fw_type;
+	ret = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
+				      wl12xx_fw_name(wl, fw_type), wl->dev,
+				      GFP_KERNEL, wl,
+				      wl12xx_fw_preload_complete);
+	if (ret < 0) {
+		wl1271_debug(DEBUG_BOOT, "firmware preload failed: %d", ret);
+		complete(&wl->fw_preload_compl);
+	}
+}
+
+static int wl12xx_fetch_firmware(struct wl1271 *wl, bool plt)
+{
+	struct wl12xx_fw_image *img;
+	enum wl12xx_fw_type fw_type, alt_type;
+	int i, ret;
+	u8 open_count;
+
+	open_count = ieee80211_get_open_count(wl->hw, NULL);
+	if (plt)
+		fw_type = WL12XX_FW_TYPE_PLT;
+	else if (open_count > 1)
+		fw_type = WL12XX_FW_TYPE_MULTI;
+	else
+		fw_type = WL12XX_FW_TYPE_NORMAL;
+
+	img = &wl->fw_cache[fw_type];
+	if (img->chunks) {
+		wl->stats.fw_cache_hits++;
+	} else {
+		wl->stats.fw_cache_misses++;
+		ret = wl12xx_load_fw_image(wl, fw_type, img);
+		if (ret < 0)
+			return ret;
+	}
+
+	wl1271_debug(DEBUG_BOOT, "booting firmware %s",
+		     wl12xx_fw_name(wl, fw_type));
+
+	wl->fw = img;
+	wl->saved_fw_type = fw_type;
+
+	/*
+	 * Adding or removing a role switches between the single and multi
+	 * role images. Have the other one ready, so that the switch does not
+	 * wait on the filesystem. Anything else in the cache is dropped, PLT
+	 * is only kept while it is in use.
+	 */
+	if (fw_type == WL12XX_FW_TYPE_PLT)
+		alt_type = WL12XX_FW_TYPE_NONE;
+	else
+		alt_type = (fw_type == WL12XX_FW_TYPE_NORMAL) ?
+			WL12XX_FW_TYPE_MULTI : WL12XX_FW_TYPE_NORMAL;
+
+	for (i = 0; i < WL12XX_FW_TYPE_MAX; i++)
+		if (i != fw_type && i != alt_type)
+			wl12xx_boot_free_fw(&wl->fw_cache[i]);
+
+	if (alt_type != WL12XX_FW_TYPE_NONE)
+		wl12xx_fw_preload(wl, alt_type);
+
+	return 0;
 }
 
 static int wl1271_fetch_nvs(struct wl1271 *wl)
@@ -1323,8 +1659,10 @@ void wl12xx_queue_recovery_work(struct wl1271 *wl)
 {
 	WARN_ON(!test_bit(WL1271_FLAG_INTENDED_FW_RECOVERY, &wl->flags));
 
-	/* Avoid a recursive recovery */
-	if (!test_and_set_bit(WL1271_FLAG_RECOVERY_IN_PROGRESS, &wl->flags)) {
+	/* Avoid a recursive recovery, a second failure needs a full one */
+	if (test_and_set_bit(WL1271_FLAG_RECOVERY_IN_PROGRESS, &wl->flags)) {
+		wl->recovery_light_ok = false;
+	} else {
 		wlcore_disable_interrupts_nosync(wl);
 #ifdef CONFIG_HAS_WAKELOCK
 		/* give us a grace period for recovery */
@@ -1335,8 +1673,17 @@ void wl12xx_queue_recovery_work(struct wl1271 *wl)
 	}
 }
 
+static inline u8 *wl12xx_fwlog_data(struct wl1271 *wl)
+{
+	return (u8 *)wl->fwlog + PAGE_SIZE;
+}
+
+/* wl->mutex must be taken */
 size_t wl12xx_copy_fwlog(struct wl1271 *wl, u8 *memblock, size_t maxlen)
 {
+	struct wl12xx_fwlog_ring *ring = wl->fwlog;
+	struct wl12xx_fwlog_rec *rec;
+	u32 head, off, pad, need;
 	size_t len = 0;
 
 	/* The FW log is a length-value list, find where the log end */
@@ -1348,16 +1695,65 @@ size_t wl12xx_copy_fwlog(struct wl1271 *wl, u8 *memblock, size_t maxlen)
 		len += memblock[len] + 1;
 	}
 
-	/* Make sure we have enough room */
-	len = min(len, (size_t)(PAGE_SIZE - wl->fwlog_size));
+	if (!len)
+		return 0;
 
-	/* Fill the FW log file, consumed by the sysfs fwlog entry */
-	memcpy(wl->fwlog + wl->fwlog_size, memblock, len);
-	wl->fwlog_size += len;
+	need = ALIGN(sizeof(*rec) + len, 8);
+	if (WARN_ON_ONCE(need > WL12XX_FWLOG_DATA_SIZE))
+		return len;
+
+	head = ring->head;
+	off = head & (WL12XX_FWLOG_DATA_SIZE - 1);
+	pad = off + need > WL12XX_FWLOG_DATA_SIZE ?
+		WL12XX_FWLOG_DATA_SIZE - off : 0;
+
+	/* the reader's tail, it may move under us but only forward */
+	if (head + pad + need - ACCESS_ONCE(ring->tail) >
+	    WL12XX_FWLOG_DATA_SIZE) {
+		ring->overruns++;
+		ring->lost_bytes += len;
+		/* leave a gap in the record numbers */
+		ring->seq++;
+		return len;
+	}
+
+	/* don't reuse space before the reader is done with it */
+	smp_mb();
+
+	if (pad) {
+		if (pad >= sizeof(*rec)) {
+			rec = (struct wl12xx_fwlog_rec *)
+				(wl12xx_fwlog_data(wl) + off);
+			rec->len = 0;
+		}
+		head += pad;
+		off = 0;
+	}
+
+	/* the only copy, readers map the ring or get it from sysfs */
+	rec = (struct wl12xx_fwlog_rec *)(wl12xx_fwlog_data(wl) + off);
+	rec->seq = ring->seq++;
+	rec->len = len;
+	rec->timestamp_ns = ktime_to_ns(ktime_get());
+	memcpy(rec->data, memblock, len);
+
+	/* publish the record once it is complete */
+	smp_wmb();
+	ring->head = head + need;
 
 	return len;
 }
 
+/*
+ * Wake up blocked readers of the fwlog file, and pollers of fwlog_head that
+ * consume the ring through mmap. The ring head has to be published already.
+ */
+void wl12xx_fwlog_notify(struct wl1271 *wl)
+{
+	wake_up_interruptible(&wl->fwlog_waitq);
+	sysfs_notify(&wl->dev->kobj, NULL, "fwlog_head");
+}
+
 static void wl12xx_read_fwlog_panic(struct wl1271 *wl)
 {
 	u32 addr;
@@ -1415,7 +1811,7 @@ static void wl12xx_read_fwlog_panic(struct wl1271 *wl)
 			break;
 	} while (addr && (addr != first_addr));
 
-	wake_up_interruptible(&wl->fwlog_waitq);
+	wl12xx_fwlog_notify(wl);
 
 out:
 	kfree(block);
@@ -1446,27 +1842,78 @@ static unsigned long timevaldiff(struct timeval *starttime, struct timeval *fini
 	return msec;
 }
 
-static void log_firmware_recovery_time(struct wl1271 *wl)
+static void log_firmware_recovery_time(struct wl1271 *wl,
+				       enum wl12xx_recovery_tier tier)
 {
+	static const char * const tier_keys[WL12XX_RECOVERY_TIER_MAX] = {
+		[WL12XX_RECOVERY_LIGHT]	= "fw_recover_time_light",
+		[WL12XX_RECOVERY_FULL]	= "fw_recover_time",
+	};
 	struct timeval stop_recovery_time;
 	unsigned long msec_to_recover = 0;
 	char msec_c[32];
 
 	do_gettimeofday(&stop_recovery_time);
 	msec_to_recover = timevaldiff(&wl->start_recovery_time, &stop_recovery_time);
+	wl->stats.recoveries[tier]++;
+	wl->stats.recovery_ms[tier] = msec_to_recover;
+	if (wl->stats.recovery_ms[tier] > wl->stats.recovery_max_ms[tier])
+		wl->stats.recovery_max_ms[tier] = wl->stats.recovery_ms[tier];
 	snprintf(msec_c, sizeof(msec_c), "%lu", msec_to_recover);
 
 #ifndef K39_BRINGUP_HACKS
-	kct_log(CT_EV_STAT, "cws.wifi", "fw_recover_time", EV_FLAGS_PRIORITY_LOW, msec_c);
+	kct_log(CT_EV_STAT, "cws.wifi", tier_keys[tier], EV_FLAGS_PRIORITY_LOW, msec_c);
 #endif
 }
 
+/*
+ * Light recovery tier for a stuck TX: run the interrupt handler by hand in
+ * case an interrupt was lost, and give the FW a little longer to release
+ * TX blocks. Called with the IRQ enabled. The FW, its roles and keys and
+ * the association stay as they are. Fails when the FW reports a problem or
+ * doesn't move at all.
+ */
+static int wl12xx_recovery_light(struct wl1271 *wl)
+{
+	u32 blocks_freed = wl->tx_blocks_freed;
+	unsigned long timeout;
+	int ret;
+
+	timeout = jiffies + msecs_to_jiffies(WL12XX_RECOVERY_LIGHT_TIMEOUT);
+
+	while (1) {
+		/* a watchdog interrupt or a bus error fails here */
+		ret = wl12xx_irq_locked(wl);
+		if (ret < 0)
+			return ret;
+
+		if (wl->tx_blocks_freed != blocks_freed ||
+		    !wl->tx_allocated_blocks)
+			return 0;
+
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+
+		msleep(WL12XX_RECOVERY_LIGHT_POLL);
+	}
+}
+
+void wl12xx_ttff_done(struct wl1271 *wl)
+{
+	wl->ttff_pending = false;
+	wl->stats.ttff_ms = jiffies_to_msecs(jiffies - wl->ttff_start);
+	if (wl->stats.ttff_ms > wl->stats.ttff_max_ms)
+		wl->stats.ttff_max_ms = wl->stats.ttff_ms;
+}
+
 static void wl1271_recovery_work(struct work_struct *work)
 {
 	struct wl1271 *wl =
 		container_of(work, struct wl1271, recovery_work);
 	struct wl12xx_vif *wlvif;
 	struct ieee80211_vif *vif;
+	enum wl12xx_recovery_tier tier = WL12XX_RECOVERY_FULL;
+	int ret;
 
 	mutex_lock(&wl->mutex);
 
@@ -1475,6 +1922,29 @@ static void wl1271_recovery_work(struct work_struct *work)
 	if (wl->state != WL1271_STATE_ON)
 		goto out_unlock;
 
+	if (wl->recovery_light_ok) {
+		wl->recovery_light_ok = false;
+
+		/*
+		 * wl12xx_queue_recovery_work() disabled the IRQ, but waking
+		 * the chip from ELP and command completion wait for it. Only
+		 * nosync below, the IRQ thread may be blocked on wl->mutex.
+		 */
+		wl1271_enable_interrupts(wl);
+		ret = wl12xx_recovery_light(wl);
+		wlcore_disable_interrupts_nosync(wl);
+		if (!ret) {
+			wl1271_info("Tx moving again, FW kept");
+			wl->recovery_light_last = jiffies;
+			tier = WL12XX_RECOVERY_LIGHT;
+			goto out_unlock;
+		}
+
+		wl1271_warning("light recovery failed (%d), rebooting the FW",
+			       ret);
+		wl->stats.recovery_escalations++;
+	}
+
 	if (!test_bit(WL1271_FLAG_INTENDED_FW_RECOVERY, &wl->flags)) {
 		wl12xx_read_fwlog_panic(wl);
 		wl12xx_print_recovery(wl);
@@ -1508,6 +1978,7 @@ static void wl1271_recovery_work(struct work_struct *work)
 	wl1271_op_stop_locked(wl);
 
 	ieee80211_restart_hw(wl->hw);
+	wl->recovery_boot_pending = true;
 
 	/*
 	 * Its safe to enable TX now - the queues are stopped after a request
@@ -1515,12 +1986,16 @@ static void wl1271_recovery_work(struct work_struct *work)
 	 */
 	ieee80211_wake_queues(wl->hw);
 out_unlock:
-	log_firmware_recovery_time(wl);
+	log_firmware_recovery_time(wl, tier);
+	wl->recovery_light_ok = false;
 	wl->watchdog_recovery = false;
 	if (test_and_clear_bit(WL1271_FLAG_RECOVERY_IN_PROGRESS,
 			       &wl->flags))
 		wl1271_enable_interrupts(wl);
 	mutex_unlock(&wl->mutex);
+
+	/* frames the light tier read */
+	wl12xx_rx_napi_kick(wl);
 }
 
 static int wl1271_fw_wakeup(struct wl1271 *wl)
@@ -1630,6 +2105,17 @@ static int wl12xx_chip_wakeup(struct wl1271 *wl, bool plt)
 		goto out;
 	}
 
+	/*
+	 * Zero-copy TX sends a whole burst in one transfer. On block based
+	 * buses this is only possible when every frame is padded to the block
+	 * size, otherwise the burst is copied into the aggregation buffer.
+	 */
+	wl->tx_sg_enabled = wl->if_ops->write_sg &&
+		(!wl->if_ops->set_block_size ||
+		 !(wl->quirks & WL12XX_QUIRK_NO_BLOCKSIZE_ALIGNMENT));
+	wl1271_debug(DEBUG_BOOT, "zero-copy TX %s",
+		     wl->tx_sg_enabled ? "enabled" : "disabled");
+
 	ret = wl12xx_fetch_firmware(wl, plt);
 	if (ret < 0)
 		goto out;
@@ -1744,6 +2230,7 @@ int wl1271_plt_stop(struct wl1271 *wl)
 	mutex_unlock(&wl->mutex);
 
 	wl1271_flush_deferred_work(wl);
+	cancel_work_sync(&wl->event_work);
 	cancel_work_sync(&wl->netstack_work);
 	cancel_work_sync(&wl->recovery_work);
 	cancel_delayed_work_sync(&wl->elp_work);
@@ -1766,8 +2253,9 @@ static void wl1271_op_tx(struct ieee80211_hw *hw, struct sk_buff *skb)
 	struct ieee80211_tx_info *info = IEEE80211_SKB_CB(skb);
 	struct ieee80211_vif *vif = info->control.vif;
 	struct wl12xx_vif *wlvif = NULL;
+	struct sk_buff_head *queue;
 	unsigned long flags;
-	int q, mapping;
+	int q, mapping, count;
 	u8 hlid;
 
 	if (vif)
@@ -1777,30 +2265,49 @@ static void wl1271_op_tx(struct ieee80211_hw *hw, struct sk_buff *skb)
 	q = wl1271_tx_get_queue(mapping);
 
 	hlid = wl12xx_tx_get_hlid(wl, wlvif, skb);
+	if (hlid == WL12XX_INVALID_LINK_ID)
+		goto drop;
 
-	spin_lock_irqsave(&wl->wl_lock, flags);
-
-	/* queue the packet */
-	if (hlid == WL12XX_INVALID_LINK_ID ||
-	    (wlvif && !test_bit(hlid, wlvif->links_map))) {
-		wl1271_debug(DEBUG_TX, "DROP skb hlid %d q %d", hlid, q);
-		ieee80211_free_txskb(hw, skb);
-		goto out;
+	/*
+	 * No global lock here, producers on different links/ACs don't
+	 * serialize. The link is checked under the queue lock, so once
+	 * wl12xx_free_link() has cleared it and purged the queues no packet
+	 * can be added behind its back. The count is raised before the packet
+	 * becomes visible, so the dequeue side never sees it go negative.
+	 */
+	queue = &wl->links[hlid].tx_queue[q];
+	spin_lock_irqsave(&queue->lock, flags);
+	if (wlvif && !test_bit(hlid, wlvif->links_map)) {
+		spin_unlock_irqrestore(&queue->lock, flags);
+		goto drop;
 	}
 
 	wl1271_debug(DEBUG_TX, "queue skb hlid %d q %d", hlid, q);
-	skb_queue_tail(&wl->links[hlid].tx_queue[q], skb);
-
-	wl->tx_queue_count[q]++;
+	count = atomic_inc_return(&wl->tx_queue_count[q]);
+	trace_wl12xx_tx_enqueue(wl, skb, hlid, q, count);
+	__skb_queue_tail(queue, skb);
+	set_bit(hlid, wl->tx_backlog[q]);
+	spin_unlock_irqrestore(&queue->lock, flags);
 
 	/*
 	 * The workqueue is slow to process the tx_queue and we need stop
 	 * the queue here, otherwise the queue will get too long.
 	 */
-	if (wl->tx_queue_count[q] >= WL1271_TX_QUEUE_HIGH_WATERMARK) {
+	if (count >= WL1271_TX_QUEUE_HIGH_WATERMARK &&
+	    !test_and_set_bit(q, &wl->stopped_queues_map)) {
 		wl1271_debug(DEBUG_TX, "op_tx: stopping queues for q %d", q);
 		ieee80211_stop_queue(wl->hw, mapping);
-		set_bit(q, &wl->stopped_queues_map);
+
+		/*
+		 * The TX work may have drained the queue below the low
+		 * watermark before the bit was set, and then it won't wake
+		 * the queue. Re-check after stopping, test_and_set_bit() is
+		 * fully ordered.
+		 */
+		if (atomic_read(&wl->tx_queue_count[q]) <=
+		    WL1271_TX_QUEUE_LOW_WATERMARK &&
+		    test_and_clear_bit(q, &wl->stopped_queues_map))
+			ieee80211_wake_queue(wl->hw, mapping);
 	}
 
 	/*
@@ -1811,14 +2318,16 @@ static void wl1271_op_tx(struct ieee80211_hw *hw, struct sk_buff *skb)
 	if (!test_bit(WL1271_FLAG_FW_TX_BUSY, &wl->flags) &&
 	    !test_bit(WL1271_FLAG_TX_PENDING, &wl->flags))
 		ieee80211_queue_work(wl->hw, &wl->tx_work);
+	return;
 
-out:
-	spin_unlock_irqrestore(&wl->wl_lock, flags);
+drop:
+	wl1271_debug(DEBUG_TX, "DROP skb hlid %d q %d", hlid, q);
+	wl12xx_pcpu_inc(wl, drops[WL12XX_DROP_TX_NO_LINK]);
+	ieee80211_free_txskb(hw, skb);
 }
 
 int wl1271_tx_dummy_packet(struct wl1271 *wl)
 {
-	unsigned long flags;
 	int q;
 	int ret = 0;
 
@@ -1828,10 +2337,8 @@ int wl1271_tx_dummy_packet(struct wl1271 *wl)
 
 	q = wl1271_tx_get_queue(skb_get_queue_mapping(wl->dummy_packet));
 
-	spin_lock_irqsave(&wl->wl_lock, flags);
 	set_bit(WL1271_FLAG_DUMMY_PACKET_PENDING, &wl->flags);
-	wl->tx_queue_count[q]++;
-	spin_unlock_irqrestore(&wl->wl_lock, flags);
+	atomic_inc(&wl->tx_queue_count[q]);
 
 	/* The FW is low on RX memory blocks, so send the dummy packet asap */
 	if (!test_bit(WL1271_FLAG_FW_TX_BUSY, &wl->flags))
@@ -2384,6 +2891,8 @@ out:
 	wl->wow_enabled = false;
 	mutex_unlock(&wl->mutex);
 
+	wl12xx_rx_napi_kick(wl);
+
 	return ret;
 }
 #endif /* CONFIG_PM */
@@ -2462,10 +2971,12 @@ static void wl1271_op_stop_locked(struct wl1271 *wl)
 	wlcore_synchronize_interrupts(wl);
 	wl1271_flush_deferred_work(wl);
 	cancel_delayed_work_sync(&wl->scan_complete_work);
+	cancel_work_sync(&wl->event_work);
 	cancel_work_sync(&wl->netstack_work);
 	cancel_work_sync(&wl->tx_work);
 	cancel_delayed_work_sync(&wl->elp_work);
 	cancel_delayed_work_sync(&wl->tx_watchdog_work);
+	cancel_delayed_work_sync(&wl->fw_stats_work);
 
 	/* let's notify MAC80211 about the remaining pending TX frames */
 	wl12xx_tx_reset(wl, true);
@@ -2481,6 +2992,7 @@ static void wl1271_op_stop_locked(struct wl1271 *wl)
 		wl1271_enable_interrupts(wl);
 
 	wl->fw_type = WL12XX_FW_TYPE_NONE;
+	wl->ttff_pending = false;
 
 	wl->band = IEEE80211_BAND_2GHZ;
 
@@ -2489,6 +3001,7 @@ static void wl1271_op_stop_locked(struct wl1271 *wl)
 	wl->tx_blocks_available = 0;
 	wl->tx_allocated_blocks = 0;
 	wl->tx_results_count = 0;
+	wl->tx_results_acked = 0;
 	wl->tx_packets_count = 0;
 	wl->time_offset = 0;
 	wl->ap_fw_ps_map = 0;
@@ -2671,6 +3184,7 @@ static bool wl12xx_init_fw(struct wl1271 *wl)
 	int retries = WL1271_BOOT_RETRIES;
 	bool booted = false;
 	struct wiphy *wiphy = wl->hw->wiphy;
+	ktime_t start;
 	int ret;
 
 	while (retries) {
@@ -2683,10 +3197,12 @@ static bool wl12xx_init_fw(struct wl1271 *wl)
 		if (ret < 0)
 			goto power_off;
 
+		start = ktime_get();
 		ret = wl1271_hw_init(wl);
 		if (ret < 0)
 			goto irq_disable;
 
+		wl12xx_boot_phase_end(wl, WL12XX_BOOT_PHASE_HW_INIT, start);
 		booted = true;
 		break;
 
@@ -2715,6 +3231,17 @@ power_off:
 
 	wl1271_info("firmware booted (%s)", wl->chip.fw_ver_str);
 
+	if (wl->recovery_boot_pending) {
+		struct timeval now;
+
+		do_gettimeofday(&now);
+		wl->stats.recovery_boot_ms =
+			timevaldiff(&wl->start_recovery_time, &now);
+		if (wl->stats.recovery_boot_ms > wl->stats.recovery_boot_max_ms)
+			wl->stats.recovery_boot_max_ms =
+				wl->stats.recovery_boot_ms;
+	}
+
 #ifndef K39_BRINGUP_HACKS
 	kct_log(CT_EV_INFO, "cws.wifi", "fw_version", EV_FLAGS_PRIORITY_LOW, wl->chip.fw_ver_str);
 #endif
@@ -2735,7 +3262,15 @@ power_off:
 
 	wl->state = WL1271_STATE_ON;
 	wl->watchdog_recovery = false;
+
+	/* the new FW knows none of our probe request templates */
+	wl->scan.probe_templ_valid = 0;
+
+	if (wl->conf.fw_stats_period)
+		ieee80211_queue_delayed_work(wl->hw, &wl->fw_stats_work,
+				msecs_to_jiffies(wl->conf.fw_stats_period));
 out:
+	wl->recovery_boot_pending = false;
 	return booted;
 }
 
@@ -2794,6 +3329,7 @@ static int wl1271_op_add_interface(struct ieee80211_hw *hw,
 	u8 role_type;
 	int open_count;
 	bool booted = false;
+	bool ttff;
 
 	wl1271_debug(DEBUG_MAC80211, "mac80211 add interface type %d mac %pM",
 		     ieee80211_vif_type_p2p(vif), vif->addr);
@@ -2846,11 +3382,17 @@ static int wl1271_op_add_interface(struct ieee80211_hw *hw,
 		 */
 		memcpy(wl->addresses[0].addr, vif->addr, ETH_ALEN);
 
+		/* a restart after recovery is not an interface up */
+		ttff = !wl->recovery_boot_pending;
+		wl->ttff_start = jiffies;
+
 		booted = wl12xx_init_fw(wl);
 		if (!booted) {
 			ret = -EINVAL;
 			goto out;
 		}
+
+		wl->ttff_pending = ttff;
 	}
 
 	if (wlvif->bss_type == BSS_TYPE_STA_BSS ||
@@ -2935,7 +3477,6 @@ static void __wl1271_op_remove_interface(struct wl1271 *wl,
 		wl12xx_rearm_tx_watchdog_locked(wl);
 
 		wl->scan.state = WL1271_SCAN_STATE_IDLE;
-		memset(wl->scan.scanned_ch, 0, sizeof(wl->scan.scanned_ch));
 		wl->scan_vif = NULL;
 		wl->scan.req = NULL;
 		ieee80211_scan_completed(wl->hw, true);
@@ -3932,7 +4473,6 @@ static int wl1271_op_hw_scan(struct ieee80211_hw *hw,
 		join_while_associated = false;
 		wl1271_scan_stop(wl);
 		wl->scan.state = WL1271_SCAN_STATE_IDLE;
-		memset(wl->scan.scanned_ch, 0, sizeof(wl->scan.scanned_ch));
 		wl->scan.req = NULL;
 		ieee80211_scan_completed(wl->hw, true);
 
@@ -3965,7 +4505,6 @@ static void wl1271_op_cancel_hw_scan(struct ieee80211_hw *hw,
 		*/
 		wl1271_warning("Scan issued while recovery, aborting it");
 		wl->scan.state = WL1271_SCAN_STATE_IDLE;
-		memset(wl->scan.scanned_ch, 0, sizeof(wl->scan.scanned_ch));
 		wl->scan.req = NULL;
 		ieee80211_scan_completed(wl->hw, true);
 		goto out;
@@ -3991,7 +4530,6 @@ static void wl1271_op_cancel_hw_scan(struct ieee80211_hw *hw,
 	wl12xx_rearm_tx_watchdog_locked(wl);
 
 	wl->scan.state = WL1271_SCAN_STATE_IDLE;
-	memset(wl->scan.scanned_ch, 0, sizeof(wl->scan.scanned_ch));
 	wl->scan_vif = NULL;
 	wl->scan.req = NULL;
 	ieee80211_scan_completed(wl->hw, true);
@@ -5855,13 +6393,29 @@ static ssize_t wl1271_sysfs_show_hw_pg_ver(struct device *dev,
 static DEVICE_ATTR(hw_pg_ver, S_IRUGO,
 		   wl1271_sysfs_show_hw_pg_ver, NULL);
 
+static ssize_t wl1271_sysfs_show_fwlog_head(struct device *dev,
+					    struct device_attribute *attr,
+					    char *buf)
+{
+	struct wl1271 *wl = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", ACCESS_ONCE(wl->fwlog->head));
+}
+
+/* poll() it for POLLPRI to learn about new records in the mapped ring */
+static DEVICE_ATTR(fwlog_head, S_IRUSR,
+		   wl1271_sysfs_show_fwlog_head, NULL);
+
 static ssize_t wl1271_sysfs_read_fwlog(struct file *filp, struct kobject *kobj,
 				       struct bin_attribute *bin_attr,
 				       char *buffer, loff_t pos, size_t count)
 {
 	struct device *dev = container_of(kobj, struct device, kobj);
 	struct wl1271 *wl = dev_get_drvdata(dev);
-	ssize_t len;
+	struct wl12xx_fwlog_ring *ring;
+	struct wl12xx_fwlog_rec *rec;
+	u32 head, tail, off, rec_len, skip;
+	size_t len, copy;
 	int ret;
 
 	ret = mutex_lock_interruptible(&wl->mutex);
@@ -5869,14 +6423,14 @@ static ssize_t wl1271_sysfs_read_fwlog(struct file *filp, struct kobject *kobj,
 		return -ERESTARTSYS;
 
 	/* Let only one thread read the log at a time, blocking others */
-	while (wl->fwlog_size == 0) {
+	while (!wl->fwlog_closed && wl->fwlog->head == wl->fwlog->tail) {
 		DEFINE_WAIT(wait);
 
 		prepare_to_wait_exclusive(&wl->fwlog_waitq,
 					  &wait,
 					  TASK_INTERRUPTIBLE);
 
-		if (wl->fwlog_size != 0) {
+		if (wl->fwlog_closed || wl->fwlog->head != wl->fwlog->tail) {
 			finish_wait(&wl->fwlog_waitq, &wait);
 			break;
 		}
@@ -5895,27 +6449,90 @@ static ssize_t wl1271_sysfs_read_fwlog(struct file *filp, struct kobject *kobj,
 	}
 
 	/* Check if the fwlog is still valid */
-	if (wl->fwlog_size < 0) {
+	if (wl->fwlog_closed) {
 		mutex_unlock(&wl->mutex);
 		return 0;
 	}
 
-	/* Seeking is not supported - old logs are not kept. Disregard pos. */
-	len = min(count, (size_t)wl->fwlog_size);
-	wl->fwlog_size -= len;
-	memcpy(buffer, wl->fwlog, len);
+	/*
+	 * Seeking is not supported - consumed records are gone. Disregard
+	 * pos. Returns the log payload of the records, as it came from the
+	 * FW. A record that doesn't fit stays in the ring and the next read
+	 * continues where this one stopped.
+	 */
+	ring = wl->fwlog;
+	head = ring->head;
+	tail = ring->tail;
+	smp_rmb();
+
+	/* the header is mapped writable, don't trust a mangled tail */
+	if (head - tail > WL12XX_FWLOG_DATA_SIZE)
+		tail = head;
+
+	len = 0;
+	while ((s32)(head - tail) > 0 && len < count) {
+		off = tail & (WL12XX_FWLOG_DATA_SIZE - 1);
+		rec = (struct wl12xx_fwlog_rec *)(wl12xx_fwlog_data(wl) + off);
+		if (WL12XX_FWLOG_DATA_SIZE - off < sizeof(*rec) || !rec->len) {
+			tail += WL12XX_FWLOG_DATA_SIZE - off;
+			continue;
+		}
+
+		rec_len = min_t(u32, rec->len,
+				WL12XX_FWLOG_DATA_SIZE - off - sizeof(*rec));
+
+		/* the part of a record an earlier read had no room for */
+		skip = 0;
+		if (tail == wl->fwlog_rec_tail && wl->fwlog_rec_off < rec_len)
+			skip = wl->fwlog_rec_off;
+		wl->fwlog_rec_off = 0;
+
+		if (len + rec_len - skip > count && len)
+			break;
+
+		copy = min_t(size_t, rec_len - skip, count - len);
+		memcpy(buffer + len, rec->data + skip, copy);
+		len += copy;
+
+		if (skip + copy < rec_len) {
+			wl->fwlog_rec_tail = tail;
+			wl->fwlog_rec_off = skip + copy;
+			break;
+		}
+
+		tail += ALIGN(sizeof(*rec) + rec_len, 8);
+	}
+
+	if ((s32)(tail - head) > 0)
+		tail = head;
 
-	/* Make room for new messages */
-	memmove(wl->fwlog, wl->fwlog + len, wl->fwlog_size);
+	/* hand the space back only after the records were copied */
+	smp_mb();
+	ring->tail = tail;
 
 	mutex_unlock(&wl->mutex);
 
 	return len;
 }
 
+static int wl1271_sysfs_mmap_fwlog(struct file *filp, struct kobject *kobj,
+				   struct bin_attribute *bin_attr,
+				   struct vm_area_struct *vma)
+{
+	struct device *dev = container_of(kobj, struct device, kobj);
+	struct wl1271 *wl = dev_get_drvdata(dev);
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start > WL12XX_FWLOG_RING_SIZE)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, wl->fwlog, 0);
+}
+
 static struct bin_attribute fwlog_attr = {
-	.attr = {.name = "fwlog", .mode = S_IRUSR},
+	.attr = {.name = "fwlog", .mode = S_IRUSR | S_IWUSR},
 	.read = wl1271_sysfs_read_fwlog,
+	.mmap = wl1271_sysfs_mmap_fwlog,
 };
 
 static bool wl12xx_mac_in_fuse(struct wl1271 *wl)
@@ -6191,7 +6808,7 @@ static int wl1271_init_ieee80211(struct wl1271 *wl)
 
 	wl->hw->wiphy->flags |= WIPHY_FLAG_AP_UAPSD;
 
-	/* make sure all our channels fit in the scanned_ch bitmask */
+	/* make sure all our channels fit in the scan channel list */
 	BUILD_BUG_ON(ARRAY_SIZE(wl1271_channels) +
 		     ARRAY_SIZE(wl1271_channels_5ghz) >
 		     WL1271_MAX_CHANNELS);
@@ -6237,6 +6854,42 @@ static int wl1271_init_ieee80211(struct wl1271 *wl)
 	return 0;
 }
 
+/*
+ * Replace the TX or RX aggregation buffer with one of the given size.
+ * The caller must hold wl->mutex, so no burst is in flight.
+ */
+int wl12xx_set_aggr_buf_size(struct wl1271 *wl, bool tx, u32 size)
+{
+	u8 **buf = tx ? &wl->tx_aggr_buf : &wl->rx_aggr_buf;
+	u32 *cur_size = tx ? &wl->tx_aggr_buf_size : &wl->rx_aggr_buf_size;
+	u8 *new_buf;
+
+	if (size < WL1271_AGGR_BUFFER_SIZE_MIN ||
+	    size > WL1271_AGGR_BUFFER_SIZE_MAX)
+		return -ERANGE;
+
+	/* the bus transfers whole words */
+	size = round_down(size, 4);
+	if (size == *cur_size)
+		return 0;
+
+	new_buf = (u8 *)__get_free_pages(GFP_KERNEL, get_order(size));
+	if (!new_buf)
+		return -ENOMEM;
+
+	free_pages((unsigned long)*buf, get_order(*cur_size));
+	*buf = new_buf;
+	*cur_size = size;
+
+	/* the zero-copy ring pages were sized for the old buffer */
+	if (!tx)
+		wl1271_rx_free_pages(wl);
+
+	wl1271_debug(DEBUG_TX | DEBUG_RX, "%s aggregation buffer set to %u",
+		     tx ? "tx" : "rx", size);
+	return 0;
+}
+
 #define WL1271_DEFAULT_CHANNEL 0
 
 static struct ieee80211_hw *wl1271_alloc_hw(void)
@@ -6244,7 +6897,6 @@ static struct ieee80211_hw *wl1271_alloc_hw(void)
 	struct ieee80211_hw *hw;
 	struct wl1271 *wl;
 	int i, j, ret;
-	unsigned int order;
 
 	BUILD_BUG_ON(AP_MAX_STATIONS > WL12XX_MAX_LINKS);
 
@@ -6275,8 +6927,14 @@ static struct ieee80211_hw *wl1271_alloc_hw(void)
 	INIT_WORK(&wl->netstack_work, wl1271_netstack_work);
 	INIT_WORK(&wl->tx_work, wl1271_tx_work);
 	INIT_WORK(&wl->recovery_work, wl1271_recovery_work);
+	INIT_WORK(&wl->event_work, wl1271_event_work);
+	init_completion(&wl->fw_preload_compl);
+	complete(&wl->fw_preload_compl);
+	init_completion(&wl->elp_wake_compl);
 	INIT_DELAYED_WORK(&wl->scan_complete_work, wl1271_scan_complete_work);
 	INIT_DELAYED_WORK(&wl->tx_watchdog_work, wl12xx_tx_watchdog_work);
+	INIT_DELAYED_WORK(&wl->fw_stats_work, wl12xx_fw_stats_work);
+	spin_lock_init(&wl->fw_stats_lock);
 
 	init_completion(&wl->fw_compl);
 
@@ -6299,8 +6957,12 @@ static struct ieee80211_hw *wl1271_alloc_hw(void)
 	wl->platform_quirks = 0;
 	wl->system_hlid = WL12XX_SYSTEM_HLID;
 	wl->active_sta_count = 0;
-	wl->fwlog_size = 0;
+	wl->fwlog_closed = false;
 	wl->target_mem_map = NULL;
+	wl->rx_zerocopy = rx_zerocopy_param;
+	wl->rx_napi = rx_napi_budget_param > 0;
+	wl->rx_napi_coalesce = rx_napi_coalesce_param;
+	wl->tx_sched = WL12XX_TX_SCHED_DRR;
 	init_waitqueue_head(&wl->fwlog_waitq);
 
 	/* The system link is always allocated */
@@ -6324,26 +6986,50 @@ static struct ieee80211_hw *wl1271_alloc_hw(void)
 	/* Apply default driver configuration. */
 	wl1271_conf_init(wl);
 
-	order = get_order(WL1271_AGGR_BUFFER_SIZE);
-	wl->aggr_buf = (u8 *)__get_free_pages(GFP_KERNEL, order);
-	if (!wl->aggr_buf) {
+	wl->tx_aggr_buf_size = round_down(clamp_t(u32, tx_aggr_size_param,
+						  WL1271_AGGR_BUFFER_SIZE_MIN,
+						  WL1271_AGGR_BUFFER_SIZE_MAX), 4);
+	wl->tx_aggr_buf = (u8 *)__get_free_pages(GFP_KERNEL,
+					get_order(wl->tx_aggr_buf_size));
+	if (!wl->tx_aggr_buf) {
 		ret = -ENOMEM;
 		goto err_wq;
 	}
 
+	wl->rx_aggr_buf_size = round_down(clamp_t(u32, rx_aggr_size_param,
+						  WL1271_AGGR_BUFFER_SIZE_MIN,
+						  WL1271_AGGR_BUFFER_SIZE_MAX), 4);
+	wl->rx_aggr_buf = (u8 *)__get_free_pages(GFP_KERNEL,
+					get_order(wl->rx_aggr_buf_size));
+	if (!wl->rx_aggr_buf) {
+		ret = -ENOMEM;
+		goto err_tx_aggr;
+	}
+
+	wl->tx_pad_buf = kzalloc(WL12XX_BUS_BLOCK_SIZE, GFP_KERNEL);
+	if (!wl->tx_pad_buf) {
+		ret = -ENOMEM;
+		goto err_rx_aggr;
+	}
+
 	wl->dummy_packet = wl12xx_alloc_dummy_packet(wl);
 	if (!wl->dummy_packet) {
 		ret = -ENOMEM;
-		goto err_aggr;
+		goto err_pad_buf;
 	}
 
-	/* Allocate one page for the FW log */
-	wl->fwlog = (u8 *)get_zeroed_page(GFP_KERNEL);
+	/* The FW log ring, zeroed and suitable for mapping to userspace */
+	wl->fwlog = vmalloc_user(WL12XX_FWLOG_RING_SIZE);
 	if (!wl->fwlog) {
 		ret = -ENOMEM;
 		goto err_dummy_packet;
 	}
 
+	wl->fwlog->magic = WL12XX_FWLOG_RING_MAGIC;
+	wl->fwlog->version = WL12XX_FWLOG_RING_VERSION;
+	wl->fwlog->data_offset = PAGE_SIZE;
+	wl->fwlog->data_size = WL12XX_FWLOG_DATA_SIZE;
+
 	wl->rx_mem_pool_addr = kmalloc(sizeof(*wl->rx_mem_pool_addr),
 				       GFP_KERNEL);
 	if (!wl->rx_mem_pool_addr) {
@@ -6351,7 +7037,8 @@ static struct ieee80211_hw *wl1271_alloc_hw(void)
 		goto err_fwlog;
 	}
 
-	wl->mbox = kmalloc(sizeof(*wl->mbox), GFP_KERNEL);
+	/* both mailboxes, they are read in one go when both are pending */
+	wl->mbox = kmalloc(2 * sizeof(*wl->mbox), GFP_KERNEL);
 	if (!wl->mbox) {
 		ret = -ENOMEM;
 		goto err_pool_addr;
@@ -6363,8 +7050,64 @@ static struct ieee80211_hw *wl1271_alloc_hw(void)
 		goto err_mbox;
 	}
 
+	wl->acx_buf = kmalloc(WL1271_ACX_BUF_SIZE, GFP_KERNEL);
+	if (!wl->acx_buf) {
+		ret = -ENOMEM;
+		goto err_buffer_32;
+	}
+
+	wl->fw_stats_buf = kzalloc(sizeof(*wl->fw_stats_buf), GFP_KERNEL);
+	if (!wl->fw_stats_buf) {
+		ret = -ENOMEM;
+		goto err_acx_buf;
+	}
+
+	wl->pcpu_stats = alloc_percpu(struct wl12xx_pcpu_stats);
+	if (!wl->pcpu_stats) {
+		ret = -ENOMEM;
+		goto err_fw_stats_buf;
+	}
+
+#if BITS_PER_LONG == 32
+	wl->pcpu_syncp = alloc_percpu(struct u64_stats_sync);
+	if (!wl->pcpu_syncp) {
+		ret = -ENOMEM;
+		goto err_pcpu_stats;
+	}
+#endif
+
+	wl->scan.buf = kzalloc(sizeof(*wl->scan.buf), GFP_KERNEL);
+	if (!wl->scan.buf) {
+		ret = -ENOMEM;
+		goto err_pcpu_syncp;
+	}
+
+	if (wl->rx_napi) {
+		init_dummy_netdev(&wl->napi_dev);
+		netif_napi_add(&wl->napi_dev, &wl->napi, wl12xx_rx_napi_poll,
+			       rx_napi_budget_param);
+		napi_enable(&wl->napi);
+	}
+
 	return hw;
 
+err_pcpu_syncp:
+#if BITS_PER_LONG == 32
+	free_percpu(wl->pcpu_syncp);
+#endif
+
+err_pcpu_stats:
+	free_percpu(wl->pcpu_stats);
+
+err_fw_stats_buf:
+	kfree(wl->fw_stats_buf);
+
+err_acx_buf:
+	kfree(wl->acx_buf);
+
+err_buffer_32:
+	kfree(wl->buffer_32);
+
 err_mbox:
 	kfree(wl->mbox);
 
@@ -6372,13 +7115,21 @@ err_pool_addr:
 	kfree(wl->rx_mem_pool_addr);
 
 err_fwlog:
-	free_page((unsigned long)wl->fwlog);
+	vfree(wl->fwlog);
 
 err_dummy_packet:
 	dev_kfree_skb(wl->dummy_packet);
 
-err_aggr:
-	free_pages((unsigned long)wl->aggr_buf, order);
+err_pad_buf:
+	kfree(wl->tx_pad_buf);
+
+err_rx_aggr:
+	free_pages((unsigned long)wl->rx_aggr_buf,
+		   get_order(wl->rx_aggr_buf_size));
+
+err_tx_aggr:
+	free_pages((unsigned long)wl->tx_aggr_buf,
+		   get_order(wl->tx_aggr_buf_size));
 
 err_wq:
 	destroy_workqueue(wl->freezable_wq);
@@ -6394,32 +7145,56 @@ err_hw_alloc:
 
 static int wl1271_free_hw(struct wl1271 *wl)
 {
+	int i;
+
 #ifdef CONFIG_HAS_WAKELOCK
 	wake_lock_destroy(&wl->rx_wake);
 	wake_lock_destroy(&wl->recovery_wake);
 #endif
 	/* Unblock any fwlog readers */
 	mutex_lock(&wl->mutex);
-	wl->fwlog_size = -1;
+	wl->fwlog_closed = true;
 	wake_up_interruptible_all(&wl->fwlog_waitq);
 	mutex_unlock(&wl->mutex);
 
+	device_remove_file(wl->dev, &dev_attr_fwlog_head);
+
 	device_remove_bin_file(wl->dev, &fwlog_attr);
 
 	device_remove_file(wl->dev, &dev_attr_hw_pg_ver);
 
 	device_remove_file(wl->dev, &dev_attr_bt_coex_state);
+
+	if (wl->rx_napi) {
+		napi_disable(&wl->napi);
+		netif_napi_del(&wl->napi);
+	}
+
+	kfree(wl->scan.buf);
+#if BITS_PER_LONG == 32
+	free_percpu(wl->pcpu_syncp);
+#endif
+	free_percpu(wl->pcpu_stats);
+	kfree(wl->fw_stats_buf);
+	kfree(wl->acx_buf);
 	kfree(wl->buffer_32);
 	kfree(wl->mbox);
 	kfree(wl->rx_mem_pool_addr);
-	free_page((unsigned long)wl->fwlog);
+	vfree(wl->fwlog);
 	dev_kfree_skb(wl->dummy_packet);
-	free_pages((unsigned long)wl->aggr_buf,
-			get_order(WL1271_AGGR_BUFFER_SIZE));
+	kfree(wl->tx_pad_buf);
+	wl1271_rx_free_pages(wl);
+	free_pages((unsigned long)wl->rx_aggr_buf,
+		   get_order(wl->rx_aggr_buf_size));
+	free_pages((unsigned long)wl->tx_aggr_buf,
+		   get_order(wl->tx_aggr_buf_size));
 
 	wl1271_debugfs_exit(wl);
 
-	vfree(wl->fw);
+	/* the preload callback still references wl */
+	wait_for_completion(&wl->fw_preload_compl);
+	for (i = 0; i < WL12XX_FW_TYPE_MAX; i++)
+		wl12xx_boot_free_fw(&wl->fw_cache[i]);
 	wl->fw = NULL;
 	wl->saved_fw_type = WL12XX_FW_TYPE_NONE;
 	kfree(wl->nvs);
@@ -6445,15 +7220,22 @@ static irqreturn_t wl12xx_hardirq(int irq, void *cookie)
 	spin_lock_irqsave(&wl->wl_lock, flags);
 	set_bit(WL1271_FLAG_IRQ_RUNNING, &wl->flags);
 	if (wl->elp_compl) {
+		wl->elp_wake_done = ktime_get();
 		complete(wl->elp_compl);
 		wl->elp_compl = NULL;
 	}
 
+	/* a FW command may be waiting for this, see wl1271_cmd_wait_complete */
+	if (wl->cmd_compl) {
+		complete(wl->cmd_compl);
+		wl->cmd_compl = NULL;
+	}
+
 	if (test_bit(WL1271_FLAG_SUSPENDED, &wl->flags)) {
 		/* don't enqueue a work right now. mark it as pending */
 		set_bit(WL1271_FLAG_PENDING_WORK, &wl->flags);
 		wl1271_debug(DEBUG_IRQ, "should not enqueue work");
-		disable_irq_nosync(wl->irq);
+		wlcore_disable_interrupts_nosync(wl);
 		pm_wakeup_event(wl->dev, 0);
 		spin_unlock_irqrestore(&wl->wl_lock, flags);
 		return IRQ_HANDLED;
@@ -6473,6 +7255,7 @@ int wl12xx_request_irq(struct wl1271 *wl)
 						    struct platform_device,
 						    dev);
 
+	atomic_set(&wl->irq_disable_depth, 0);
 	ret = request_threaded_irq(wl->irq, wl12xx_hardirq, wl12xx_irq,
 				   wl->irqflags,
 				   pdev->name, wl);
@@ -6499,7 +7282,7 @@ int wl12xx_request_irq(struct wl1271 *wl)
 	 * Use the nosync variant to disable interrupts, so the mutex could be
 	 * held without deadlocking.
 	 */
-	disable_irq_nosync(wl->irq);
+	wlcore_disable_interrupts_nosync(wl);
 out:
 	return ret;
 }
@@ -6580,8 +7363,17 @@ static int wl12xx_probe(struct platform_device *pdev)
 		goto out_hw_pg_ver;
 	}
 
+	ret = device_create_file(wl->dev, &dev_attr_fwlog_head);
+	if (ret < 0) {
+		wl1271_error("failed to create sysfs file fwlog_head");
+		goto out_fwlog;
+	}
+
 	return 0;
 
+out_fwlog:
+	device_remove_bin_file(wl->dev, &fwlog_attr);
+
 out_hw_pg_ver:
 	device_remove_file(wl->dev, &dev_attr_hw_pg_ver);
 
@@ -6649,6 +7441,26 @@ MODULE_PARM_DESC(keymap,
 module_param(bug_on_recovery, bool, S_IRUSR | S_IWUSR);
 MODULE_PARM_DESC(bug_on_recovery, "BUG() on fw recovery");
 
+module_param_named(rx_zerocopy, rx_zerocopy_param, bool, S_IRUSR);
+MODULE_PARM_DESC(rx_zerocopy,
+		 "Pass RX frames to mac80211 as fragments of the bus buffer");
+
+module_param_named(rx_napi_budget, rx_napi_budget_param, int, S_IRUSR);
+MODULE_PARM_DESC(rx_napi_budget,
+		 "Frames per RX NAPI poll, 0 delivers RX from a workqueue");
+
+module_param_named(rx_napi_coalesce, rx_napi_coalesce_param, uint,
+		   S_IRUSR);
+MODULE_PARM_DESC(rx_napi_coalesce,
+		 "Pending RX frames that end the IRQ pass early so the "
+		 "NAPI poll delivers them, 0 never ends it early");
+
+module_param_named(tx_aggr_size, tx_aggr_size_param, uint, S_IRUSR);
+MODULE_PARM_DESC(tx_aggr_size, "TX aggregation buffer size in bytes");
+
+module_param_named(rx_aggr_size, rx_aggr_size_param, uint, S_IRUSR);
+MODULE_PARM_DESC(rx_aggr_size, "RX aggregation buffer size in bytes");
+
 module_param_named(fref, fref_param, charp, 0);
 MODULE_PARM_DESC(fref, "FREF clock: 19.2, 26, 26x, 38.4, 38.4x, 52");
 
@@ -78,6 +78,87 @@ out:
 
 #define ELP_ENTRY_DELAY  5
 
+/* cap on a single idle gap sample, so one long idle period can't overflow */
+#define ELP_GAP_SAMPLE_MAX_US 1000000
+
+/* 3/4 old + 1/4 new */
+static u32 wl1271_ps_ewma(u32 avg, u32 sample)
+{
+	if (!avg)
+		return sample;
+
+	return avg - avg / 4 + sample / 4;
+}
+
+/*
+ * Pick how long to keep the chip awake after the last activity. Staying
+ * awake through an idle gap is worth it only if the gap is short compared
+ * to what a wakeup costs, so follow the average gap while it is below
+ * elp_break_even times the average wakeup latency, and go to sleep right
+ * away otherwise.
+ */
+static u32 wl1271_ps_elp_entry_delay(struct wl1271 *wl)
+{
+	u32 limit, gap;
+
+	if (wl->conf.conn.forced_ps)
+		return ELP_ENTRY_DELAY;
+
+	if (!wl->conf.conn.elp_adaptive || !wl->elp_wake_avg_us ||
+	    !wl->elp_gap_avg_us)
+		return wl->conf.conn.elp_timeout;
+
+	limit = wl->elp_wake_avg_us * wl->conf.conn.elp_break_even / 1000;
+	limit = clamp_t(u32, limit, ELP_ENTRY_DELAY,
+			max_t(u32, wl->conf.conn.elp_timeout, ELP_ENTRY_DELAY));
+
+	gap = DIV_ROUND_UP(wl->elp_gap_avg_us, 1000);
+	if (gap > limit)
+		return ELP_ENTRY_DELAY;
+
+	/* some slack for jitter in a periodic pattern */
+	return clamp_t(u32, gap + gap / 4 + 1, ELP_ENTRY_DELAY, limit);
+}
+
+/*
+ * Wakeups per second, over consecutive one second windows. Also called on
+ * read, so that the rate decays when the wakeups stop.
+ * wl->mutex must be taken.
+ */
+void wl1271_ps_elp_rate_update(struct wl1271 *wl)
+{
+	if (!time_after(jiffies, wl->elp_rate_start + HZ))
+		return;
+
+	/* nothing was counted in the last full second */
+	if (time_after(jiffies, wl->elp_rate_start + 2 * HZ))
+		wl->stats.elp_wakeups_per_sec = 0;
+	else
+		wl->stats.elp_wakeups_per_sec = wl->elp_rate_count;
+
+	wl->elp_rate_start = jiffies;
+	wl->elp_rate_count = 0;
+}
+
+/* us is only meaningful if the wakeup was actually timed */
+static void wl1271_ps_elp_wake_stats(struct wl1271 *wl, u32 us, bool timed)
+{
+	int bucket = fls(us >> WL1271_ELP_WAKE_HIST_SHIFT);
+
+	wl->stats.elp_wakeups++;
+	if (timed) {
+		wl->stats.elp_wake_hist[min(bucket,
+					    WL1271_ELP_WAKE_HIST_LEN - 1)]++;
+		if (us > wl->stats.elp_wake_max_us)
+			wl->stats.elp_wake_max_us = us;
+
+		wl->elp_wake_avg_us = wl1271_ps_ewma(wl->elp_wake_avg_us, us);
+	}
+
+	wl1271_ps_elp_rate_update(wl);
+	wl->elp_rate_count++;
+}
+
 /* Routines to toggle sleep mode while in ELP */
 void wl1271_ps_elp_sleep(struct wl1271 *wl)
 {
@@ -88,6 +169,10 @@ void wl1271_ps_elp_sleep(struct wl1271 *wl)
 	if (wl->state == WL1271_STATE_PLT)
 		return;
 
+	/* a wakeup that no bus access waited for still has to complete */
+	if (wl1271_ps_elp_wakeup_finish(wl) < 0)
+		return;
+
 	/* we shouldn't get consecutive sleep requests */
 	if (WARN_ON(test_and_set_bit(WL1271_FLAG_ELP_REQUESTED, &wl->flags)))
 		return;
@@ -101,22 +186,27 @@ void wl1271_ps_elp_sleep(struct wl1271 *wl)
 			return;
 	}
 
-	if (wl->conf.conn.forced_ps)
-		timeout = ELP_ENTRY_DELAY;
-	else
-		timeout = wl->conf.conn.elp_timeout;
+	timeout = wl1271_ps_elp_entry_delay(wl);
+	wl->elp_entry_delay = timeout;
+
+	wl->elp_idle_start = ktime_get();
+	wl->elp_idle_valid = true;
 
 	ieee80211_queue_delayed_work(wl->hw, &wl->elp_work,
 				     msecs_to_jiffies(timeout));
 }
 
-int wl1271_ps_elp_wakeup(struct wl1271 *wl)
+/*
+ * Request the chip to wake up from ELP without waiting for it. The wait is
+ * done by wl1271_ps_elp_wakeup_finish(), at the latest by the next bus
+ * transaction, so the caller can prepare its work while the chip wakes up.
+ */
+int wl1271_ps_elp_wakeup_start(struct wl1271 *wl)
 {
-	DECLARE_COMPLETION_ONSTACK(compl);
 	unsigned long flags;
 	int ret;
-	u32 start_time = jiffies;
 	bool pending = false;
+	u32 us;
 
 	/*
 	 * we might try to wake up even if we didn't go to sleep
@@ -125,6 +215,23 @@ int wl1271_ps_elp_wakeup(struct wl1271 *wl)
 	if (!test_and_clear_bit(WL1271_FLAG_ELP_REQUESTED, &wl->flags))
 		return 0;
 
+	wl->elp_wake_start = ktime_get();
+
+	/*
+	 * The idle gap since the chip was last allowed to sleep. Gaps shorter
+	 * than the minimal entry delay never let the chip sleep, so they say
+	 * nothing about the traffic cadence and are left out.
+	 */
+	if (wl->elp_idle_valid) {
+		us = min_t(s64, ktime_to_us(ktime_sub(wl->elp_wake_start,
+						      wl->elp_idle_start)),
+			   ELP_GAP_SAMPLE_MAX_US);
+		if (us >= ELP_ENTRY_DELAY * USEC_PER_MSEC)
+			wl->elp_gap_avg_us = wl1271_ps_ewma(wl->elp_gap_avg_us,
+							    us);
+		wl->elp_idle_valid = false;
+	}
+
 	/* don't cancel_sync as it might contend for a mutex and deadlock */
 	cancel_delayed_work(&wl->elp_work);
 
@@ -137,50 +244,83 @@ int wl1271_ps_elp_wakeup(struct wl1271 *wl)
 	 * The spinlock is required here to synchronize both the work and
 	 * the completion variable in one entity.
 	 */
+	INIT_COMPLETION(wl->elp_wake_compl);
 	spin_lock_irqsave(&wl->wl_lock, flags);
 	if (test_bit(WL1271_FLAG_IRQ_RUNNING, &wl->flags))
 		pending = true;
 	else
-		wl->elp_compl = &compl;
+		wl->elp_compl = &wl->elp_wake_compl;
 	spin_unlock_irqrestore(&wl->wl_lock, flags);
 
 	ret = wl1271_raw_write32(wl, HW_ACCESS_ELP_CTRL_REG_ADDR,
 				 ELPCTRL_WAKE_UP);
 	if (ret < 0) {
 		wl12xx_queue_recovery_work(wl);
-		goto err;
+		spin_lock_irqsave(&wl->wl_lock, flags);
+		wl->elp_compl = NULL;
+		spin_unlock_irqrestore(&wl->wl_lock, flags);
+		return ret;
 	}
 
-	if (!pending) {
-		ret = wait_for_completion_timeout(
-			&compl, msecs_to_jiffies(WL1271_WAKEUP_TIMEOUT));
-		if (ret == 0) {
-			wl1271_error("ELP wakeup timeout!");
-			wl12xx_queue_recovery_work(wl);
-			ret = -ETIMEDOUT;
-			goto err;
-		} else if (ret < 0) {
-			wl1271_error("ELP wakeup completion error.");
-			goto err;
-		}
+	/* the chip raised an interrupt, so it is awake already */
+	if (pending) {
+		clear_bit(WL1271_FLAG_IN_ELP, &wl->flags);
+		wl1271_ps_elp_wake_stats(wl, 0, false);
+		return 0;
 	}
 
-	clear_bit(WL1271_FLAG_IN_ELP, &wl->flags);
+	set_bit(WL1271_FLAG_ELP_WAKING, &wl->flags);
+	return 0;
+}
 
-	wl1271_debug(DEBUG_PSM, "wakeup time: %u ms",
-		     jiffies_to_msecs(jiffies - start_time));
-	goto out;
+/* Wait for a wakeup started by wl1271_ps_elp_wakeup_start() to complete */
+int wl1271_ps_elp_wakeup_finish(struct wl1271 *wl)
+{
+	unsigned long flags;
+	bool waited;
+	long ret;
+	u32 us;
 
-err:
-	spin_lock_irqsave(&wl->wl_lock, flags);
-	wl->elp_compl = NULL;
-	spin_unlock_irqrestore(&wl->wl_lock, flags);
-	return ret;
+	if (!test_and_clear_bit(WL1271_FLAG_ELP_WAKING, &wl->flags))
+		return 0;
 
-out:
+	waited = !completion_done(&wl->elp_wake_compl);
+	if (!waited)
+		wl->stats.elp_wake_overlapped++;
+
+	ret = wait_for_completion_timeout(&wl->elp_wake_compl,
+				msecs_to_jiffies(WL1271_WAKEUP_TIMEOUT));
+	if (ret == 0) {
+		wl1271_error("ELP wakeup timeout!");
+		wl12xx_queue_recovery_work(wl);
+		spin_lock_irqsave(&wl->wl_lock, flags);
+		wl->elp_compl = NULL;
+		spin_unlock_irqrestore(&wl->wl_lock, flags);
+		return -ETIMEDOUT;
+	}
+
+	clear_bit(WL1271_FLAG_IN_ELP, &wl->flags);
+
+	/* the hardirq stamped when the chip actually came up */
+	us = ktime_to_us(ktime_sub(wl->elp_wake_done, wl->elp_wake_start));
+	wl1271_ps_elp_wake_stats(wl, us, true);
+
+	wl1271_debug(DEBUG_PSM, "wakeup time: %u us%s", us,
+		     waited ? "" : " (overlapped)");
 	return 0;
 }
 
+int wl1271_ps_elp_wakeup(struct wl1271 *wl)
+{
+	int ret;
+
+	ret = wl1271_ps_elp_wakeup_start(wl);
+	if (ret < 0)
+		return ret;
+
+	return wl1271_ps_elp_wakeup_finish(wl);
+}
+
 int wl1271_ps_set_mode(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 		       enum wl1271_cmd_ps_mode mode)
 {
@@ -246,7 +386,6 @@ static void wl1271_ps_filter_frames(struct wl1271 *wl, u8 hlid)
 	int i;
 	struct sk_buff *skb;
 	struct ieee80211_tx_info *info;
-	unsigned long flags;
 	int filtered[NUM_TX_QUEUES];
 
 	/* filter all frames currently in the low level queues for this hlid */
@@ -265,10 +404,8 @@ static void wl1271_ps_filter_frames(struct wl1271 *wl, u8 hlid)
 		}
 	}
 
-	spin_lock_irqsave(&wl->wl_lock, flags);
 	for (i = 0; i < NUM_TX_QUEUES; i++)
-		wl->tx_queue_count[i] -= filtered[i];
-	spin_unlock_irqrestore(&wl->wl_lock, flags);
+		atomic_sub(filtered[i], &wl->tx_queue_count[i]);
 
 	wl1271_handle_tx_low_watermark(wl);
 }
@@ -31,6 +31,9 @@ int wl1271_ps_set_mode(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 		       enum wl1271_cmd_ps_mode mode);
 void wl1271_ps_elp_sleep(struct wl1271 *wl);
 int wl1271_ps_elp_wakeup(struct wl1271 *wl);
+int wl1271_ps_elp_wakeup_start(struct wl1271 *wl);
+int wl1271_ps_elp_wakeup_finish(struct wl1271 *wl);
+void wl1271_ps_elp_rate_update(struct wl1271 *wl);
 void wl1271_elp_work(struct work_struct *work);
 void wl12xx_ps_link_start(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 			  u8 hlid, bool clean_queues);
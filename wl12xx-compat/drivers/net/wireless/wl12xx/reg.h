@@ -407,9 +407,6 @@
 #define NVS_DATA_BUNDARY_ALIGNMENT          4
 
 
-/* Firmware image load chunk size */
-#define CHUNK_SIZE	16384
-
 /* Firmware image header size */
 #define FW_HDR_SIZE 8
 
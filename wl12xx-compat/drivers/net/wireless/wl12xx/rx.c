@@ -22,6 +22,7 @@
  */
 
 #include <linux/gfp.h>
+#include <linux/mm.h>
 #include <linux/sched.h>
 
 #include "wl12xx.h"
@@ -31,6 +32,8 @@
 #include "rx.h"
 #include "tx.h"
 #include "io.h"
+#include "scan.h"
+#include "trace.h"
 
 static u8 wl12xx_rx_get_mem_block(struct wl12xx_fw_status *status,
 				  u32 drv_rx_counter)
@@ -54,6 +57,29 @@ static bool wl12xx_rx_get_unaligned(struct wl12xx_fw_status *status,
 		RX_BUF_UNALIGNED_PAYLOAD);
 }
 
+/* 802.1d user priority to CONF_TX_AC_* */
+static const u8 wl1271_rx_up_to_ac[] = {
+	CONF_TX_AC_BE, CONF_TX_AC_BK, CONF_TX_AC_BK, CONF_TX_AC_BE,
+	CONF_TX_AC_VI, CONF_TX_AC_VI, CONF_TX_AC_VO, CONF_TX_AC_VO,
+};
+
+static void wl1271_rx_count_packet(struct wl1271 *wl, struct sk_buff *skb,
+				   u8 hlid)
+{
+	struct ieee80211_hdr *hdr = (struct ieee80211_hdr *)skb->data;
+	int ac = CONF_TX_AC_BE;
+
+	if (unlikely(hlid >= WL12XX_MAX_LINKS))
+		return;
+
+	if (ieee80211_is_data_qos(hdr->frame_control))
+		ac = wl1271_rx_up_to_ac[*ieee80211_get_qos_ctl(hdr) &
+					IEEE80211_QOS_CTL_TAG1D_MASK];
+
+	wl12xx_pcpu_inc(wl, rx_packets[hlid][ac]);
+	wl12xx_pcpu_add(wl, rx_bytes[hlid][ac], skb->len);
+}
+
 static void wl1271_rx_status(struct wl1271 *wl,
 			     struct wl1271_rx_descriptor *desc,
 			     struct ieee80211_rx_status *status,
@@ -97,13 +123,118 @@ static void wl1271_rx_status(struct wl1271 *wl,
 	}
 }
 
+/*
+ * Get a free burst buffer from the zero-copy RX ring. A buffer is free again
+ * once the stack has freed every skb built around it. Buffers the stack
+ * still holds stay in the ring, only empty slots get a new allocation. When
+ * all of them are busy the burst goes through the copy path rather than
+ * allocating another high order page.
+ */
+static struct page *wl1271_rx_get_page(struct wl1271 *wl)
+{
+	unsigned int i, idx = 0;
+	struct page *page;
+
+	for (i = 0; i < WL1271_RX_PAGE_RING_SIZE; i++) {
+		idx = (wl->rx_page_idx + i) % WL1271_RX_PAGE_RING_SIZE;
+		page = wl->rx_pages[idx];
+
+		if (!page) {
+			page = alloc_pages(GFP_KERNEL | __GFP_COMP |
+					   __GFP_NOWARN,
+					   get_order(wl->rx_aggr_buf_size));
+			if (!page)
+				return NULL;
+
+			wl->rx_pages[idx] = page;
+			wl->stats.rx_zc_allocated++;
+			goto out;
+		}
+
+		if (page_count(page) == 1) {
+			wl->stats.rx_zc_recycled++;
+			goto out;
+		}
+	}
+
+	wl->stats.rx_zc_busy++;
+	return NULL;
+
+out:
+	wl->rx_page_idx = (idx + 1) % WL1271_RX_PAGE_RING_SIZE;
+	return page;
+}
+
+void wl1271_rx_free_pages(struct wl1271 *wl)
+{
+	int i;
+
+	for (i = 0; i < WL1271_RX_PAGE_RING_SIZE; i++) {
+		if (wl->rx_pages[i])
+			put_page(wl->rx_pages[i]);
+		wl->rx_pages[i] = NULL;
+	}
+}
+
+/*
+ * Build an skb for a frame of len bytes (descriptor excluded) at data. When
+ * the frame lives in a zero-copy RX buffer (page != NULL), only the start of
+ * the frame is copied into the linear part, so mac80211 can parse the
+ * 802.11 and LLC headers in place. The payload is attached as a page
+ * fragment pointing into the burst buffer, charged as frag_truesize.
+ */
+static struct sk_buff *wl1271_rx_build_skb(struct wl1271 *wl, u8 *data,
+					   u32 len, u8 reserved,
+					   struct page *page, u32 frag_truesize)
+{
+	struct sk_buff *skb;
+	u32 head_len;
+
+	if (!page) {
+		skb = __dev_alloc_skb(len + reserved, GFP_KERNEL);
+		if (!skb)
+			return NULL;
+
+		/* reserve the unaligned payload(if any) */
+		skb_reserve(skb, reserved);
+
+		/*
+		 * Copy packets from aggregation buffer to the skbs without rx
+		 * descriptor and with packet payload aligned care. In case of
+		 * unaligned packets copy the packets in offset of 2 bytes
+		 * guarantee IP header payload aligned to 4 bytes.
+		 */
+		memcpy(skb_put(skb, len), data, len);
+		return skb;
+	}
+
+	head_len = min_t(u32, len, WL1271_RX_ZC_HEAD_LEN);
+
+	skb = __dev_alloc_skb(WL1271_RX_ZC_HEAD_LEN + reserved, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	skb_reserve(skb, reserved);
+	memcpy(skb_put(skb, head_len), data, head_len);
+
+	if (len > head_len) {
+		get_page(page);
+		skb_add_rx_frag(skb, 0, page,
+				data + head_len - (u8 *)page_address(page),
+				len - head_len, frag_truesize);
+	}
+
+	return skb;
+}
+
 static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length,
-				 bool unaligned, u8 *hlid)
+				 bool unaligned, u8 *hlid, struct page *page,
+				 u32 burst_len)
 {
 	struct wl1271_rx_descriptor *desc;
+	u32 frag_truesize = 0;
 	struct sk_buff *skb;
 	struct ieee80211_hdr *hdr;
-	u8 *buf;
 	u8 beacon = 0;
 	u8 is_data = 0;
 	u8 reserved = unaligned ? NET_IP_ALIGN : 0;
@@ -122,7 +253,7 @@ static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length,
 	if (desc->packet_class == WL12XX_RX_CLASS_LOGGER) {
 		size_t len = length - sizeof(*desc);
 		wl12xx_copy_fwlog(wl, data + sizeof(*desc), len);
-		wake_up_interruptible(&wl->fwlog_waitq);
+		wl12xx_fwlog_notify(wl);
 		return 0;
 	}
 
@@ -132,6 +263,7 @@ static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length,
 	case WL1271_RX_DESC_DECRYPT_FAIL:
 		wl1271_warning("corrupted packet in RX with status: 0x%x",
 			       desc->status & WL1271_RX_DESC_STATUS_MASK);
+		wl12xx_pcpu_inc(wl, drops[WL12XX_DROP_RX_INVALID]);
 		return -EINVAL;
 	case WL1271_RX_DESC_SUCCESS:
 	case WL1271_RX_DESC_MIC_FAIL:
@@ -139,28 +271,30 @@ static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length,
 	default:
 		wl1271_error("invalid RX descriptor status: 0x%x",
 			     desc->status & WL1271_RX_DESC_STATUS_MASK);
+		wl12xx_pcpu_inc(wl, drops[WL12XX_DROP_RX_INVALID]);
 		return -EINVAL;
 	}
 
-	/* skb length not included rx descriptor */
-	skb = __dev_alloc_skb(length + reserved - sizeof(*desc), GFP_KERNEL);
+	/*
+	 * The burst buffer stays pinned until the last of its frames is
+	 * freed, so each frame is charged for the share of the whole buffer
+	 * its slot in the burst takes up.
+	 */
+	if (page)
+		frag_truesize = div_u64((u64)length *
+					(PAGE_SIZE << compound_order(page)),
+					burst_len);
+
+	/* skb length not included rx descriptor nor the FW padding */
+	skb = wl1271_rx_build_skb(wl, data + sizeof(*desc),
+				  length - sizeof(*desc) - desc->pad_len,
+				  reserved, page, frag_truesize);
 	if (!skb) {
 		wl1271_error("Couldn't allocate RX frame");
+		wl12xx_pcpu_inc(wl, drops[WL12XX_DROP_RX_NOMEM]);
 		return -ENOMEM;
 	}
 
-	/* reserve the unaligned payload(if any) */
-	skb_reserve(skb, reserved);
-
-	buf = skb_put(skb, length - sizeof(*desc));
-
-	/*
-	 * Copy packets from aggregation buffer to the skbs without rx
-	 * descriptor and with packet payload aligned care. In case of unaligned
-	 * packets copy the packets in offset of 2 bytes guarantee IP header
-	 * payload aligned to 4 bytes.
-	 */
-	memcpy(buf, data + sizeof(*desc), length - sizeof(*desc));
 	*hlid = desc->hlid;
 
 	hdr = (struct ieee80211_hdr *)skb->data;
@@ -171,22 +305,33 @@ static int wl1271_rx_handle_data(struct wl1271 *wl, u8 *data, u32 length,
 
 	wl1271_rx_status(wl, desc, IEEE80211_SKB_RXCB(skb), beacon);
 
+	if (beacon || ieee80211_is_probe_resp(hdr->frame_control))
+		wl1271_scan_candidate(wl, IEEE80211_SKB_RXCB(skb)->band,
+				      desc->channel, hdr->addr3);
+
 	seq_num = (le16_to_cpu(hdr->seq_ctrl) & IEEE80211_SCTL_SEQ) >> 4;
 	wl1271_debug(DEBUG_RX, "rx skb 0x%p: %d B %s seq %d hlid %d", skb,
-		     skb->len - desc->pad_len,
+		     skb->len,
 		     beacon ? "beacon" : "",
 		     seq_num, *hlid);
 
-	skb_trim(skb, skb->len - desc->pad_len);
-
 	if (wl->log_wakes > 0) {
 		print_hex_dump(KERN_INFO, DRIVER_PREFIX "wake: ", DUMP_PREFIX_OFFSET,
-					   16, 1, skb->data, min_t(size_t, skb->len, 96), true);
+					   16, 1, data + sizeof(*desc),
+					   min_t(size_t, skb->len, 96), true);
 		--wl->log_wakes;
 	}
 
+	if (unlikely(wl->ttff_pending))
+		wl12xx_ttff_done(wl);
+
+	wl1271_rx_count_packet(wl, skb, *hlid);
+	trace_wl12xx_rx_frame(wl, skb, *hlid);
 	skb_queue_tail(&wl->deferred_rx_queue, skb);
-	queue_work(wl->freezable_wq, &wl->netstack_work);
+
+	/* the IRQ loop schedules the NAPI poll for the whole burst */
+	if (!wl->rx_napi)
+		queue_work(wl->freezable_wq, &wl->netstack_work);
 
 #ifdef CONFIG_HAS_WAKELOCK
 	/* let the frame some time to propagate to user-space */
@@ -209,15 +354,21 @@ int wl12xx_rx(struct wl1271 *wl, struct wl12xx_fw_status *status)
 	u32 pkt_offset;
 	u8 hlid;
 	bool unaligned = false;
+	enum wl1271_aggr_flush_reason reason;
+	struct page *page;
+	u8 *buf;
 	int ret = 0;
 
 	while (drv_rx_counter != fw_rx_counter) {
 		buf_size = 0;
 		rx_counter = drv_rx_counter;
+		reason = WL1271_AGGR_FLUSH_QUEUE_EMPTY;
 		while (rx_counter != fw_rx_counter) {
 			pkt_length = wl12xx_rx_get_buf_size(status, rx_counter);
-			if (buf_size + pkt_length > WL1271_AGGR_BUFFER_SIZE)
+			if (buf_size + pkt_length > wl->rx_aggr_buf_size) {
+				reason = WL1271_AGGR_FLUSH_BUF_FULL;
 				break;
+			}
 			buf_size += pkt_length;
 			rx_counter++;
 			rx_counter &= NUM_RX_PKT_DESC_MOD_MASK;
@@ -251,12 +402,23 @@ int wl12xx_rx(struct wl1271 *wl, struct wl12xx_fw_status *status)
 				goto out;
 		}
 
+		/*
+		 * In zero-copy mode the burst is read into a page that the
+		 * skbs will point into. Fall back to the aggregation buffer
+		 * if no page is available.
+		 */
+		page = wl->rx_zerocopy ? wl1271_rx_get_page(wl) : NULL;
+		buf = page ? page_address(page) : wl->rx_aggr_buf;
+
 		/* Read all available packets at once */
-		ret = wl1271_read(wl, WL1271_SLV_MEM_DATA, wl->aggr_buf,
-				  buf_size, true);
+		ret = wl1271_read(wl, WL1271_SLV_MEM_DATA, buf, buf_size, true);
 		if (ret < 0)
 			goto out;
 
+		trace_wl12xx_rx_read(wl, buf_size, reason);
+		wl1271_aggr_stats_add(wl->stats.rx_aggr_hist,
+				      wl->stats.rx_aggr_flush, buf_size, reason);
+
 		/* Split data into separate packets */
 		pkt_offset = 0;
 		while (pkt_offset < buf_size) {
@@ -271,10 +433,9 @@ int wl12xx_rx(struct wl1271 *wl, struct wl12xx_fw_status *status)
 			 * conditions, in that case the received frame will just
 			 * be dropped.
 			 */
-			if (wl1271_rx_handle_data(wl,
-						  wl->aggr_buf + pkt_offset,
+			if (wl1271_rx_handle_data(wl, buf + pkt_offset,
 						  pkt_length, unaligned,
-						  &hlid) == 1) {
+						  &hlid, page, buf_size) == 1) {
 				if (hlid < WL12XX_MAX_LINKS)
 					__set_bit(hlid, active_hlids);
 				else
@@ -126,7 +126,14 @@ struct wl1271_rx_descriptor {
 	u8  reserved;
 } __packed;
 
+/*
+ * Zero-copy RX: number of bytes copied into the skb linear part, enough for
+ * the largest 802.11 header plus the LLC/SNAP header.
+ */
+#define WL1271_RX_ZC_HEAD_LEN 64
+
 int wl12xx_rx(struct wl1271 *wl, struct wl12xx_fw_status *status);
+void wl1271_rx_free_pages(struct wl1271 *wl);
 u8 wl1271_rate_to_idx(int rate, enum ieee80211_band band);
 void wl1271_set_default_filters(struct wl1271 *wl);
 int wl1271_rx_data_filtering_enable(struct wl1271 *wl, bool enable,
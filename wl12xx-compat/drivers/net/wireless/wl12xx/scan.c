@@ -22,6 +22,7 @@
  */
 
 #include <linux/ieee80211.h>
+#include <linux/etherdevice.h>
 
 #include "wl12xx.h"
 #include "debug.h"
@@ -30,6 +31,7 @@
 #include "acx.h"
 #include "ps.h"
 #include "tx.h"
+#include "event.h"
 
 #define SCHED_SCAN_LONG_INTERVAL 300000
 
@@ -63,8 +65,17 @@ void wl1271_scan_complete_work(struct work_struct *work)
 	 */
 	wl12xx_rearm_tx_watchdog_locked(wl);
 
+	wl->stats.scan_ms = div_u64(ktime_to_us(ktime_sub(ktime_get(),
+							  wl->scan.start)),
+				    1000);
+	if (wl->stats.scan_ms > wl->stats.scan_max_ms)
+		wl->stats.scan_max_ms = wl->stats.scan_ms;
+	if (wl->scan.ttfc_pending) {
+		wl->scan.ttfc_pending = false;
+		wl->stats.scans_no_candidate++;
+	}
+
 	wl->scan.state = WL1271_SCAN_STATE_IDLE;
-	memset(wl->scan.scanned_ch, 0, sizeof(wl->scan.scanned_ch));
 	wl->scan.req = NULL;
 	wl->scan_vif = NULL;
 
@@ -92,118 +103,231 @@ out:
 }
 
 
-static int wl1271_get_scan_channels(struct wl1271 *wl,
-				    struct cfg80211_scan_request *req,
-				    struct basic_scan_channel_params *channels,
-				    enum ieee80211_band band, bool passive)
+static void wl1271_scan_fill_channel(struct wl1271 *wl,
+				     struct cfg80211_scan_request *req,
+				     struct ieee80211_channel *chan,
+				     struct basic_scan_channel_params *ch,
+				     bool passive)
 {
 	struct conf_scan_settings *c = &wl->conf.scan;
-	int i, j;
-	u32 flags;
 
-	for (i = 0, j = 0;
-	     i < req->n_channels && j < WL1271_SCAN_MAX_CHANNELS;
-	     i++) {
-		flags = req->channels[i]->flags;
+	wl1271_debug(DEBUG_SCAN, "band %d freq %d hw_value %d flags 0x%x "
+		     "max_power %d %s", chan->band, chan->center_freq,
+		     chan->hw_value, chan->flags, chan->max_power,
+		     passive ? "passive" : "active");
+
+	memset(ch, 0, sizeof(*ch));
+
+	if (!passive) {
+		ch->min_duration = cpu_to_le32(req->min_dwell ?:
+					       c->min_dwell_time_active);
+		ch->max_duration = cpu_to_le32(req->max_dwell ?:
+					       c->max_dwell_time_active);
+	} else if (req->n_ssids == 0) {
+		ch->min_duration = cpu_to_le32(req->min_dwell ?:
+					       c->min_dwell_time_passive);
+		ch->max_duration = cpu_to_le32(req->max_dwell ?:
+					       c->max_dwell_time_passive);
+	} else {
+		ch->min_duration = cpu_to_le32(c->min_dwell_time_passive);
+		ch->max_duration = cpu_to_le32(c->max_dwell_time_passive);
+	}
 
-		if (!test_bit(i, wl->scan.scanned_ch) &&
-		    !(flags & IEEE80211_CHAN_DISABLED) &&
-		    (req->channels[i]->band == band) &&
-		    /*
-		     * In passive scans, we scan all remaining
-		     * channels, even if not marked as such.
-		     * In active scans, we only scan channels not
-		     * marked as passive.
-		     */
-		    (passive || !(flags & IEEE80211_CHAN_PASSIVE_SCAN))) {
-			wl1271_debug(DEBUG_SCAN, "band %d, center_freq %d ",
-				     req->channels[i]->band,
-				     req->channels[i]->center_freq);
-			wl1271_debug(DEBUG_SCAN, "hw_value %d, flags %X",
-				     req->channels[i]->hw_value,
-				     req->channels[i]->flags);
-			wl1271_debug(DEBUG_SCAN,
-				     "max_antenna_gain %d, max_power %d",
-				     req->channels[i]->max_antenna_gain,
-				     req->channels[i]->max_power);
-			wl1271_debug(DEBUG_SCAN, "beacon_found %d",
-				     req->channels[i]->beacon_found);
-
-			if (!passive) {
-				if (req->min_dwell)
-					channels[j].min_duration =
-						req->min_dwell;
-				else
-					channels[j].min_duration =
-					  cpu_to_le32(c->min_dwell_time_active);
-
-				if (req->max_dwell)
-					channels[j].max_duration =
-						req->max_dwell;
-				else
-					channels[j].max_duration =
-					  cpu_to_le32(c->max_dwell_time_active);
-			} else {
-				if ((req->min_dwell) &&
-					(wl->scan.req->n_ssids == 0))
-						channels[j].min_duration =
-							req->min_dwell;
-				else
-					channels[j].min_duration =
-					 cpu_to_le32(c->min_dwell_time_passive);
-
-				if ((req->max_dwell) &&
-					(wl->scan.req->n_ssids == 0))
-						channels[j].min_duration =
-							req->max_dwell;
-				else
-					channels[j].max_duration =
-					 cpu_to_le32(c->max_dwell_time_passive);
-			}
-			channels[j].early_termination = 0;
-			channels[j].tx_power_att = req->channels[i]->max_power;
-			channels[j].channel = req->channels[i]->hw_value;
+	ch->tx_power_att = chan->max_power;
+	ch->channel = chan->hw_value;
 
-			memset(&channels[j].bssid_lsb, 0xff, 4);
-			memset(&channels[j].bssid_msb, 0xff, 2);
+	memset(&ch->bssid_lsb, 0xff, 4);
+	memset(&ch->bssid_msb, 0xff, 2);
+}
 
-			/* Mark the channels we already used */
-			set_bit(i, wl->scan.scanned_ch);
+/*
+ * Candidates seen per channel. Every frame received while scanning adds a
+ * hit, every scan halves the history so that it follows the neighbourhood
+ * as it changes. The AP we are associated with is not a candidate, its
+ * beacons would only pin the home channel at the top.
+ */
+void wl1271_scan_candidate(struct wl1271 *wl, enum ieee80211_band band,
+			   u8 channel, const u8 *bssid)
+{
+	struct wl12xx_vif *wlvif;
+	struct ieee80211_vif *vif;
+	u8 *hits;
 
-			j++;
+	if (wl->scan.state == WL1271_SCAN_STATE_IDLE)
+		return;
+
+	wl12xx_for_each_wlvif_sta(wl, wlvif) {
+		vif = wl12xx_wlvif_to_vif(wlvif);
+		if (test_bit(WLVIF_FLAG_STA_ASSOCIATED, &wlvif->flags) &&
+		    !compare_ether_addr(bssid, vif->bss_conf.bssid))
+			return;
+	}
+
+	hits = &wl->scan.buf->hist[band][channel];
+	if (*hits < 0xff)
+		(*hits)++;
+
+	if (unlikely(wl->scan.ttfc_pending)) {
+		u32 us = ktime_to_us(ktime_sub(ktime_get(), wl->scan.start));
+
+		wl->scan.ttfc_pending = false;
+		wl->stats.scan_ttfc_us = us;
+		wl->stats.scan_ttfc_total_us += us;
+		wl->stats.scan_ttfc_count++;
+		if (us > wl->stats.scan_ttfc_max_us)
+			wl->stats.scan_ttfc_max_us = us;
+	}
+}
+
+/*
+ * Order in which the passes are scanned: the band we are associated on
+ * first, so its neighbours are found before the other band is visited,
+ * and the active pass of a band before its passive one.
+ */
+static int wl1271_scan_pass_rank(enum ieee80211_band band, bool passive,
+				 enum ieee80211_band home)
+{
+	return (band != home) * 2 + passive;
+}
+
+/*
+ * Plan the whole scan up front. The FW takes a single band and probe mode
+ * per CMD_SCAN, so each pass becomes as few commands as its channels fit
+ * in, empty passes none at all. Within a pass the channels that gave the
+ * most candidates lately go first.
+ */
+static void wl1271_scan_plan(struct wl1271 *wl, struct wl12xx_vif *wlvif,
+			     struct cfg80211_scan_request *req)
+{
+	struct wl1271_scan_buf *buf = wl->scan.buf;
+	struct ieee80211_channel *chan;
+	enum ieee80211_band home = IEEE80211_BAND_2GHZ;
+	struct wl1271_scan_step *step = NULL;
+	u8 order[WL1271_MAX_CHANNELS];
+	u8 rank[WL1271_MAX_CHANNELS];
+	u8 hits[WL1271_MAX_CHANNELS];
+	int i, j, n = 0, band, ch;
+	bool passive;
+
+	for (band = 0; band < IEEE80211_NUM_BANDS; band++)
+		for (ch = 0; ch < WL1271_SCAN_HIST_CHANNELS; ch++)
+			buf->hist[band][ch] >>= 1;
+
+	if (test_bit(WLVIF_FLAG_STA_ASSOCIATED, &wlvif->flags))
+		home = wlvif->band;
+
+	/* insertion sort on (pass rank, hits), stable for equal keys */
+	for (i = 0; i < req->n_channels; i++) {
+		chan = req->channels[i];
+		if (chan->flags & IEEE80211_CHAN_DISABLED)
+			continue;
+		if (chan->band == IEEE80211_BAND_5GHZ && !wl->enable_11a)
+			continue;
+
+		passive = !req->n_ssids ||
+			  (chan->flags & IEEE80211_CHAN_PASSIVE_SCAN);
+		rank[i] = wl1271_scan_pass_rank(chan->band, passive, home);
+		hits[i] = buf->hist[chan->band][chan->hw_value & 0xff];
+
+		for (j = n; j > 0; j--) {
+			u8 prev = order[j - 1];
+
+			if (rank[prev] < rank[i] ||
+			    (rank[prev] == rank[i] && hits[prev] >= hits[i]))
+				break;
+			order[j] = prev;
 		}
+		order[j] = i;
+		n++;
 	}
 
-	return j;
+	wl->scan.n_steps = 0;
+	wl->scan.cur_step = 0;
+
+	for (i = 0; i < n; i++) {
+		chan = req->channels[order[i]];
+		passive = rank[order[i]] & 1;
+
+		if (!step || step->band != chan->band ||
+		    step->passive != passive ||
+		    step->n_ch == WL1271_SCAN_MAX_CHANNELS) {
+			step = &buf->steps[wl->scan.n_steps++];
+			step->band = chan->band;
+			step->passive = passive;
+			step->first = i;
+			step->n_ch = 0;
+		}
+
+		wl1271_scan_fill_channel(wl, req, chan, &buf->channels[i],
+					 passive);
+		step->n_ch++;
+	}
+
+	wl1271_debug(DEBUG_SCAN, "scan plan: %d channels in %d commands",
+		     n, wl->scan.n_steps);
 }
 
-#define WL1271_NOTHING_TO_SCAN 1
+/* invalidated by a FW boot and whenever a role goes away */
+static int wl1271_scan_probe_req(struct wl1271 *wl, struct wl12xx_vif *wlvif,
+				 struct ieee80211_vif *vif, u8 role_id,
+				 enum ieee80211_band band)
+{
+	struct wl1271_scan_probe_templ *t = &wl->scan.buf->probe_templ[band];
+	struct cfg80211_scan_request *req = wl->scan.req;
+	u32 rate = wl1271_tx_min_rate_get(wl, wlvif->bitrate_masks[band]);
+	int ret;
+
+	if (test_bit(band, &wl->scan.probe_templ_valid) &&
+	    t->role_id == role_id && t->rate == rate &&
+	    !compare_ether_addr(t->addr, vif->addr) &&
+	    t->ssid_len == wl->scan.ssid_len &&
+	    !memcmp(t->ssid, wl->scan.ssid, t->ssid_len) &&
+	    t->ie_len == req->ie_len && !memcmp(t->ie, req->ie, t->ie_len)) {
+		wl->stats.scan_templ_reused++;
+		return 0;
+	}
+
+	__clear_bit(band, &wl->scan.probe_templ_valid);
+
+	ret = wl12xx_cmd_build_probe_req(wl, wlvif, role_id, band,
+					 wl->scan.ssid, wl->scan.ssid_len,
+					 req->ie, req->ie_len, false);
+	if (ret < 0)
+		return ret;
+
+	/* cfg80211 limits the IEs to max_scan_ie_len */
+	if (req->ie_len > sizeof(t->ie))
+		return 0;
+
+	t->role_id = role_id;
+	t->rate = rate;
+	memcpy(t->addr, vif->addr, ETH_ALEN);
+	t->ssid_len = wl->scan.ssid_len;
+	memcpy(t->ssid, wl->scan.ssid, t->ssid_len);
+	t->ie_len = req->ie_len;
+	memcpy(t->ie, req->ie, t->ie_len);
+	__set_bit(band, &wl->scan.probe_templ_valid);
+
+	return 0;
+}
 
 static int wl1271_scan_send(struct wl1271 *wl, struct ieee80211_vif *vif,
-			    enum ieee80211_band band,
-			    bool passive, u32 basic_rate)
+			    struct wl1271_scan_step *step, u32 basic_rate)
 {
 	struct wl12xx_vif *wlvif = wl12xx_vif_to_data(vif);
-	struct wl1271_cmd_scan *cmd;
-	struct wl1271_cmd_trigger_scan_to *trigger;
+	struct wl1271_cmd_scan *cmd = &wl->scan.buf->cmd;
+	struct wl1271_cmd_trigger_scan_to *trigger = &wl->scan.buf->trigger;
+	enum ieee80211_band band = step->band;
 	int ret;
 	u16 scan_options = 0;
 
-	/* skip active scans if we don't have SSIDs */
-	if (!passive && wl->scan.req->n_ssids == 0)
-		return WL1271_NOTHING_TO_SCAN;
-
-	cmd = kzalloc(sizeof(*cmd), GFP_KERNEL);
-	trigger = kzalloc(sizeof(*trigger), GFP_KERNEL);
-	if (!cmd || !trigger) {
-		ret = -ENOMEM;
-		goto out;
-	}
+	memset(cmd, 0, sizeof(*cmd));
+	memset(trigger, 0, sizeof(*trigger));
 
 	if (wl->conf.scan.split_scan_timeout)
 		scan_options |= WL1271_SCAN_OPT_SPLIT_SCAN;
 
-	if (passive)
+	if (step->passive)
 		scan_options |= WL1271_SCAN_OPT_PASSIVE;
 
 	if (wlvif->bss_type == BSS_TYPE_AP_BSS ||
@@ -212,31 +336,19 @@ static int wl1271_scan_send(struct wl1271 *wl, struct ieee80211_vif *vif,
 	else
 		cmd->params.role_id = wlvif->dev_role_id;
 
-	if (WARN_ON(cmd->params.role_id == WL12XX_INVALID_ROLE_ID)) {
-		ret = -EINVAL;
-		goto out;
-	}
+	if (WARN_ON(cmd->params.role_id == WL12XX_INVALID_ROLE_ID))
+		return -EINVAL;
 
 	cmd->params.scan_options = cpu_to_le16(scan_options);
 
-	cmd->params.n_ch = wl1271_get_scan_channels(wl, wl->scan.req,
-						    cmd->channels,
-						    band, passive);
-	if (cmd->params.n_ch == 0) {
-		ret = WL1271_NOTHING_TO_SCAN;
-		goto out;
-	}
+	memcpy(cmd->channels, &wl->scan.buf->channels[step->first],
+	       step->n_ch * sizeof(cmd->channels[0]));
+	cmd->params.n_ch = step->n_ch;
 
 	cmd->params.tx_rate = cpu_to_le32(basic_rate);
-	cmd->params.n_probe_reqs = wl->conf.scan.num_probe_reqs;
 	cmd->params.tid_trigger = CONF_TX_AC_ANY_TID;
 	cmd->params.scan_tag = WL1271_SCAN_DEFAULT_TAG;
 
-	if (band == IEEE80211_BAND_2GHZ)
-		cmd->params.band = WL1271_SCAN_BAND_2_4_GHZ;
-	else
-		cmd->params.band = WL1271_SCAN_BAND_5_GHZ;
-
 	if (wl->scan.req->num_probe)
 		cmd->params.n_probe_reqs = wl->scan.req->num_probe;
 	else
@@ -254,14 +366,10 @@ static int wl1271_scan_send(struct wl1271 *wl, struct ieee80211_vif *vif,
 
 	memcpy(cmd->addr, vif->addr, ETH_ALEN);
 
-	ret = wl12xx_cmd_build_probe_req(wl, wlvif,
-					 cmd->params.role_id, band,
-					 wl->scan.ssid, wl->scan.ssid_len,
-					 wl->scan.req->ie,
-					 wl->scan.req->ie_len, false);
+	ret = wl1271_scan_probe_req(wl, wlvif, vif, cmd->params.role_id, band);
 	if (ret < 0) {
 		wl1271_error("PROBE request template failed");
-		goto out;
+		return ret;
 	}
 
 	trigger->timeout = cpu_to_le32(wl->conf.scan.split_scan_timeout);
@@ -269,7 +377,7 @@ static int wl1271_scan_send(struct wl1271 *wl, struct ieee80211_vif *vif,
 			      sizeof(*trigger), 0);
 	if (ret < 0) {
 		wl1271_error("trigger scan to failed for hw scan");
-		goto out;
+		return ret;
 	}
 
 	wl1271_dump(DEBUG_SCAN, "SCAN: ", cmd, sizeof(*cmd));
@@ -277,20 +385,18 @@ static int wl1271_scan_send(struct wl1271 *wl, struct ieee80211_vif *vif,
 	ret = wl1271_cmd_send(wl, CMD_SCAN, cmd, sizeof(*cmd), 0);
 	if (ret < 0) {
 		wl1271_error("SCAN failed");
-		goto out;
+		return ret;
 	}
 
-out:
-	kfree(cmd);
-	kfree(trigger);
-	return ret;
+	wl->stats.scan_cmds++;
+	return 0;
 }
 
 void wl1271_scan_stm(struct wl1271 *wl, struct ieee80211_vif *vif)
 {
 	struct wl12xx_vif *wlvif = wl12xx_vif_to_data(vif);
+	struct wl1271_scan_step *step;
 	int ret = 0;
-	enum ieee80211_band band;
 	u32 rate, mask;
 
 	switch (wl->scan.state) {
@@ -298,62 +404,29 @@ void wl1271_scan_stm(struct wl1271 *wl, struct ieee80211_vif *vif)
 		break;
 
 	case WL1271_SCAN_STATE_2GHZ_ACTIVE:
-		band = IEEE80211_BAND_2GHZ;
-		mask = wlvif->bitrate_masks[band];
-		if (wl->scan.req->no_cck) {
-			mask &= ~CONF_TX_CCK_RATES;
-			if (!mask)
-				mask = CONF_TX_RATE_MASK_BASIC_P2P;
-		}
-		rate = wl1271_tx_min_rate_get(wl, mask);
-		ret = wl1271_scan_send(wl, vif, band, false, rate);
-		if (ret == WL1271_NOTHING_TO_SCAN) {
-			wl->scan.state = WL1271_SCAN_STATE_2GHZ_PASSIVE;
+	case WL1271_SCAN_STATE_2GHZ_PASSIVE:
+	case WL1271_SCAN_STATE_5GHZ_ACTIVE:
+	case WL1271_SCAN_STATE_5GHZ_PASSIVE:
+		if (wl->scan.cur_step == wl->scan.n_steps) {
+			wl->scan.state = WL1271_SCAN_STATE_DONE;
 			wl1271_scan_stm(wl, vif);
+			break;
 		}
 
-		break;
+		step = &wl->scan.buf->steps[wl->scan.cur_step++];
+		wl->scan.state = WL1271_SCAN_STATE_2GHZ_ACTIVE +
+				 (step->band == IEEE80211_BAND_5GHZ) * 2 +
+				 step->passive;
 
-	case WL1271_SCAN_STATE_2GHZ_PASSIVE:
-		band = IEEE80211_BAND_2GHZ;
-		mask = wlvif->bitrate_masks[band];
-		if (wl->scan.req->no_cck) {
+		mask = wlvif->bitrate_masks[step->band];
+		if (step->band == IEEE80211_BAND_2GHZ &&
+		    wl->scan.req->no_cck) {
 			mask &= ~CONF_TX_CCK_RATES;
 			if (!mask)
 				mask = CONF_TX_RATE_MASK_BASIC_P2P;
 		}
 		rate = wl1271_tx_min_rate_get(wl, mask);
-		ret = wl1271_scan_send(wl, vif, band, true, rate);
-		if (ret == WL1271_NOTHING_TO_SCAN) {
-			if (wl->enable_11a)
-				wl->scan.state = WL1271_SCAN_STATE_5GHZ_ACTIVE;
-			else
-				wl->scan.state = WL1271_SCAN_STATE_DONE;
-			wl1271_scan_stm(wl, vif);
-		}
-
-		break;
-
-	case WL1271_SCAN_STATE_5GHZ_ACTIVE:
-		band = IEEE80211_BAND_5GHZ;
-		rate = wl1271_tx_min_rate_get(wl, wlvif->bitrate_masks[band]);
-		ret = wl1271_scan_send(wl, vif, band, false, rate);
-		if (ret == WL1271_NOTHING_TO_SCAN) {
-			wl->scan.state = WL1271_SCAN_STATE_5GHZ_PASSIVE;
-			wl1271_scan_stm(wl, vif);
-		}
-
-		break;
-
-	case WL1271_SCAN_STATE_5GHZ_PASSIVE:
-		band = IEEE80211_BAND_5GHZ;
-		rate = wl1271_tx_min_rate_get(wl, wlvif->bitrate_masks[band]);
-		ret = wl1271_scan_send(wl, vif, band, true, rate);
-		if (ret == WL1271_NOTHING_TO_SCAN) {
-			wl->scan.state = WL1271_SCAN_STATE_DONE;
-			wl1271_scan_stm(wl, vif);
-		}
-
+		ret = wl1271_scan_send(wl, vif, step, rate);
 		break;
 
 	case WL1271_SCAN_STATE_DONE:
@@ -388,8 +461,12 @@ int wl1271_scan(struct wl1271 *wl, struct ieee80211_vif *vif,
 	if (wl->scan.state != WL1271_SCAN_STATE_IDLE)
 		return -EBUSY;
 
+	/* the first state is refined by the planned steps */
 	wl->scan.state = WL1271_SCAN_STATE_2GHZ_ACTIVE;
 
+	/* a completion still waiting for the event work was the last scan's */
+	wl->event_work_vector &= ~SCAN_COMPLETE_EVENT_ID;
+
 	if (ssid_len && ssid) {
 		wl->scan.ssid_len = ssid_len;
 		memcpy(wl->scan.ssid, ssid, ssid_len);
@@ -399,7 +476,11 @@ int wl1271_scan(struct wl1271 *wl, struct ieee80211_vif *vif,
 
 	wl->scan_vif = vif;
 	wl->scan.req = req;
-	memset(wl->scan.scanned_ch, 0, sizeof(wl->scan.scanned_ch));
+	wl1271_scan_plan(wl, wl12xx_vif_to_data(vif), req);
+
+	wl->scan.start = ktime_get();
+	wl->scan.ttfc_pending = true;
+	wl->stats.scans++;
 
 	/* we assume failure so that timeout scenarios are handled correctly */
 	wl->scan.failed = true;
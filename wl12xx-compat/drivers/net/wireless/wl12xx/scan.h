@@ -25,6 +25,7 @@
 #define __SCAN_H__
 
 #include "wl12xx.h"
+#include "cmd.h"
 
 int wl1271_scan(struct wl1271 *wl, struct ieee80211_vif *vif,
 		const u8 *ssid, size_t ssid_len,
@@ -42,6 +43,8 @@ int wl1271_scan_sched_scan_config(struct wl1271 *wl,
 int wl1271_scan_sched_scan_start(struct wl1271 *wl, struct wl12xx_vif *wlvif);
 void wl1271_scan_sched_scan_stop(struct wl1271 *wl,  struct wl12xx_vif *wlvif);
 void wl1271_scan_sched_scan_results(struct wl1271 *wl);
+void wl1271_scan_candidate(struct wl1271 *wl, enum ieee80211_band band,
+			   u8 channel, const u8 *bssid);
 
 #define WL1271_SCAN_MAX_CHANNELS       24
 #define WL1271_SCAN_DEFAULT_TAG        1
@@ -122,6 +125,44 @@ struct wl1271_cmd_trigger_scan_to {
 	__le32 timeout;
 } __packed;
 
+/* what the APP probe request template of a band was built from */
+struct wl1271_scan_probe_templ {
+	u8 role_id;
+	u8 addr[ETH_ALEN];
+	u32 rate;
+	u8 ssid[IEEE80211_MAX_SSID_LEN];
+	size_t ssid_len;
+	u8 ie[WL1271_CMD_TEMPL_MAX_SIZE];
+	size_t ie_len;
+};
+
+/* 2.4GHz active, 2.4GHz passive, 5GHz active, 5GHz passive */
+#define WL1271_SCAN_PASSES 4
+#define WL1271_SCAN_MAX_STEPS (DIV_ROUND_UP(WL1271_MAX_CHANNELS, \
+					    WL1271_SCAN_MAX_CHANNELS) + \
+			       WL1271_SCAN_PASSES)
+
+/* one CMD_SCAN: a slice of buf->channels with a single band and mode */
+struct wl1271_scan_step {
+	u8 band;
+	u8 passive;
+	u8 first;
+	u8 n_ch;
+};
+
+#define WL1271_SCAN_HIST_CHANNELS 256
+
+/* allocated with the device and reused by every scan */
+struct wl1271_scan_buf {
+	struct wl1271_cmd_scan cmd;
+	struct wl1271_cmd_trigger_scan_to trigger;
+	struct basic_scan_channel_params channels[WL1271_MAX_CHANNELS];
+	struct wl1271_scan_step steps[WL1271_SCAN_MAX_STEPS];
+	struct wl1271_scan_probe_templ probe_templ[IEEE80211_NUM_BANDS];
+	/* recent candidates per channel number, see wl1271_scan_candidate */
+	u8 hist[IEEE80211_NUM_BANDS][WL1271_SCAN_HIST_CHANNELS];
+};
+
 #define MAX_CHANNELS_2GHZ	14
 #define MAX_CHANNELS_5GHZ	23
 #define MAX_CHANNELS_4GHZ	4
@@ -28,7 +28,10 @@
 #include <linux/mmc/sdio_func.h>
 #include <linux/mmc/sdio_ids.h>
 #include <linux/mmc/card.h>
+#include <linux/mmc/core.h>
 #include <linux/mmc/host.h>
+#include <linux/mmc/sdio.h>
+#include <linux/scatterlist.h>
 #include <linux/gpio.h>
 #include <linux/wl12xx.h>
 #include <linux/pm_runtime.h>
@@ -54,6 +57,9 @@ struct wl12xx_sdio_glue {
 
 static struct wl1271_if_operations sdio_ops;
 
+/* the host controller gathers blocks spanning several sg entries */
+static bool tx_sg_unaligned_param;
+
 static const struct sdio_device_id wl1271_devices[] = {
 	{ SDIO_DEVICE(SDIO_VENDOR_ID_TI, SDIO_DEVICE_ID_TI_WL1271) },
 	{}
@@ -145,6 +151,101 @@ static int __must_check wl12xx_sdio_raw_write(struct device *child, int addr,
 	return ret;
 }
 
+/*
+ * Write a scatter-gather list with a single CMD53 in block mode. The SDIO
+ * function API only takes linear buffers, so the request is built here.
+ */
+static int __must_check wl12xx_sdio_raw_write_sg(struct device *child,
+						 int addr,
+						 struct scatterlist *sgl,
+						 unsigned int nents,
+						 size_t len, bool fixed)
+{
+	struct wl12xx_sdio_glue *glue = dev_get_drvdata(child->parent);
+	struct sdio_func *func = dev_to_sdio_func(glue->dev);
+	struct mmc_card *card = func->card;
+	struct mmc_host *host = card->host;
+	struct mmc_request mrq;
+	struct mmc_command cmd;
+	struct mmc_data data;
+	struct scatterlist *sg;
+	unsigned int blksz = func->cur_blksize;
+	unsigned int blocks, i;
+	int ret;
+
+	if (unlikely(glue->suspended)) {
+		dev_err(child->parent, "prevent sdio write while suspended\n");
+		dump_stack();
+		return -1;
+	}
+
+	/* only whole blocks can be sent in a single block mode transfer */
+	if (!card->cccr.multi_block || !blksz || len % blksz)
+		return -EOPNOTSUPP;
+
+	blocks = len / blksz;
+	if (blocks > host->max_blk_count || blocks > 511 ||
+	    len > host->max_req_size || nents > host->max_segs)
+		return -EOPNOTSUPP;
+
+	/*
+	 * Not every host controller can gather a block from several sg
+	 * entries or DMA from an unaligned one. Unless told otherwise let the
+	 * caller copy into its bounce buffer, rather than failing the
+	 * transfer and triggering a recovery.
+	 */
+	for_each_sg(sgl, sg, nents, i) {
+		if (sg->offset & 3 ||
+		    (!tx_sg_unaligned_param && sg->length % blksz))
+			return -EOPNOTSUPP;
+	}
+
+	memset(&mrq, 0, sizeof(mrq));
+	memset(&cmd, 0, sizeof(cmd));
+	memset(&data, 0, sizeof(data));
+
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+
+	cmd.opcode = SD_IO_RW_EXTENDED;
+	cmd.arg = 0x80000000;			/* write */
+	cmd.arg |= func->num << 28;
+	cmd.arg |= fixed ? 0 : 0x04000000;	/* incrementing address */
+	cmd.arg |= (addr & 0x1ffff) << 9;
+	cmd.arg |= 0x08000000 | blocks;		/* block mode */
+	cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
+
+	data.blksz = blksz;
+	data.blocks = blocks;
+	data.flags = MMC_DATA_WRITE;
+	data.sg = sgl;
+	data.sg_len = nents;
+
+	dev_dbg(child->parent, "sdio write 53 sg addr 0x%x, %zu bytes, %u "
+		"entries\n", addr, len, nents);
+
+	sdio_claim_host(func);
+	mmc_set_data_timeout(&data, card);
+	mmc_wait_for_req(host, &mrq);
+	sdio_release_host(func);
+
+	if (cmd.error)
+		ret = cmd.error;
+	else if (data.error)
+		ret = data.error;
+	else if (!mmc_host_is_spi(host) &&
+		 (cmd.resp[0] & (R5_ERROR | R5_FUNCTION_NUMBER |
+				 R5_OUT_OF_RANGE)))
+		ret = -EIO;
+	else
+		ret = 0;
+
+	if (WARN_ON(ret))
+		dev_err(child->parent, "sdio sg write failed (%d)\n", ret);
+
+	return ret;
+}
+
 static int wl12xx_sdio_power_on(struct wl12xx_sdio_glue *glue)
 {
 	int ret;
@@ -229,6 +330,7 @@ static int wl12xx_sdio_set_power(struct device *child, bool enable)
 static struct wl1271_if_operations sdio_ops = {
 	.read		= wl12xx_sdio_raw_read,
 	.write		= wl12xx_sdio_raw_write,
+	.write_sg	= wl12xx_sdio_raw_write_sg,
 	.power		= wl12xx_sdio_set_power,
 	.set_block_size = wl1271_sdio_set_block_size,
 };
@@ -429,6 +531,11 @@ static void __exit wl1271_exit(void)
 module_init(wl1271_init);
 module_exit(wl1271_exit);
 
+module_param_named(tx_sg_unaligned, tx_sg_unaligned_param, bool, S_IRUSR);
+MODULE_PARM_DESC(tx_sg_unaligned,
+		 "Zero-copy TX with sg entries that are not whole SDIO blocks, "
+		 "only for host controllers that support it");
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Luciano Coelho <coelho@ti.com>");
 MODULE_AUTHOR("Juuso Oikarinen <juuso.oikarinen@nokia.com>");
@@ -0,0 +1,1884 @@
+/*
+ * This file is part of wl12xx
+ *
+ * Copyright (C) 2012 Texas Instruments Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Software model of a wl12xx chip behind the bus interface.
+ *
+ * The model answers the bus accesses of the core like the chip and its
+ * firmware would: partitions, ELP, the boot handshake, the command and
+ * event mailboxes, the FW status with its RX descriptors and the TX result
+ * queue. Commands complete after cmd_latency_us, TX frames take their
+ * airtime, every bus transaction costs bus_latency_us plus its length at
+ * bus_bandwidth. Nothing is random, the same load gives the same timeline.
+ *
+ * A fake open AP (ap_ssid on ap_channel) shows up in scans and accepts
+ * authentication and association, so the whole stack can run on top of it.
+ * The load generator injects rx_pps UDP frames of rx_len bytes from the AP,
+ * TX load comes from the network stack. The counters are in
+ * <debugfs>/wl12xx_sim/stats, writing to <debugfs>/wl12xx_sim/watchdog
+ * fires a FW watchdog interrupt.
+ *
+ * The firmware and NVS files are still requested by the core: any well
+ * formed image will do (the upload is discarded), the NVS must have the
+ * size the core expects.
+ */
+
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/hrtimer.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+#include <linux/etherdevice.h>
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <linux/math64.h>
+#include <linux/wl12xx.h>
+#include <net/checksum.h>
+#include <asm/unaligned.h>
+
+#include "wl12xx.h"
+#include "io.h"
+#include "reg.h"
+#include "acx.h"
+#include "cmd.h"
+#include "event.h"
+#include "boot.h"
+#include "rx.h"
+#include "tx.h"
+#include "scan.h"
+
+/* where the model keeps its structures in the chip memory */
+#define SIM_MEM_START		0x00040000
+#define SIM_MEM_SIZE		0x00015000
+#define SIM_CMD_BOX		CMD_MBOX_ADDRESS
+#define SIM_CMD_BOX_SIZE	0x800
+#define SIM_EVENT_BOX		0x00041000
+#define SIM_TX_RESULT		0x00041100
+#define SIM_PKT_POOL		0x00042000
+
+#define SIM_REGS_SIZE		0xa000
+#define SIM_DRPW_SIZE		0x6000
+
+#define SIM_OCP_CMD_WRITE	0x1
+#define SIM_OCP_CMD_READ	0x2
+#define SIM_OCP_READY		BIT(18)
+#define SIM_OCP_STATUS_OK	0x10000
+#define SIM_TOP_REGS		16
+
+/* PG 3.1 on wl127x and PG 2.1 on wl128x, both have the MAC in the fuse */
+#define SIM_DIE_INFO_127X	(0x7 << PG_VER_OFFSET)
+#define SIM_DIE_INFO_128X	(0x9 << PG_VER_OFFSET)
+
+/* 08:00:28:12:71:01 once the core picked the first address after the BD */
+#define SIM_FUSE_BD_ADDR_1	0x28127100
+#define SIM_FUSE_BD_ADDR_2	0x00000800
+
+#define SIM_FW_VERSION_127X	"Rev 6.3.10.0.133"
+#define SIM_FW_VERSION_128X	"Rev 7.3.10.0.133"
+
+#define SIM_RX_SLOTS		NUM_RX_PKT_DESC
+#define SIM_RX_SLOT_SIZE	2048
+#define SIM_RX_MAX_UDP_LEN	1472
+#define SIM_RX_MIN_PERIOD_NS	(100 * NSEC_PER_USEC)
+#define SIM_RX_IDLE_PERIOD_NS	(100 * NSEC_PER_MSEC)
+#define SIM_RX_RSSI		-40
+#define SIM_RX_SNR		60
+
+#define SIM_TX_QUEUE_LEN	64
+
+#define SIM_BEACON_INT		100
+
+enum wl12xx_sim_reply {
+	SIM_REPLY_NONE,
+	SIM_REPLY_AUTH,
+	SIM_REPLY_ASSOC,
+	SIM_REPLY_REASSOC,
+	SIM_REPLY_PROBE,
+};
+
+/* a frame waiting for its airtime */
+struct wl12xx_sim_tx {
+	u8 id;
+	u8 ac;
+	u8 blocks;
+	u8 reply;
+	u16 len;
+	u8 sa[ETH_ALEN];
+};
+
+struct wl12xx_sim_stats {
+	u64 bus_reads;
+	u64 bus_writes;
+	u64 bus_read_bytes;
+	u64 bus_write_bytes;
+	u64 bus_delay_us;
+	u64 fw_bytes;
+	u32 off_accesses;
+	u32 asleep_accesses;
+	u32 elp_wakeups;
+	u32 irqs;
+	u32 status_reads;
+	u32 empty_status_reads;
+	u32 cmds;
+	u32 events;
+	u32 scans;
+	u64 rx_frames;
+	u64 rx_bytes;
+	u32 rx_overruns;
+	u32 rx_underruns;
+	u32 rx_bad_blocks;
+	u64 tx_frames;
+	u64 tx_bytes;
+	u32 tx_malformed;
+	u32 tx_result_stalls;
+	u32 watchdogs;
+};
+
+struct wl12xx_sim {
+	struct platform_device *pdev;
+	struct platform_device *core;
+	struct wl12xx_platform_data pdata;
+	struct dentry *rootdir;
+	int irq;
+
+	/* protects everything below, taken from the bus ops and the timers */
+	spinlock_t lock;
+
+	bool powered;
+	bool running;
+	bool asleep;
+	bool waking;
+	bool irq_masked;
+	ktime_t boot_time;
+
+	u32 part[7];
+	u32 *regs;
+	u8 *mem;
+	u8 *sg_buf;
+	u32 intr;
+	u32 intr_mask;
+	u32 ocp_data;
+	u32 drpw_scratch;
+	struct {
+		u16 addr;
+		u16 val;
+	} top[SIM_TOP_REGS];
+	int num_top;
+
+	/* commands and events */
+	u32 cmd_events;
+	u32 events_queued;
+	bool event_busy;
+	u8 event_mbox;
+	u8 role_type[WL12XX_MAX_ROLES];
+
+	/* scan in progress */
+	bool scan_pending;
+	bool scanning;
+	bool scan_passive;
+	bool scan_match;
+	u8 scan_band;
+	u8 scan_tag;
+	u8 scan_n;
+	u8 scan_idx;
+	u8 scan_results;
+	u8 scan_ch[WL1271_SCAN_MAX_CHANNELS];
+	u32 scan_dwell_us[WL1271_SCAN_MAX_CHANNELS];
+
+	/* RX ring, one slot per FW RX descriptor */
+	u8 *rx_buf;
+	u32 rx_size[SIM_RX_SLOTS];
+	u32 rx_wr;
+	u32 rx_rd;
+	u32 rx_carry_ns;
+
+	/* TX frames in the air and the result queue */
+	struct wl12xx_sim_tx tx_queue[SIM_TX_QUEUE_LEN];
+	u32 tx_head;
+	u32 tx_count;
+	bool tx_stalled;
+	u32 tx_total;
+	u32 tx_released_blks;
+	u8 tx_released_pkts[NUM_TX_QUEUES];
+
+	/* the fake AP */
+	u8 ap_addr[ETH_ALEN];
+	u8 sta_addr[ETH_ALEN];
+	u8 sta_hlid;
+	bool sta_started;
+	bool associated;
+	u16 ap_seq;
+	u16 ip_id;
+
+	struct hrtimer irq_timer;
+	struct hrtimer wake_timer;
+	struct hrtimer cmd_timer;
+	struct hrtimer scan_timer;
+	struct hrtimer tx_timer;
+	struct hrtimer rx_timer;
+
+	struct wl12xx_sim_stats stats;
+};
+
+static unsigned int chip_id_param = CHIP_ID_1271_PG20;
+static unsigned int bus_latency_us = 30;
+static unsigned int bus_bandwidth = 12500;
+static unsigned int cmd_latency_us = 100;
+static unsigned int elp_wake_us = 500;
+static unsigned int air_rate = 54;
+static unsigned int air_overhead_us = 60;
+static unsigned int tx_mem_blocks = 100;
+static unsigned int rx_pps;
+static unsigned int rx_len = 1024;
+static unsigned int ap_channel = 6;
+static char *ap_ssid = "wl12xx-sim";
+
+static struct wl12xx_sim *wl12xx_sim;
+
+static const u8 wl12xx_sim_tid_to_ac[8] = {
+	CONF_TX_AC_BE, CONF_TX_AC_BK, CONF_TX_AC_BK, CONF_TX_AC_BE,
+	CONF_TX_AC_VI, CONF_TX_AC_VI, CONF_TX_AC_VO, CONF_TX_AC_VO,
+};
+
+static const u8 wl12xx_sim_rates[] = {
+	0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24,
+};
+
+static const u8 wl12xx_sim_ext_rates[] = {
+	0x30, 0x48, 0x60, 0x6c,
+};
+
+static const u8 wl12xx_sim_rfc1042[] = {
+	0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x08, 0x00,
+};
+
+static void *wl12xx_sim_mem(struct wl12xx_sim *sim, u32 addr)
+{
+	return sim->mem + addr - SIM_MEM_START;
+}
+
+static u32 wl12xx_sim_fw_time(struct wl12xx_sim *sim)
+{
+	return ktime_to_us(ktime_sub(ktime_get(), sim->boot_time));
+}
+
+static void wl12xx_sim_update_irq(struct wl12xx_sim *sim)
+{
+	if (!(sim->intr & ~sim->intr_mask))
+		return;
+
+	/* the chip is up while it signals */
+	sim->asleep = false;
+	hrtimer_start(&sim->irq_timer, ktime_set(0, 0), HRTIMER_MODE_REL);
+}
+
+static void wl12xx_sim_raise(struct wl12xx_sim *sim, u32 intr)
+{
+	sim->intr |= intr;
+	wl12xx_sim_update_irq(sim);
+}
+
+static enum hrtimer_restart wl12xx_sim_irq_fire(struct hrtimer *timer)
+{
+	struct wl12xx_sim *sim = container_of(timer, struct wl12xx_sim,
+					      irq_timer);
+	unsigned long flags;
+	bool fire;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	fire = sim->powered && !sim->irq_masked &&
+	       (sim->intr & ~sim->intr_mask);
+	if (fire)
+		sim->stats.irqs++;
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	if (fire) {
+		local_irq_save(flags);
+		generic_handle_irq(sim->irq);
+		local_irq_restore(flags);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+/* level triggered line, a pending cause fires again once unmasked */
+static void wl12xx_sim_irq_mask(struct irq_data *d)
+{
+	struct wl12xx_sim *sim = irq_data_get_irq_chip_data(d);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	sim->irq_masked = true;
+	spin_unlock_irqrestore(&sim->lock, flags);
+}
+
+static void wl12xx_sim_irq_unmask(struct irq_data *d)
+{
+	struct wl12xx_sim *sim = irq_data_get_irq_chip_data(d);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	sim->irq_masked = false;
+	if (sim->powered)
+		wl12xx_sim_update_irq(sim);
+	spin_unlock_irqrestore(&sim->lock, flags);
+}
+
+static struct irq_chip wl12xx_sim_irq_chip = {
+	.name		= "wl12xx_sim",
+	.irq_mask	= wl12xx_sim_irq_mask,
+	.irq_unmask	= wl12xx_sim_irq_unmask,
+};
+
+static enum hrtimer_restart wl12xx_sim_wake_done(struct hrtimer *timer)
+{
+	struct wl12xx_sim *sim = container_of(timer, struct wl12xx_sim,
+					      wake_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	if (sim->powered && sim->waking) {
+		sim->waking = false;
+		sim->asleep = false;
+		wl12xx_sim_raise(sim, WL1271_ACX_INTR_HW_AVAILABLE);
+	}
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+static void wl12xx_sim_elp(struct wl12xx_sim *sim, u8 *buf, size_t len,
+			   bool write)
+{
+	if (!write) {
+		memset(buf, 0, len);
+		buf[0] = sim->asleep ? 0 : ELPCTRL_WLAN_READY;
+		return;
+	}
+
+	if (!(buf[0] & ELPCTRL_WAKE_UP)) {
+		/* only the running FW puts the chip to sleep */
+		if (sim->running)
+			sim->asleep = true;
+		return;
+	}
+
+	if (sim->asleep && !sim->waking) {
+		sim->waking = true;
+		sim->stats.elp_wakeups++;
+		hrtimer_start(&sim->wake_timer, ns_to_ktime(elp_wake_us *
+							    NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+}
+
+static u16 wl12xx_sim_top_read(struct wl12xx_sim *sim, u16 addr)
+{
+	int i;
+
+	for (i = 0; i < sim->num_top; i++)
+		if (sim->top[i].addr == addr)
+			return sim->top[i].val;
+
+	if (addr == WL127X_REG_FUSE_DATA_2_1 && chip_id_param != CHIP_ID_1283_PG20)
+		return SIM_DIE_INFO_127X;
+	if (addr == WL128X_REG_FUSE_DATA_2_1 && chip_id_param == CHIP_ID_1283_PG20)
+		return SIM_DIE_INFO_128X;
+
+	/* clock detection, pads and PLL are happy with the reset values */
+	return 0;
+}
+
+static void wl12xx_sim_top_write(struct wl12xx_sim *sim, u16 addr, u16 val)
+{
+	int i;
+
+	for (i = 0; i < sim->num_top; i++)
+		if (sim->top[i].addr == addr)
+			break;
+
+	if (i == SIM_TOP_REGS)
+		return;
+
+	if (i == sim->num_top)
+		sim->num_top++;
+
+	sim->top[i].addr = addr;
+	sim->top[i].val = val;
+}
+
+static void wl12xx_sim_ocp(struct wl12xx_sim *sim, u32 cmd)
+{
+	u32 por = sim->regs[(OCP_POR_CTR - REGISTERS_BASE) / 4];
+	u16 addr = (por - 0x30000) << 1;
+
+	if (cmd == SIM_OCP_CMD_WRITE)
+		wl12xx_sim_top_write(sim, addr,
+			sim->regs[(OCP_DATA_WRITE - REGISTERS_BASE) / 4]);
+	else if (cmd == SIM_OCP_CMD_READ)
+		sim->ocp_data = SIM_OCP_READY | SIM_OCP_STATUS_OK |
+				wl12xx_sim_top_read(sim, addr);
+}
+
+static void wl12xx_sim_fw_stop(struct wl12xx_sim *sim)
+{
+	sim->running = false;
+	sim->asleep = false;
+	sim->waking = false;
+	sim->intr = 0;
+	sim->cmd_events = 0;
+	sim->events_queued = 0;
+	sim->event_busy = false;
+	sim->event_mbox = 0;
+	sim->scan_pending = false;
+	sim->scanning = false;
+	sim->rx_wr = 0;
+	sim->rx_rd = 0;
+	sim->rx_carry_ns = 0;
+	sim->tx_head = 0;
+	sim->tx_count = 0;
+	sim->tx_stalled = false;
+	sim->tx_released_blks = 0;
+	memset(sim->tx_released_pkts, 0, sizeof(sim->tx_released_pkts));
+	memset(sim->role_type, 0xff, sizeof(sim->role_type));
+	sim->sta_started = false;
+	sim->associated = false;
+
+	/* the callbacks check sim->running, they can't be waited for here */
+	hrtimer_try_to_cancel(&sim->wake_timer);
+	hrtimer_try_to_cancel(&sim->cmd_timer);
+	hrtimer_try_to_cancel(&sim->scan_timer);
+	hrtimer_try_to_cancel(&sim->tx_timer);
+	hrtimer_try_to_cancel(&sim->rx_timer);
+}
+
+static void wl12xx_sim_fw_boot(struct wl12xx_sim *sim)
+{
+	struct wl1271_static_data *static_data;
+	const char *version = chip_id_param == CHIP_ID_1283_PG20 ?
+			      SIM_FW_VERSION_128X : SIM_FW_VERSION_127X;
+
+	sim->running = true;
+	sim->boot_time = ktime_get();
+	sim->tx_total = tx_mem_blocks;
+
+	sim->regs[(REG_COMMAND_MAILBOX_PTR - REGISTERS_BASE) / 4] = SIM_CMD_BOX;
+	sim->regs[(REG_EVENT_MAILBOX_PTR - REGISTERS_BASE) / 4] = SIM_EVENT_BOX;
+
+	static_data = wl12xx_sim_mem(sim, SIM_CMD_BOX);
+	memset(static_data, 0, sizeof(*static_data));
+	strlcpy(static_data->fw_version, version,
+		sizeof(static_data->fw_version));
+
+	memset(wl12xx_sim_mem(sim, SIM_EVENT_BOX), 0,
+	       2 * sizeof(struct event_mailbox));
+	memset(wl12xx_sim_mem(sim, SIM_TX_RESULT), 0,
+	       sizeof(struct wl1271_tx_hw_res_if));
+
+	/* the core polls for this one with the interrupts masked */
+	sim->intr |= WL1271_ACX_INTR_INIT_COMPLETE;
+
+	hrtimer_start(&sim->rx_timer, ns_to_ktime(SIM_RX_IDLE_PERIOD_NS),
+		      HRTIMER_MODE_REL);
+}
+
+/*
+ * Events go out one mailbox at a time, alternating between A and B. What
+ * comes up while the host has not acked the last one waits for the ack.
+ */
+static void wl12xx_sim_deliver_events(struct wl12xx_sim *sim)
+{
+	struct event_mailbox *mbox;
+
+	if (sim->event_busy || !sim->events_queued)
+		return;
+
+	mbox = wl12xx_sim_mem(sim, SIM_EVENT_BOX +
+			      sim->event_mbox * sizeof(*mbox));
+	memset(mbox, 0, sizeof(*mbox));
+	mbox->events_vector = cpu_to_le32(sim->events_queued);
+	mbox->scan_tag = sim->scan_tag;
+	mbox->number_of_scan_results = sim->scan_results;
+
+	sim->events_queued = 0;
+	sim->event_busy = true;
+	sim->stats.events++;
+
+	wl12xx_sim_raise(sim, sim->event_mbox ? WL1271_ACX_INTR_EVENT_B :
+						WL1271_ACX_INTR_EVENT_A);
+}
+
+static void wl12xx_sim_post_event(struct wl12xx_sim *sim, u32 vector)
+{
+	sim->events_queued |= vector;
+	wl12xx_sim_deliver_events(sim);
+}
+
+static void wl12xx_sim_event_ack(struct wl12xx_sim *sim)
+{
+	struct event_mailbox *mbox;
+
+	if (!sim->event_busy)
+		return;
+
+	mbox = wl12xx_sim_mem(sim, SIM_EVENT_BOX +
+			      sim->event_mbox * sizeof(*mbox));
+	mbox->events_vector = 0;
+
+	sim->event_busy = false;
+	sim->event_mbox ^= 1;
+	wl12xx_sim_deliver_events(sim);
+}
+
+/* room for the next RX frame, NULL when the FW RX queue is full */
+static void *wl12xx_sim_rx_alloc(struct wl12xx_sim *sim)
+{
+	u32 slot = sim->rx_wr % SIM_RX_SLOTS;
+
+	/* a full ring would look empty to the host */
+	if (sim->rx_wr - sim->rx_rd >= SIM_RX_SLOTS - 1) {
+		sim->stats.rx_overruns++;
+		return NULL;
+	}
+
+	return sim->rx_buf + slot * SIM_RX_SLOT_SIZE +
+	       sizeof(struct wl1271_rx_descriptor);
+}
+
+static void wl12xx_sim_rx_commit(struct wl12xx_sim *sim, u32 len, u8 channel,
+				 u8 rate, u8 class)
+{
+	u32 slot = sim->rx_wr % SIM_RX_SLOTS;
+	struct wl1271_rx_descriptor *desc;
+	u32 total = sizeof(*desc) + len;
+
+	desc = (struct wl1271_rx_descriptor *)(sim->rx_buf +
+					       slot * SIM_RX_SLOT_SIZE);
+	memset(desc, 0, sizeof(*desc));
+	desc->length = cpu_to_le16(len);
+	desc->status = WL1271_RX_DESC_SUCCESS;
+	desc->flags = WL1271_RX_DESC_BAND_BG;
+	desc->rate = rate;
+	desc->channel = channel;
+	desc->rssi = SIM_RX_RSSI;
+	desc->snr = SIM_RX_SNR;
+	desc->timestamp = cpu_to_le32(wl12xx_sim_fw_time(sim));
+	desc->packet_class = class;
+	desc->hlid = sim->sta_started ? sim->sta_hlid : 0;
+	desc->pad_len = ALIGN(total, 4) - total;
+	memset((u8 *)desc + total, 0, desc->pad_len);
+
+	sim->rx_size[slot] = ALIGN(total, 4);
+	sim->rx_wr++;
+
+	sim->stats.rx_frames++;
+	sim->stats.rx_bytes += len;
+
+	wl12xx_sim_raise(sim, WL1271_ACX_INTR_DATA);
+}
+
+/* RX burst read, the host takes whole frames from the head of the ring */
+static void wl12xx_sim_rx_read(struct wl12xx_sim *sim, u8 *buf, size_t len)
+{
+	u32 slot, size;
+
+	while (len && sim->rx_rd != sim->rx_wr) {
+		slot = sim->rx_rd % SIM_RX_SLOTS;
+		size = sim->rx_size[slot];
+		if (size > len)
+			break;
+
+		memcpy(buf, sim->rx_buf + slot * SIM_RX_SLOT_SIZE, size);
+		buf += size;
+		len -= size;
+		sim->rx_rd++;
+	}
+
+	if (len) {
+		memset(buf, 0, len);
+		sim->stats.rx_underruns++;
+	}
+}
+
+/* wl127x selects the first memory block of an RX burst */
+static void wl12xx_sim_rx_select(struct wl12xx_sim *sim, u32 addr)
+{
+	if (addr - SIM_PKT_POOL != (sim->rx_rd % SIM_RX_SLOTS) << 8)
+		sim->stats.rx_bad_blocks++;
+}
+
+static u8 *wl12xx_sim_add_rates(u8 *pos)
+{
+	*pos++ = WLAN_EID_SUPP_RATES;
+	*pos++ = sizeof(wl12xx_sim_rates);
+	memcpy(pos, wl12xx_sim_rates, sizeof(wl12xx_sim_rates));
+	pos += sizeof(wl12xx_sim_rates);
+
+	*pos++ = WLAN_EID_EXT_SUPP_RATES;
+	*pos++ = sizeof(wl12xx_sim_ext_rates);
+	memcpy(pos, wl12xx_sim_ext_rates, sizeof(wl12xx_sim_ext_rates));
+	pos += sizeof(wl12xx_sim_ext_rates);
+
+	return pos;
+}
+
+static struct ieee80211_mgmt *wl12xx_sim_mgmt(struct wl12xx_sim *sim,
+					      u16 stype, const u8 *da)
+{
+	struct ieee80211_mgmt *mgmt = wl12xx_sim_rx_alloc(sim);
+
+	if (!mgmt)
+		return NULL;
+
+	memset(mgmt, 0, offsetof(struct ieee80211_mgmt, u));
+	mgmt->frame_control = cpu_to_le16(IEEE80211_FTYPE_MGMT | stype);
+	memcpy(mgmt->da, da, ETH_ALEN);
+	memcpy(mgmt->sa, sim->ap_addr, ETH_ALEN);
+	memcpy(mgmt->bssid, sim->ap_addr, ETH_ALEN);
+	mgmt->seq_ctrl = cpu_to_le16(sim->ap_seq++ << 4);
+
+	return mgmt;
+}
+
+/* beacon or probe response of the fake AP */
+static void wl12xx_sim_rx_bss(struct wl12xx_sim *sim, u16 stype, const u8 *da)
+{
+	struct ieee80211_mgmt *mgmt;
+	size_t ssid_len = min_t(size_t, strlen(ap_ssid),
+				IEEE80211_MAX_SSID_LEN);
+	u8 *pos;
+
+	mgmt = wl12xx_sim_mgmt(sim, stype, da);
+	if (!mgmt)
+		return;
+
+	/* beacon and probe response have the same layout */
+	mgmt->u.beacon.timestamp = cpu_to_le64(wl12xx_sim_fw_time(sim));
+	mgmt->u.beacon.beacon_int = cpu_to_le16(SIM_BEACON_INT);
+	mgmt->u.beacon.capab_info = cpu_to_le16(WLAN_CAPABILITY_ESS |
+					WLAN_CAPABILITY_SHORT_SLOT_TIME);
+
+	pos = mgmt->u.beacon.variable;
+	*pos++ = WLAN_EID_SSID;
+	*pos++ = ssid_len;
+	memcpy(pos, ap_ssid, ssid_len);
+	pos += ssid_len;
+
+	pos = wl12xx_sim_add_rates(pos);
+
+	*pos++ = WLAN_EID_DS_PARAMS;
+	*pos++ = 1;
+	*pos++ = ap_channel;
+
+	wl12xx_sim_rx_commit(sim, pos - (u8 *)mgmt, ap_channel,
+			     CONF_HW_RXTX_RATE_1, WL12XX_RX_CLASS_BCN_PRBRSP);
+}
+
+static void wl12xx_sim_rx_auth(struct wl12xx_sim *sim, const u8 *da)
+{
+	struct ieee80211_mgmt *mgmt;
+
+	mgmt = wl12xx_sim_mgmt(sim, IEEE80211_STYPE_AUTH, da);
+	if (!mgmt)
+		return;
+
+	mgmt->u.auth.auth_alg = cpu_to_le16(WLAN_AUTH_OPEN);
+	mgmt->u.auth.auth_transaction = cpu_to_le16(2);
+	mgmt->u.auth.status_code = cpu_to_le16(WLAN_STATUS_SUCCESS);
+
+	wl12xx_sim_rx_commit(sim, mgmt->u.auth.variable - (u8 *)mgmt,
+			     ap_channel, CONF_HW_RXTX_RATE_1,
+			     WL12XX_RX_CLASS_MANAGEMENT);
+}
+
+static void wl12xx_sim_rx_assoc(struct wl12xx_sim *sim, u16 stype,
+				const u8 *da)
+{
+	struct ieee80211_mgmt *mgmt;
+	u8 *pos;
+
+	mgmt = wl12xx_sim_mgmt(sim, stype, da);
+	if (!mgmt)
+		return;
+
+	mgmt->u.assoc_resp.capab_info = cpu_to_le16(WLAN_CAPABILITY_ESS |
+					WLAN_CAPABILITY_SHORT_SLOT_TIME);
+	mgmt->u.assoc_resp.status_code = cpu_to_le16(WLAN_STATUS_SUCCESS);
+	mgmt->u.assoc_resp.aid = cpu_to_le16(1 | BIT(14) | BIT(15));
+	pos = wl12xx_sim_add_rates(mgmt->u.assoc_resp.variable);
+
+	wl12xx_sim_rx_commit(sim, pos - (u8 *)mgmt, ap_channel,
+			     CONF_HW_RXTX_RATE_1, WL12XX_RX_CLASS_MANAGEMENT);
+
+	memcpy(sim->sta_addr, da, ETH_ALEN);
+	sim->associated = true;
+}
+
+/* a UDP datagram from the AP to the discard port, the load generator */
+static void wl12xx_sim_rx_data(struct wl12xx_sim *sim)
+{
+	struct ieee80211_hdr_3addr *hdr;
+	struct iphdr *iph;
+	struct udphdr *udph;
+	u32 len = min_t(u32, rx_len, SIM_RX_MAX_UDP_LEN);
+	u8 *pos;
+
+	hdr = wl12xx_sim_rx_alloc(sim);
+	if (!hdr)
+		return;
+
+	hdr->frame_control = cpu_to_le16(IEEE80211_FTYPE_DATA |
+					 IEEE80211_STYPE_DATA |
+					 IEEE80211_FCTL_FROMDS);
+	hdr->duration_id = 0;
+	if (sim->associated)
+		memcpy(hdr->addr1, sim->sta_addr, ETH_ALEN);
+	else
+		memset(hdr->addr1, 0xff, ETH_ALEN);
+	memcpy(hdr->addr2, sim->ap_addr, ETH_ALEN);
+	memcpy(hdr->addr3, sim->ap_addr, ETH_ALEN);
+	hdr->seq_ctrl = cpu_to_le16(sim->ap_seq++ << 4);
+
+	pos = (u8 *)(hdr + 1);
+	memcpy(pos, wl12xx_sim_rfc1042, sizeof(wl12xx_sim_rfc1042));
+	pos += sizeof(wl12xx_sim_rfc1042);
+
+	iph = (struct iphdr *)pos;
+	iph->version = 4;
+	iph->ihl = 5;
+	iph->tos = 0;
+	iph->tot_len = htons(sizeof(*iph) + sizeof(*udph) + len);
+	iph->id = htons(sim->ip_id++);
+	iph->frag_off = 0;
+	iph->ttl = 64;
+	iph->protocol = IPPROTO_UDP;
+	iph->saddr = htonl(0xc0a84701);
+	iph->daddr = htonl(INADDR_BROADCAST);
+	iph->check = 0;
+	iph->check = ip_fast_csum((u8 *)iph, iph->ihl);
+
+	udph = (struct udphdr *)(iph + 1);
+	udph->source = htons(9);
+	udph->dest = htons(9);
+	udph->len = htons(sizeof(*udph) + len);
+	udph->check = 0;
+	memset(udph + 1, 0, len);
+
+	pos = (u8 *)(udph + 1) + len;
+	wl12xx_sim_rx_commit(sim, pos - (u8 *)hdr, ap_channel,
+			     CONF_HW_RXTX_RATE_54, WL12XX_RX_CLASS_DATA);
+}
+
+static enum hrtimer_restart wl12xx_sim_rx_gen(struct hrtimer *timer)
+{
+	struct wl12xx_sim *sim = container_of(timer, struct wl12xx_sim,
+					      rx_timer);
+	unsigned long flags;
+	u32 pps = ACCESS_ONCE(rx_pps);
+	u64 period = SIM_RX_IDLE_PERIOD_NS;
+	u32 i, batch = 1;
+
+	if (pps) {
+		period = div_u64(NSEC_PER_SEC, pps);
+		if (period < SIM_RX_MIN_PERIOD_NS) {
+			batch = DIV_ROUND_UP(SIM_RX_MIN_PERIOD_NS, (u32)period);
+			period *= batch;
+		}
+	}
+
+	spin_lock_irqsave(&sim->lock, flags);
+	if (!sim->running)
+		goto out;
+
+	for (i = 0; pps && i < batch; i++)
+		wl12xx_sim_rx_data(sim);
+
+	hrtimer_start(&sim->rx_timer, ns_to_ktime(period), HRTIMER_MODE_REL);
+out:
+	spin_unlock_irqrestore(&sim->lock, flags);
+	return HRTIMER_NORESTART;
+}
+
+static u32 wl12xx_sim_airtime_us(struct wl12xx_sim_tx *tx)
+{
+	u32 us = air_overhead_us;
+
+	if (air_rate)
+		us += DIV_ROUND_UP(tx->len * 8, air_rate);
+
+	return us;
+}
+
+static void wl12xx_sim_tx_reply(struct wl12xx_sim *sim,
+				struct wl12xx_sim_tx *tx)
+{
+	switch (tx->reply) {
+	case SIM_REPLY_AUTH:
+		wl12xx_sim_rx_auth(sim, tx->sa);
+		break;
+	case SIM_REPLY_ASSOC:
+		wl12xx_sim_rx_assoc(sim, IEEE80211_STYPE_ASSOC_RESP, tx->sa);
+		break;
+	case SIM_REPLY_REASSOC:
+		wl12xx_sim_rx_assoc(sim, IEEE80211_STYPE_REASSOC_RESP, tx->sa);
+		break;
+	case SIM_REPLY_PROBE:
+		wl12xx_sim_rx_bss(sim, IEEE80211_STYPE_PROBE_RESP, tx->sa);
+		break;
+	default:
+		break;
+	}
+}
+
+/* the frame at the head of the queue is on the air, post its result */
+static enum hrtimer_restart wl12xx_sim_tx_done(struct hrtimer *timer)
+{
+	struct wl12xx_sim *sim = container_of(timer, struct wl12xx_sim,
+					      tx_timer);
+	struct wl1271_tx_hw_res_if *res = wl12xx_sim_mem(sim, SIM_TX_RESULT);
+	struct wl1271_tx_hw_res_descr *result;
+	struct wl12xx_sim_tx *tx;
+	unsigned long flags;
+	u32 fw_counter, host_counter;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	if (!sim->running || !sim->tx_count)
+		goto out;
+
+	fw_counter = le32_to_cpu(res->tx_result_fw_counter);
+	host_counter = le32_to_cpu(res->tx_result_host_counter);
+
+	/* no room for the result until the host acks the older ones */
+	if (fw_counter - host_counter >= TX_HW_RESULT_QUEUE_LEN) {
+		sim->tx_stalled = true;
+		sim->stats.tx_result_stalls++;
+		goto out;
+	}
+
+	tx = &sim->tx_queue[sim->tx_head];
+
+	result = &res->tx_results_queue[fw_counter &
+					TX_HW_RESULT_QUEUE_LEN_MASK];
+	memset(result, 0, sizeof(*result));
+	result->id = tx->id;
+	result->status = TX_SUCCESS;
+	result->medium_usage = cpu_to_le16(wl12xx_sim_airtime_us(tx));
+	res->tx_result_fw_counter = cpu_to_le32(fw_counter + 1);
+
+	sim->tx_released_blks += tx->blocks;
+	sim->tx_released_pkts[tx->ac]++;
+	sim->stats.tx_frames++;
+	sim->stats.tx_bytes += tx->len;
+
+	wl12xx_sim_tx_reply(sim, tx);
+	wl12xx_sim_raise(sim, WL1271_ACX_INTR_DATA);
+
+	sim->tx_head = (sim->tx_head + 1) % SIM_TX_QUEUE_LEN;
+	sim->tx_count--;
+
+	if (sim->tx_count) {
+		tx = &sim->tx_queue[sim->tx_head];
+		hrtimer_start(&sim->tx_timer,
+			      ns_to_ktime(wl12xx_sim_airtime_us(tx) *
+					  NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+out:
+	spin_unlock_irqrestore(&sim->lock, flags);
+	return HRTIMER_NORESTART;
+}
+
+static void wl12xx_sim_tx_acked(struct wl12xx_sim *sim)
+{
+	if (!sim->tx_stalled)
+		return;
+
+	sim->tx_stalled = false;
+	hrtimer_start(&sim->tx_timer, ktime_set(0, 0), HRTIMER_MODE_REL);
+}
+
+/* what the fake AP answers to a frame from the host */
+static u8 wl12xx_sim_tx_parse(struct wl12xx_sim *sim,
+			      struct ieee80211_mgmt *mgmt, u32 len)
+{
+	__le16 fc = mgmt->frame_control;
+	size_t ssid_len;
+	u8 *ie;
+
+	if (len < IEEE80211_MIN_ACTION_SIZE || !ieee80211_is_mgmt(fc))
+		return SIM_REPLY_NONE;
+
+	if (ieee80211_is_probe_req(fc)) {
+		if (!is_broadcast_ether_addr(mgmt->da) &&
+		    compare_ether_addr(mgmt->da, sim->ap_addr))
+			return SIM_REPLY_NONE;
+
+		/* wildcard or our SSID */
+		ie = mgmt->u.probe_req.variable;
+		ssid_len = strlen(ap_ssid);
+		if (ie + 2 > (u8 *)mgmt + len || ie[0] != WLAN_EID_SSID ||
+		    (ie[1] && (ie[1] != ssid_len ||
+			       ie + 2 + ssid_len > (u8 *)mgmt + len ||
+			       memcmp(ie + 2, ap_ssid, ssid_len))))
+			return SIM_REPLY_NONE;
+
+		return SIM_REPLY_PROBE;
+	}
+
+	if (compare_ether_addr(mgmt->da, sim->ap_addr))
+		return SIM_REPLY_NONE;
+
+	if (ieee80211_is_auth(fc) &&
+	    le16_to_cpu(mgmt->u.auth.auth_alg) == WLAN_AUTH_OPEN &&
+	    le16_to_cpu(mgmt->u.auth.auth_transaction) == 1)
+		return SIM_REPLY_AUTH;
+
+	if (ieee80211_is_assoc_req(fc))
+		return SIM_REPLY_ASSOC;
+
+	if (ieee80211_is_reassoc_req(fc))
+		return SIM_REPLY_REASSOC;
+
+	if (ieee80211_is_deauth(fc) || ieee80211_is_disassoc(fc))
+		sim->associated = false;
+
+	return SIM_REPLY_NONE;
+}
+
+static void wl12xx_sim_tx_frame(struct wl12xx_sim *sim,
+				struct wl1271_tx_hw_descr *desc, u32 len)
+{
+	struct ieee80211_mgmt *mgmt = (struct ieee80211_mgmt *)(desc + 1);
+	struct wl12xx_sim_tx *tx;
+	u32 pad, frame_len;
+
+	if (sim->tx_count == SIM_TX_QUEUE_LEN) {
+		sim->stats.tx_malformed++;
+		return;
+	}
+
+	if (chip_id_param == CHIP_ID_1283_PG20)
+		pad = desc->wl128x_mem.extra_bytes;
+	else
+		pad = (le16_to_cpu(desc->tx_attr) & TX_HW_ATTR_LAST_WORD_PAD) >>
+		      TX_HW_ATTR_OFST_LAST_WORD_PAD;
+
+	frame_len = len - sizeof(*desc);
+	frame_len = frame_len > pad ? frame_len - pad : 0;
+
+	tx = &sim->tx_queue[(sim->tx_head + sim->tx_count) % SIM_TX_QUEUE_LEN];
+	tx->id = desc->id;
+	tx->ac = wl12xx_sim_tid_to_ac[desc->tid & 7];
+	if (chip_id_param == CHIP_ID_1283_PG20)
+		tx->blocks = desc->wl128x_mem.total_mem_blocks;
+	else
+		tx->blocks = desc->wl127x_mem.total_mem_blocks;
+	tx->len = frame_len;
+	tx->reply = wl12xx_sim_tx_parse(sim, mgmt, frame_len);
+	if (tx->reply != SIM_REPLY_NONE)
+		memcpy(tx->sa, mgmt->sa, ETH_ALEN);
+
+	if (!sim->tx_count++ && !sim->tx_stalled)
+		hrtimer_start(&sim->tx_timer,
+			      ns_to_ktime(wl12xx_sim_airtime_us(tx) *
+					  NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+}
+
+/* a TX burst is a sequence of descriptors, each followed by its frame */
+static void wl12xx_sim_tx_burst(struct wl12xx_sim *sim, u8 *buf, size_t len)
+{
+	struct wl1271_tx_hw_descr *desc;
+	size_t off = 0;
+	u32 pkt_len;
+
+	while (off + sizeof(*desc) <= len) {
+		desc = (struct wl1271_tx_hw_descr *)(buf + off);
+		pkt_len = le16_to_cpu(desc->length) * 4;
+
+		/* the rest is block padding */
+		if (!pkt_len)
+			break;
+
+		if (pkt_len < sizeof(*desc) || off + pkt_len > len) {
+			sim->stats.tx_malformed++;
+			break;
+		}
+
+		wl12xx_sim_tx_frame(sim, desc, pkt_len);
+		off += pkt_len;
+	}
+}
+
+static void wl12xx_sim_fw_status(struct wl12xx_sim *sim, u8 *buf, size_t len)
+{
+	struct wl12xx_fw_status status;
+	struct wl1271_tx_hw_res_if *res = wl12xx_sim_mem(sim, SIM_TX_RESULT);
+	u32 i, slot;
+
+	memset(&status, 0, sizeof(status));
+
+	sim->stats.status_reads++;
+	if (!(sim->intr & WL1271_INTR_MASK))
+		sim->stats.empty_status_reads++;
+
+	/* reading the status acks the interrupt causes it reports */
+	status.intr = cpu_to_le32(sim->intr);
+	sim->intr &= ~WL1271_INTR_MASK;
+
+	status.fw_rx_counter = sim->rx_wr;
+	status.drv_rx_counter = sim->rx_rd;
+	status.tx_results_counter = le32_to_cpu(res->tx_result_fw_counter);
+
+	for (i = sim->rx_rd; i != sim->rx_wr; i++) {
+		slot = i % SIM_RX_SLOTS;
+		status.rx_pkt_descs[slot] = cpu_to_le32(slot |
+			(sim->rx_size[slot] << RX_BUF_SIZE_SHIFT_DIV));
+	}
+
+	status.fw_localtime = cpu_to_le32(wl12xx_sim_fw_time(sim));
+	status.total_released_blks = cpu_to_le32(sim->tx_released_blks);
+	status.tx_total = cpu_to_le32(sim->tx_total);
+	memcpy(status.tx_released_pkts, sim->tx_released_pkts,
+	       sizeof(status.tx_released_pkts));
+
+	memset(buf, 0, len);
+	memcpy(buf, &status, min(len, sizeof(status)));
+}
+
+static enum hrtimer_restart wl12xx_sim_scan_step(struct hrtimer *timer)
+{
+	struct wl12xx_sim *sim = container_of(timer, struct wl12xx_sim,
+					      scan_timer);
+	unsigned long flags;
+	u8 ch;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	if (!sim->running || !sim->scanning)
+		goto out;
+
+	/* the AP answers at the end of the dwell on its channel */
+	ch = sim->scan_ch[sim->scan_idx];
+	if (sim->scan_band == WL1271_SCAN_BAND_2_4_GHZ && ch == ap_channel &&
+	    sim->scan_match) {
+		if (sim->scan_passive)
+			wl12xx_sim_rx_bss(sim, IEEE80211_STYPE_BEACON,
+					  (const u8 *)"\xff\xff\xff\xff\xff\xff");
+		else
+			wl12xx_sim_rx_bss(sim, IEEE80211_STYPE_PROBE_RESP,
+					  sim->sta_addr);
+		sim->scan_results++;
+	}
+
+	if (++sim->scan_idx == sim->scan_n) {
+		sim->scanning = false;
+		wl12xx_sim_post_event(sim, SCAN_COMPLETE_EVENT_ID);
+		goto out;
+	}
+
+	hrtimer_start(&sim->scan_timer,
+		      ns_to_ktime(sim->scan_dwell_us[sim->scan_idx] *
+				  NSEC_PER_USEC),
+		      HRTIMER_MODE_REL);
+out:
+	spin_unlock_irqrestore(&sim->lock, flags);
+	return HRTIMER_NORESTART;
+}
+
+static void wl12xx_sim_scan(struct wl12xx_sim *sim, struct wl1271_cmd_scan *cmd)
+{
+	struct basic_scan_channel_params *ch;
+	size_t ssid_len = strlen(ap_ssid);
+	u32 tu;
+	int i;
+
+	sim->scan_n = min_t(u8, cmd->params.n_ch, WL1271_SCAN_MAX_CHANNELS);
+	sim->scan_band = cmd->params.band;
+	sim->scan_tag = cmd->params.scan_tag;
+	sim->scan_passive = le16_to_cpu(cmd->params.scan_options) &
+			    WL1271_SCAN_OPT_PASSIVE;
+	sim->scan_match = sim->scan_passive || !cmd->params.ssid_len ||
+			  (cmd->params.ssid_len == ssid_len &&
+			   !memcmp(cmd->params.ssid, ap_ssid, ssid_len));
+	memcpy(sim->sta_addr, cmd->addr, ETH_ALEN);
+	sim->scan_idx = 0;
+	sim->scan_results = 0;
+
+	/* the FW stays the max dwell on busy channels, the min on the rest */
+	for (i = 0; i < sim->scan_n; i++) {
+		ch = &cmd->channels[i];
+		sim->scan_ch[i] = ch->channel;
+		if (sim->scan_band == WL1271_SCAN_BAND_2_4_GHZ &&
+		    ch->channel == ap_channel)
+			tu = le32_to_cpu(ch->max_duration);
+		else
+			tu = le32_to_cpu(ch->min_duration);
+		sim->scan_dwell_us[i] = tu * 1024;
+	}
+
+	sim->stats.scans++;
+	sim->scan_pending = sim->scan_n > 0;
+	if (!sim->scan_pending)
+		sim->cmd_events |= SCAN_COMPLETE_EVENT_ID;
+}
+
+static void wl12xx_sim_interrogate(struct wl12xx_sim *sim,
+				   struct acx_header *acx)
+{
+	struct wl1271_acx_mem_map *mem_map;
+	u32 len = min_t(u32, le16_to_cpu(acx->len),
+			SIM_CMD_BOX_SIZE - sizeof(*acx));
+
+	/* only the memory map matters, the rest reads as zeroes */
+	memset(acx + 1, 0, len);
+
+	if (le16_to_cpu(acx->id) != ACX_MEM_MAP ||
+	    len < sizeof(*mem_map) - sizeof(*acx))
+		return;
+
+	mem_map = (struct wl1271_acx_mem_map *)acx;
+	mem_map->tx_result = cpu_to_le32(SIM_TX_RESULT);
+	mem_map->packet_memory_pool_start = cpu_to_le32(SIM_PKT_POOL);
+	mem_map->num_tx_mem_blocks = cpu_to_le32(sim->tx_total);
+	mem_map->num_rx_mem_blocks = cpu_to_le32(SIM_RX_SLOTS);
+}
+
+static void wl12xx_sim_cmd(struct wl12xx_sim *sim)
+{
+	struct wl1271_cmd_header *cmd = wl12xx_sim_mem(sim, SIM_CMD_BOX);
+	struct wl12xx_cmd_role_enable *enable;
+	struct wl12xx_cmd_role_start *start;
+	struct wl12xx_cmd_role_stop *stop;
+
+	if (!sim->running)
+		return;
+
+	sim->stats.cmds++;
+
+	switch (le16_to_cpu(cmd->id)) {
+	case CMD_INTERROGATE:
+		wl12xx_sim_interrogate(sim, (struct acx_header *)cmd);
+		break;
+	case CMD_ROLE_ENABLE:
+		enable = (struct wl12xx_cmd_role_enable *)cmd;
+		if (enable->role_id < WL12XX_MAX_ROLES)
+			sim->role_type[enable->role_id] = enable->role_type;
+		break;
+	case CMD_ROLE_START:
+		start = (struct wl12xx_cmd_role_start *)cmd;
+		if (start->role_id < WL12XX_MAX_ROLES &&
+		    sim->role_type[start->role_id] == WL1271_ROLE_STA) {
+			sim->sta_hlid = start->sta.hlid;
+			sim->sta_started = true;
+		}
+		break;
+	case CMD_ROLE_STOP:
+		stop = (struct wl12xx_cmd_role_stop *)cmd;
+		if (stop->role_id < WL12XX_MAX_ROLES &&
+		    sim->role_type[stop->role_id] == WL1271_ROLE_STA) {
+			sim->sta_started = false;
+			sim->associated = false;
+		}
+		sim->cmd_events |= ROLE_STOP_COMPLETE_EVENT_ID;
+		break;
+	case CMD_SCAN:
+		wl12xx_sim_scan(sim, (struct wl1271_cmd_scan *)cmd);
+		break;
+	case CMD_STOP_SCAN:
+		sim->scan_pending = false;
+		sim->scanning = false;
+		hrtimer_try_to_cancel(&sim->scan_timer);
+		break;
+	case CMD_REMAIN_ON_CHANNEL:
+		sim->cmd_events |= REMAIN_ON_CHANNEL_COMPLETE_EVENT_ID;
+		break;
+	case CMD_REMOVE_PEER:
+		sim->cmd_events |= PEER_REMOVE_COMPLETE_EVENT_ID;
+		break;
+	case CMD_CHANNEL_SWITCH:
+		sim->cmd_events |= CHANNEL_SWITCH_COMPLETE_EVENT_ID;
+		break;
+	default:
+		break;
+	}
+
+	/* everything else is accepted as is, CMD_TEST echoes its request */
+	cmd->status = cpu_to_le16(CMD_STATUS_SUCCESS);
+
+	hrtimer_start(&sim->cmd_timer,
+		      ns_to_ktime(cmd_latency_us * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart wl12xx_sim_cmd_done(struct hrtimer *timer)
+{
+	struct wl12xx_sim *sim = container_of(timer, struct wl12xx_sim,
+					      cmd_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	if (!sim->running)
+		goto out;
+
+	wl12xx_sim_raise(sim, WL1271_ACX_INTR_CMD_COMPLETE);
+
+	if (sim->cmd_events) {
+		wl12xx_sim_post_event(sim, sim->cmd_events);
+		sim->cmd_events = 0;
+	}
+
+	if (sim->scan_pending) {
+		sim->scan_pending = false;
+		sim->scanning = true;
+		hrtimer_start(&sim->scan_timer,
+			      ns_to_ktime(sim->scan_dwell_us[0] *
+					  NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+out:
+	spin_unlock_irqrestore(&sim->lock, flags);
+	return HRTIMER_NORESTART;
+}
+
+static u32 wl12xx_sim_reg_read(struct wl12xx_sim *sim, u32 addr)
+{
+	switch (addr) {
+	case CHIP_ID_B:
+		return chip_id_param;
+	case ACX_REG_INTERRUPT_NO_CLEAR:
+		return sim->intr;
+	case OCP_DATA_READ:
+		return sim->ocp_data;
+	default:
+		return sim->regs[(addr - REGISTERS_BASE) / 4];
+	}
+}
+
+static void wl12xx_sim_reg_write(struct wl12xx_sim *sim, u32 addr, u32 val)
+{
+	sim->regs[(addr - REGISTERS_BASE) / 4] = val;
+
+	switch (addr) {
+	case ACX_REG_SLV_SOFT_RESET:
+		/* self clearing */
+		sim->regs[(addr - REGISTERS_BASE) / 4] = 0;
+		wl12xx_sim_fw_stop(sim);
+		break;
+	case ACX_REG_ECPU_CONTROL:
+		if (!sim->running)
+			wl12xx_sim_fw_boot(sim);
+		break;
+	case ACX_REG_INTERRUPT_MASK:
+		sim->intr_mask = val;
+		wl12xx_sim_update_irq(sim);
+		break;
+	case ACX_REG_INTERRUPT_ACK:
+		sim->intr &= ~val;
+		break;
+	case ACX_REG_INTERRUPT_TRIG:
+		if (val & INTR_TRIG_CMD)
+			wl12xx_sim_cmd(sim);
+		if (val & INTR_TRIG_EVENT_ACK)
+			wl12xx_sim_event_ack(sim);
+		break;
+	case OCP_CMD:
+		wl12xx_sim_ocp(sim, val);
+		break;
+	case WL1271_SLV_REG_DATA:
+		wl12xx_sim_rx_select(sim, val);
+		break;
+	default:
+		break;
+	}
+}
+
+static void wl12xx_sim_regs(struct wl12xx_sim *sim, u32 addr, u8 *buf,
+			    size_t len, bool fixed, bool write)
+{
+	size_t i;
+
+	/* the data port streams frames rather than registers */
+	if (addr == WL1271_SLV_MEM_DATA && fixed) {
+		if (write)
+			wl12xx_sim_tx_burst(sim, buf, len);
+		else
+			wl12xx_sim_rx_read(sim, buf, len);
+		return;
+	}
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		if (write)
+			wl12xx_sim_reg_write(sim, addr + i,
+					     get_unaligned_le32(buf + i));
+		else
+			put_unaligned_le32(wl12xx_sim_reg_read(sim, addr + i),
+					   buf + i);
+	}
+}
+
+static void wl12xx_sim_drpw(struct wl12xx_sim *sim, u32 addr, u8 *buf,
+			    size_t len, bool write)
+{
+	u32 val = 0;
+
+	if (len != sizeof(u32))
+		return;
+
+	if (write) {
+		if (addr == DRPW_SCRATCH_START)
+			sim->drpw_scratch = get_unaligned_le32(buf);
+		return;
+	}
+
+	if (addr == DRPW_SCRATCH_START)
+		val = sim->drpw_scratch;
+	else if (addr == WL12XX_REG_FUSE_BD_ADDR_1)
+		val = SIM_FUSE_BD_ADDR_1;
+	else if (addr == WL12XX_REG_FUSE_BD_ADDR_2)
+		val = SIM_FUSE_BD_ADDR_2;
+
+	put_unaligned_le32(val, buf);
+}
+
+static void wl12xx_sim_memory(struct wl12xx_sim *sim, u32 addr, u8 *buf,
+			      size_t len, bool write)
+{
+	u32 host_counter = SIM_TX_RESULT +
+		offsetof(struct wl1271_tx_hw_res_if, tx_result_host_counter);
+
+	if (!write) {
+		memcpy(buf, wl12xx_sim_mem(sim, addr), len);
+		return;
+	}
+
+	memcpy(wl12xx_sim_mem(sim, addr), buf, len);
+
+	if (addr <= host_counter && addr + len > host_counter)
+		wl12xx_sim_tx_acked(sim);
+}
+
+/* bus address to chip address, through the partitions set by the host */
+static bool wl12xx_sim_translate(struct wl12xx_sim *sim, u32 addr, u32 *chip)
+{
+	if (addr < sim->part[0]) {
+		*chip = sim->part[1] + addr;
+		return true;
+	}
+	addr -= sim->part[0];
+
+	if (addr < sim->part[2]) {
+		*chip = sim->part[3] + addr;
+		return true;
+	}
+	addr -= sim->part[2];
+
+	if (addr < sim->part[4]) {
+		*chip = sim->part[5] + addr;
+		return true;
+	}
+
+	return false;
+}
+
+static int wl12xx_sim_access(struct wl12xx_sim *sim, int addr, u8 *buf,
+			     size_t len, bool fixed, bool write)
+{
+	u32 chip, i;
+
+	if (!sim->powered) {
+		sim->stats.off_accesses++;
+		return -EIO;
+	}
+
+	if (addr == HW_ACCESS_ELP_CTRL_REG_ADDR) {
+		wl12xx_sim_elp(sim, buf, len, write);
+		return 0;
+	}
+
+	if (sim->asleep)
+		sim->stats.asleep_accesses++;
+
+	if (addr >= HW_PARTITION_REGISTERS_ADDR &&
+	    addr < HW_ACCESS_ELP_CTRL_REG_ADDR) {
+		for (i = 0; i + 4 <= len; i += 4) {
+			u32 idx = (addr + i - HW_PARTITION_REGISTERS_ADDR) / 4;
+
+			if (idx >= ARRAY_SIZE(sim->part))
+				break;
+			if (write)
+				sim->part[idx] = get_unaligned_le32(buf + i);
+			else
+				put_unaligned_le32(sim->part[idx], buf + i);
+		}
+		return 0;
+	}
+
+	if (addr == FW_STATUS_ADDR && !write && sim->running) {
+		wl12xx_sim_fw_status(sim, buf, len);
+		return 0;
+	}
+
+	if (!wl12xx_sim_translate(sim, addr, &chip)) {
+		if (!write)
+			memset(buf, 0, len);
+		return 0;
+	}
+
+	if (chip >= REGISTERS_BASE &&
+	    chip + len <= REGISTERS_BASE + SIM_REGS_SIZE)
+		wl12xx_sim_regs(sim, chip, buf, len, fixed, write);
+	else if (chip >= DRPW_BASE && chip + len <= DRPW_BASE + SIM_DRPW_SIZE)
+		wl12xx_sim_drpw(sim, chip, buf, len, write);
+	else if (chip >= SIM_MEM_START &&
+		 chip + len <= SIM_MEM_START + SIM_MEM_SIZE)
+		wl12xx_sim_memory(sim, chip, buf, len, write);
+	else if (write)
+		/* code and data RAM, the FW upload ends up here */
+		sim->stats.fw_bytes += len;
+	else
+		memset(buf, 0, len);
+
+	return 0;
+}
+
+static u32 wl12xx_sim_bus_time_us(size_t len)
+{
+	u32 us = bus_latency_us;
+	u32 bandwidth = ACCESS_ONCE(bus_bandwidth);
+
+	if (bandwidth)
+		us += div_u64((u64)len * 1000, bandwidth);
+
+	return us;
+}
+
+/* the transaction takes its time outside the lock, like a real bus */
+static void wl12xx_sim_bus_delay(u32 us)
+{
+	if (!us)
+		return;
+
+	if (us < 20)
+		udelay(us);
+	else
+		usleep_range(us, us + us / 8);
+}
+
+static int __must_check wl12xx_sim_read(struct device *child, int addr,
+					void *buf, size_t len, bool fixed)
+{
+	struct wl12xx_sim *sim = dev_get_drvdata(child->parent);
+	u32 us = wl12xx_sim_bus_time_us(len);
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	ret = wl12xx_sim_access(sim, addr, buf, len, fixed, false);
+	sim->stats.bus_reads++;
+	sim->stats.bus_read_bytes += len;
+	sim->stats.bus_delay_us += us;
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	wl12xx_sim_bus_delay(us);
+
+	return ret;
+}
+
+static int __must_check wl12xx_sim_write(struct device *child, int addr,
+					 void *buf, size_t len, bool fixed)
+{
+	struct wl12xx_sim *sim = dev_get_drvdata(child->parent);
+	u32 us = wl12xx_sim_bus_time_us(len);
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	ret = wl12xx_sim_access(sim, addr, buf, len, fixed, true);
+	sim->stats.bus_writes++;
+	sim->stats.bus_write_bytes += len;
+	sim->stats.bus_delay_us += us;
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	wl12xx_sim_bus_delay(us);
+
+	return ret;
+}
+
+/* one bus transaction, the list is gathered like a DMA engine would */
+static int __must_check wl12xx_sim_write_sg(struct device *child, int addr,
+					    struct scatterlist *sgl,
+					    unsigned int nents, size_t len,
+					    bool fixed)
+{
+	struct wl12xx_sim *sim = dev_get_drvdata(child->parent);
+
+	if (len > WL1271_AGGR_BUFFER_SIZE_MAX)
+		return -EOPNOTSUPP;
+
+	sg_copy_to_buffer(sgl, nents, sim->sg_buf, len);
+
+	return wl12xx_sim_write(child, addr, sim->sg_buf, len, fixed);
+}
+
+static int wl12xx_sim_power(struct device *child, bool enable)
+{
+	struct wl12xx_sim *sim = dev_get_drvdata(child->parent);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	sim->powered = false;
+	wl12xx_sim_fw_stop(sim);
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	hrtimer_cancel(&sim->irq_timer);
+	hrtimer_cancel(&sim->wake_timer);
+	hrtimer_cancel(&sim->cmd_timer);
+	hrtimer_cancel(&sim->scan_timer);
+	hrtimer_cancel(&sim->tx_timer);
+	hrtimer_cancel(&sim->rx_timer);
+
+	if (!enable)
+		return 0;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	memset(sim->part, 0, sizeof(sim->part));
+	memset(sim->regs, 0, SIM_REGS_SIZE);
+	memset(sim->mem, 0, SIM_MEM_SIZE);
+	sim->intr_mask = WL1271_ACX_INTR_ALL;
+	sim->num_top = 0;
+	sim->drpw_scratch = 0;
+	sim->powered = true;
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	return 0;
+}
+
+static struct wl1271_if_operations wl12xx_sim_ops = {
+	.read		= wl12xx_sim_read,
+	.write		= wl12xx_sim_write,
+	.write_sg	= wl12xx_sim_write_sg,
+	.power		= wl12xx_sim_power,
+	.set_block_size = NULL,
+};
+
+static int wl12xx_sim_open(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static ssize_t wl12xx_sim_stats_read(struct file *file, char __user *user_buf,
+				     size_t count, loff_t *ppos)
+{
+	struct wl12xx_sim *sim = file->private_data;
+	struct wl12xx_sim_stats s;
+	unsigned long flags;
+	char *buf;
+	int res;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	s = sim->stats;
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	res = scnprintf(buf, PAGE_SIZE,
+			"bus_reads: %llu bytes %llu\n"
+			"bus_writes: %llu bytes %llu\n"
+			"bus_delay_us: %llu\n"
+			"fw_upload_bytes: %llu\n"
+			"accesses_powered_off: %u\n"
+			"accesses_asleep: %u\n"
+			"elp_wakeups: %u\n"
+			"irqs: %u\n"
+			"status_reads: %u empty %u\n"
+			"cmds: %u\n"
+			"events: %u\n"
+			"scans: %u\n"
+			"rx_frames: %llu bytes %llu\n"
+			"rx_overruns: %u underruns %u bad_blocks %u\n"
+			"tx_frames: %llu bytes %llu\n"
+			"tx_malformed: %u result_stalls %u\n"
+			"watchdogs: %u\n",
+			s.bus_reads, s.bus_read_bytes,
+			s.bus_writes, s.bus_write_bytes,
+			s.bus_delay_us, s.fw_bytes,
+			s.off_accesses, s.asleep_accesses, s.elp_wakeups,
+			s.irqs, s.status_reads, s.empty_status_reads,
+			s.cmds, s.events, s.scans,
+			s.rx_frames, s.rx_bytes,
+			s.rx_overruns, s.rx_underruns, s.rx_bad_blocks,
+			s.tx_frames, s.tx_bytes,
+			s.tx_malformed, s.tx_result_stalls, s.watchdogs);
+
+	res = simple_read_from_buffer(user_buf, count, ppos, buf, res);
+	kfree(buf);
+
+	return res;
+}
+
+/* any write clears the counters */
+static ssize_t wl12xx_sim_stats_write(struct file *file,
+				      const char __user *user_buf,
+				      size_t count, loff_t *ppos)
+{
+	struct wl12xx_sim *sim = file->private_data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	memset(&sim->stats, 0, sizeof(sim->stats));
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations wl12xx_sim_stats_ops = {
+	.read = wl12xx_sim_stats_read,
+	.write = wl12xx_sim_stats_write,
+	.open = wl12xx_sim_open,
+	.llseek = default_llseek,
+};
+
+static ssize_t wl12xx_sim_watchdog_write(struct file *file,
+					 const char __user *user_buf,
+					 size_t count, loff_t *ppos)
+{
+	struct wl12xx_sim *sim = file->private_data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&sim->lock, flags);
+	if (sim->running) {
+		sim->stats.watchdogs++;
+		wl12xx_sim_raise(sim, WL1271_ACX_INTR_WATCHDOG);
+	}
+	spin_unlock_irqrestore(&sim->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations wl12xx_sim_watchdog_ops = {
+	.write = wl12xx_sim_watchdog_write,
+	.open = wl12xx_sim_open,
+	.llseek = default_llseek,
+};
+
+static void wl12xx_sim_free(struct wl12xx_sim *sim)
+{
+	vfree(sim->rx_buf);
+	vfree(sim->sg_buf);
+	vfree(sim->mem);
+	vfree(sim->regs);
+	kfree(sim);
+}
+
+static int __init wl12xx_sim_init(void)
+{
+	struct wl12xx_sim *sim;
+	struct resource res[1];
+	int ret = -ENOMEM;
+
+	sim = kzalloc(sizeof(*sim), GFP_KERNEL);
+	if (!sim)
+		goto out;
+
+	sim->regs = vzalloc(SIM_REGS_SIZE);
+	sim->mem = vzalloc(SIM_MEM_SIZE);
+	sim->sg_buf = vmalloc(WL1271_AGGR_BUFFER_SIZE_MAX);
+	sim->rx_buf = vzalloc(SIM_RX_SLOTS * SIM_RX_SLOT_SIZE);
+	if (!sim->regs || !sim->mem || !sim->sg_buf || !sim->rx_buf)
+		goto out_free;
+
+	spin_lock_init(&sim->lock);
+
+	hrtimer_init(&sim->irq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sim->irq_timer.function = wl12xx_sim_irq_fire;
+	hrtimer_init(&sim->wake_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sim->wake_timer.function = wl12xx_sim_wake_done;
+	hrtimer_init(&sim->cmd_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sim->cmd_timer.function = wl12xx_sim_cmd_done;
+	hrtimer_init(&sim->scan_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sim->scan_timer.function = wl12xx_sim_scan_step;
+	hrtimer_init(&sim->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sim->tx_timer.function = wl12xx_sim_tx_done;
+	hrtimer_init(&sim->rx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	sim->rx_timer.function = wl12xx_sim_rx_gen;
+
+	/* locally administered, the STA address comes from the fuse */
+	memcpy(sim->ap_addr, "\x02\x12\x71\x00\x00\x01", ETH_ALEN);
+	memset(sim->role_type, 0xff, sizeof(sim->role_type));
+
+	sim->irq = irq_alloc_desc(numa_node_id());
+	if (sim->irq < 0) {
+		ret = sim->irq;
+		pr_err("wl12xx_sim: can't allocate an irq\n");
+		goto out_free;
+	}
+
+	irq_set_chip_and_handler(sim->irq, &wl12xx_sim_irq_chip,
+				 handle_level_irq);
+	irq_set_chip_data(sim->irq, sim);
+	irq_modify_status(sim->irq, IRQ_NOREQUEST, IRQ_NOPROBE);
+
+	sim->pdev = platform_device_register_simple("wl12xx_sim", -1, NULL, 0);
+	if (IS_ERR(sim->pdev)) {
+		ret = PTR_ERR(sim->pdev);
+		pr_err("wl12xx_sim: can't register platform device\n");
+		goto out_irq;
+	}
+
+	platform_set_drvdata(sim->pdev, sim);
+
+	sim->pdata.gpio = -EINVAL;
+	sim->pdata.irq = sim->irq;
+	sim->pdata.board_ref_clock = WL12XX_REFCLOCK_38;
+	sim->pdata.board_tcxo_clock = WL12XX_TCXOCLOCK_26;
+	sim->pdata.ops = &wl12xx_sim_ops;
+
+	sim->core = platform_device_alloc("wl12xx", -1);
+	if (!sim->core) {
+		dev_err(&sim->pdev->dev, "can't allocate platform_device\n");
+		ret = -ENOMEM;
+		goto out_unregister;
+	}
+
+	sim->core->dev.parent = &sim->pdev->dev;
+
+	memset(res, 0x00, sizeof(res));
+
+	res[0].start = sim->irq;
+	res[0].flags = IORESOURCE_IRQ;
+	res[0].name = "irq";
+
+	ret = platform_device_add_resources(sim->core, res, ARRAY_SIZE(res));
+	if (ret) {
+		dev_err(&sim->pdev->dev, "can't add resources\n");
+		goto out_dev_put;
+	}
+
+	ret = platform_device_add_data(sim->core, &sim->pdata,
+				       sizeof(sim->pdata));
+	if (ret) {
+		dev_err(&sim->pdev->dev, "can't add platform data\n");
+		goto out_dev_put;
+	}
+
+	ret = platform_device_add(sim->core);
+	if (ret) {
+		dev_err(&sim->pdev->dev, "can't register platform device\n");
+		goto out_dev_put;
+	}
+
+	sim->rootdir = debugfs_create_dir("wl12xx_sim", NULL);
+	if (!IS_ERR_OR_NULL(sim->rootdir)) {
+		debugfs_create_file("stats", 0600, sim->rootdir, sim,
+				    &wl12xx_sim_stats_ops);
+		debugfs_create_file("watchdog", 0200, sim->rootdir, sim,
+				    &wl12xx_sim_watchdog_ops);
+	}
+
+	wl12xx_sim = sim;
+	return 0;
+
+out_dev_put:
+	platform_device_put(sim->core);
+
+out_unregister:
+	platform_device_unregister(sim->pdev);
+
+out_irq:
+	irq_free_desc(sim->irq);
+
+out_free:
+	wl12xx_sim_free(sim);
+out:
+	return ret;
+}
+
+static void __exit wl12xx_sim_exit(void)
+{
+	struct wl12xx_sim *sim = wl12xx_sim;
+
+	debugfs_remove_recursive(sim->rootdir);
+
+	platform_device_del(sim->core);
+	platform_device_put(sim->core);
+
+	/* the core powered the chip off, the timers only check for that */
+	hrtimer_cancel(&sim->irq_timer);
+	hrtimer_cancel(&sim->wake_timer);
+	hrtimer_cancel(&sim->cmd_timer);
+	hrtimer_cancel(&sim->scan_timer);
+	hrtimer_cancel(&sim->tx_timer);
+	hrtimer_cancel(&sim->rx_timer);
+	platform_device_unregister(sim->pdev);
+	irq_free_desc(sim->irq);
+
+	wl12xx_sim_free(sim);
+}
+
+module_init(wl12xx_sim_init);
+module_exit(wl12xx_sim_exit);
+
+module_param_named(chip_id, chip_id_param, uint, S_IRUSR);
+MODULE_PARM_DESC(chip_id, "chip id the model reports, wl1271 PG2.0 by default");
+
+module_param(bus_latency_us, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(bus_latency_us, "fixed cost of a bus transaction in us");
+
+module_param(bus_bandwidth, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(bus_bandwidth, "bus bandwidth in kB/s, 0 for unlimited");
+
+module_param(cmd_latency_us, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(cmd_latency_us, "FW command execution time in us");
+
+module_param(elp_wake_us, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(elp_wake_us, "ELP wakeup time in us");
+
+module_param(air_rate, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(air_rate, "TX PHY rate in Mbps, 0 for no payload airtime");
+
+module_param(air_overhead_us, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(air_overhead_us, "per frame TX airtime overhead in us");
+
+module_param(tx_mem_blocks, uint, S_IRUSR);
+MODULE_PARM_DESC(tx_mem_blocks, "FW TX memory blocks");
+
+module_param(rx_pps, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(rx_pps, "load generator RX frames per second, 0 for off");
+
+module_param(rx_len, uint, S_IRUSR | S_IWUSR);
+MODULE_PARM_DESC(rx_len, "load generator UDP payload length");
+
+module_param(ap_channel, uint, S_IRUSR);
+MODULE_PARM_DESC(ap_channel, "2.4GHz channel of the fake AP");
+
+module_param(ap_ssid, charp, S_IRUSR);
+MODULE_PARM_DESC(ap_ssid, "SSID of the fake AP");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Software chip model for the wl12xx driver");
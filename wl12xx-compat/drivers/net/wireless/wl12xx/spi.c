@@ -29,6 +29,7 @@
 #include <linux/wl12xx.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/scatterlist.h>
 
 #include "wl12xx.h"
 #include "wl12xx_80211.h"
@@ -68,11 +69,26 @@
 /* HW limitation: maximum possible chunk size is 4095 bytes */
 #define WSPI_MAX_CHUNK_SIZE    4092
 
-#define WSPI_MAX_NUM_OF_CHUNKS (WL1271_AGGR_BUFFER_SIZE / WSPI_MAX_CHUNK_SIZE)
+#define WSPI_MAX_NUM_OF_CHUNKS \
+	DIV_ROUND_UP(WL1271_AGGR_BUFFER_SIZE_MAX, WSPI_MAX_CHUNK_SIZE)
+
+/*
+ * A scatter-gather write needs a command word per chunk, and every list
+ * entry may be split once more by a chunk boundary.
+ */
+#define WSPI_MAX_XFERS \
+	(2 * WSPI_MAX_NUM_OF_CHUNKS + WL1271_TX_SG_MAX_ENTRIES)
 
 struct wl12xx_spi_glue {
 	struct device *dev;
 	struct platform_device *core;
+
+	/*
+	 * Write transfers and commands. Too big for the stack with large
+	 * aggregation buffers, all bus access is serialized by wl->mutex.
+	 */
+	struct spi_transfer xfers[WSPI_MAX_XFERS];
+	u32 cmds[WSPI_MAX_NUM_OF_CHUNKS];
 };
 
 static void wl12xx_spi_reset(struct device *child)
@@ -266,19 +282,19 @@ static int __must_check wl12xx_spi_raw_write(struct device *child, int addr,
 					     void *buf, size_t len, bool fixed)
 {
 	struct wl12xx_spi_glue *glue = dev_get_drvdata(child->parent);
-	struct spi_transfer t[2 * WSPI_MAX_NUM_OF_CHUNKS];
+	struct spi_transfer *t = glue->xfers;
 	struct spi_message m;
-	u32 commands[WSPI_MAX_NUM_OF_CHUNKS];
 	u32 *cmd;
 	u32 chunk_len;
 	int i;
 
-	WARN_ON(len > WL1271_AGGR_BUFFER_SIZE);
+	if (WARN_ON(len > WL1271_AGGR_BUFFER_SIZE_MAX))
+		return -EINVAL;
 
 	spi_message_init(&m);
-	memset(t, 0, sizeof(t));
+	memset(t, 0, sizeof(glue->xfers));
 
-	cmd = &commands[0];
+	cmd = glue->cmds;
 	i = 0;
 	while (len > 0) {
 		chunk_len = min((size_t)WSPI_MAX_CHUNK_SIZE, len);
@@ -312,9 +328,78 @@ static int __must_check wl12xx_spi_raw_write(struct device *child, int addr,
 	return 0;
 }
 
+static int __must_check wl12xx_spi_raw_write_sg(struct device *child,
+						int addr,
+						struct scatterlist *sgl,
+						unsigned int nents,
+						size_t len, bool fixed)
+{
+	struct wl12xx_spi_glue *glue = dev_get_drvdata(child->parent);
+	struct spi_transfer *t = glue->xfers;
+	struct spi_message m;
+	struct scatterlist *sg = sgl;
+	u32 *cmd = glue->cmds;
+	u32 sg_offset = 0;
+	u32 chunk_len, piece;
+	int i = 0;
+
+	if (len > WL1271_AGGR_BUFFER_SIZE_MAX ||
+	    nents > WL1271_TX_SG_MAX_ENTRIES)
+		return -EOPNOTSUPP;
+
+	spi_message_init(&m);
+	memset(t, 0, sizeof(glue->xfers));
+
+	while (len > 0) {
+		chunk_len = min((size_t)WSPI_MAX_CHUNK_SIZE, len);
+
+		*cmd = 0;
+		*cmd |= WSPI_CMD_WRITE;
+		*cmd |= (chunk_len << WSPI_CMD_BYTE_LENGTH_OFFSET) &
+			WSPI_CMD_BYTE_LENGTH;
+		*cmd |= addr & WSPI_CMD_BYTE_ADDR;
+
+		if (fixed)
+			*cmd |= WSPI_CMD_FIXED;
+
+		t[i].tx_buf = cmd;
+		t[i].len = sizeof(*cmd);
+		spi_message_add_tail(&t[i++], &m);
+
+		if (!fixed)
+			addr += chunk_len;
+		len -= chunk_len;
+		cmd++;
+
+		/* the chunk payload is made of (parts of) list entries */
+		while (chunk_len > 0) {
+			if (WARN_ON(!sg))
+				return -EINVAL;
+
+			piece = min(chunk_len, sg->length - sg_offset);
+
+			t[i].tx_buf = sg_virt(sg) + sg_offset;
+			t[i].len = piece;
+			spi_message_add_tail(&t[i++], &m);
+
+			chunk_len -= piece;
+			sg_offset += piece;
+			if (sg_offset == sg->length) {
+				sg = sg_next(sg);
+				sg_offset = 0;
+			}
+		}
+	}
+
+	spi_sync(to_spi_device(glue->dev), &m);
+
+	return 0;
+}
+
 static struct wl1271_if_operations spi_ops = {
 	.read		= wl12xx_spi_raw_read,
 	.write		= wl12xx_spi_raw_write,
+	.write_sg	= wl12xx_spi_raw_write_sg,
 	.reset		= wl12xx_spi_reset,
 	.init		= wl12xx_spi_init,
 	.set_block_size = NULL,
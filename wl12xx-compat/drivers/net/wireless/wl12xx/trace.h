@@ -0,0 +1,235 @@
+/*
+ * This file is part of wl12xx
+ *
+ * Copyright (C) 2012 Texas Instruments Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#if !defined(__WL12XX_TRACE) || defined(TRACE_HEADER_MULTI_READ)
+#define __WL12XX_TRACE
+
+#include <linux/tracepoint.h>
+#include <linux/skbuff.h>
+
+#include "wl12xx.h"
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM wl12xx
+
+/*
+ * Data path events. Frames are identified by their skb, the event
+ * timestamps give the time spent in each stage. The trace_lat tool turns
+ * a recorded trace into per-frame latency breakdowns.
+ */
+
+#define WL_ENTRY	__array(char, wiphy_name, 32)
+#define WL_ASSIGN	strlcpy(__entry->wiphy_name, \
+				wiphy_name(wl->hw->wiphy), 32)
+#define WL_PR_FMT	"%s"
+#define WL_PR_ARG	__entry->wiphy_name
+
+TRACE_EVENT(wl12xx_tx_enqueue,
+	TP_PROTO(struct wl1271 *wl, struct sk_buff *skb, u8 hlid, int q,
+		 int queued),
+	TP_ARGS(wl, skb, hlid, q, queued),
+
+	TP_STRUCT__entry(
+		WL_ENTRY
+		__field(const void *, skb)
+		__field(u32, len)
+		__field(u8, hlid)
+		__field(u8, q)
+		__field(int, queued)
+	),
+
+	TP_fast_assign(
+		WL_ASSIGN;
+		__entry->skb = skb;
+		__entry->len = skb->len;
+		__entry->hlid = hlid;
+		__entry->q = q;
+		__entry->queued = queued;
+	),
+
+	TP_printk(
+		WL_PR_FMT " skb:%p len:%u hlid:%u q:%u queued:%d",
+		WL_PR_ARG, __entry->skb, __entry->len, __entry->hlid,
+		__entry->q, __entry->queued
+	)
+);
+
+TRACE_EVENT(wl12xx_tx_prepare,
+	TP_PROTO(struct wl1271 *wl, struct sk_buff *skb, u8 id, u8 hlid),
+	TP_ARGS(wl, skb, id, hlid),
+
+	TP_STRUCT__entry(
+		WL_ENTRY
+		__field(const void *, skb)
+		__field(u32, len)
+		__field(u8, id)
+		__field(u8, hlid)
+	),
+
+	TP_fast_assign(
+		WL_ASSIGN;
+		__entry->skb = skb;
+		__entry->len = skb->len;
+		__entry->id = id;
+		__entry->hlid = hlid;
+	),
+
+	TP_printk(
+		WL_PR_FMT " skb:%p len:%u id:%u hlid:%u",
+		WL_PR_ARG, __entry->skb, __entry->len, __entry->id,
+		__entry->hlid
+	)
+);
+
+TRACE_EVENT(wl12xx_tx_complete,
+	TP_PROTO(struct wl1271 *wl, struct sk_buff *skb, u8 id, u8 status,
+		 u8 retries),
+	TP_ARGS(wl, skb, id, status, retries),
+
+	TP_STRUCT__entry(
+		WL_ENTRY
+		__field(const void *, skb)
+		__field(u8, id)
+		__field(u8, status)
+		__field(u8, retries)
+	),
+
+	TP_fast_assign(
+		WL_ASSIGN;
+		__entry->skb = skb;
+		__entry->id = id;
+		__entry->status = status;
+		__entry->retries = retries;
+	),
+
+	TP_printk(
+		WL_PR_FMT " skb:%p id:%u status:%u retries:%u",
+		WL_PR_ARG, __entry->skb, __entry->id, __entry->status,
+		__entry->retries
+	)
+);
+
+/* a TX burst written to or an RX burst read from the chip */
+DECLARE_EVENT_CLASS(wl12xx_burst_evt,
+	TP_PROTO(struct wl1271 *wl, u32 len, int reason),
+	TP_ARGS(wl, len, reason),
+
+	TP_STRUCT__entry(
+		WL_ENTRY
+		__field(u32, len)
+		__field(int, reason)
+	),
+
+	TP_fast_assign(
+		WL_ASSIGN;
+		__entry->len = len;
+		__entry->reason = reason;
+	),
+
+	TP_printk(
+		WL_PR_FMT " len:%u reason:%d",
+		WL_PR_ARG, __entry->len, __entry->reason
+	)
+);
+
+DEFINE_EVENT(wl12xx_burst_evt, wl12xx_tx_burst,
+	TP_PROTO(struct wl1271 *wl, u32 len, int reason),
+	TP_ARGS(wl, len, reason)
+);
+
+DEFINE_EVENT(wl12xx_burst_evt, wl12xx_rx_read,
+	TP_PROTO(struct wl1271 *wl, u32 len, int reason),
+	TP_ARGS(wl, len, reason)
+);
+
+/* interrupt causes, traced once the FW status has been read */
+TRACE_EVENT(wl12xx_irq,
+	TP_PROTO(struct wl1271 *wl, u32 intr),
+	TP_ARGS(wl, intr),
+
+	TP_STRUCT__entry(
+		WL_ENTRY
+		__field(u32, intr)
+	),
+
+	TP_fast_assign(
+		WL_ASSIGN;
+		__entry->intr = intr;
+	),
+
+	TP_printk(
+		WL_PR_FMT " intr:0x%x",
+		WL_PR_ARG, __entry->intr
+	)
+);
+
+TRACE_EVENT(wl12xx_rx_frame,
+	TP_PROTO(struct wl1271 *wl, struct sk_buff *skb, u8 hlid),
+	TP_ARGS(wl, skb, hlid),
+
+	TP_STRUCT__entry(
+		WL_ENTRY
+		__field(const void *, skb)
+		__field(u32, len)
+		__field(u8, hlid)
+	),
+
+	TP_fast_assign(
+		WL_ASSIGN;
+		__entry->skb = skb;
+		__entry->len = skb->len;
+		__entry->hlid = hlid;
+	),
+
+	TP_printk(
+		WL_PR_FMT " skb:%p len:%u hlid:%u",
+		WL_PR_ARG, __entry->skb, __entry->len, __entry->hlid
+	)
+);
+
+/* the frame is handed to mac80211 */
+TRACE_EVENT(wl12xx_rx_deliver,
+	TP_PROTO(struct wl1271 *wl, struct sk_buff *skb),
+	TP_ARGS(wl, skb),
+
+	TP_STRUCT__entry(
+		WL_ENTRY
+		__field(const void *, skb)
+	),
+
+	TP_fast_assign(
+		WL_ASSIGN;
+		__entry->skb = skb;
+	),
+
+	TP_printk(
+		WL_PR_FMT " skb:%p",
+		WL_PR_ARG, __entry->skb
+	)
+);
+
+#endif /* !__WL12XX_TRACE || TRACE_HEADER_MULTI_READ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE trace
+#include <trace/define_trace.h>
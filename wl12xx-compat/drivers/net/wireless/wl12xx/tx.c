@@ -32,6 +32,7 @@
 #include "ps.h"
 #include "tx.h"
 #include "event.h"
+#include "trace.h"
 
 static int wl1271_set_default_wep_key(struct wl1271 *wl,
 				      struct wl12xx_vif *wlvif, u8 id)
@@ -188,7 +189,7 @@ static int wl1271_tx_allocate(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	u32 spare_blocks = is_gem ? TX_HW_BLOCK_SPARE_GEM :
 				    TX_HW_BLOCK_SPARE_DEFAULT;
 
-	if (buf_offset + total_len > WL1271_AGGR_BUFFER_SIZE)
+	if (buf_offset + total_len > wl->tx_aggr_buf_size)
 		return -EAGAIN;
 
 	/* allocate free identifier for the packet */
@@ -367,6 +368,98 @@ static void wl1271_tx_fill_hdr(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	desc->tx_attr = cpu_to_le16(tx_attr);
 }
 
+/*
+ * Describe a prepared frame in the TX scatter-gather list instead of copying
+ * it into the aggregation buffer. Frames whose data the bus cannot access
+ * directly are still copied, into the slot they would have occupied in
+ * tx_aggr_buf, so the list always describes the same layout as the copy path.
+ */
+static void wl1271_tx_sg_add_frame(struct wl1271 *wl, struct sk_buff *skb,
+				   u32 buf_offset, u32 total_len)
+{
+	u32 pad = total_len - skb->len;
+
+	if (wl->tx_sg_nents == 0)
+		sg_init_table(wl->tx_sg, WL1271_TX_SG_MAX_ENTRIES);
+
+	if (unlikely(!IS_ALIGNED((unsigned long)skb->data, 4))) {
+		memcpy(wl->tx_aggr_buf + buf_offset, skb->data, skb->len);
+		memset(wl->tx_aggr_buf + buf_offset + skb->len, 0, pad);
+		sg_set_buf(&wl->tx_sg[wl->tx_sg_nents++],
+			   wl->tx_aggr_buf + buf_offset, total_len);
+		return;
+	}
+
+	sg_set_buf(&wl->tx_sg[wl->tx_sg_nents++], skb->data, skb->len);
+	if (pad)
+		sg_set_buf(&wl->tx_sg[wl->tx_sg_nents++], wl->tx_pad_buf, pad);
+}
+
+/*
+ * Linearize the TX scatter-gather list into the aggregation buffer. Used when
+ * the bus turns out to be unable to map the list.
+ */
+static void wl1271_tx_sg_linearize(struct wl1271 *wl)
+{
+	struct scatterlist *sg;
+	u32 offset = 0;
+	int i;
+
+	for_each_sg(wl->tx_sg, sg, wl->tx_sg_nents, i) {
+		void *src = sg_virt(sg);
+
+		/* frames copied by wl1271_tx_sg_add_frame are already there */
+		if (src != wl->tx_aggr_buf + offset)
+			memcpy(wl->tx_aggr_buf + offset, src, sg->length);
+		offset += sg->length;
+	}
+}
+
+/* Send the current TX burst of buf_len bytes to the FW */
+static int wl1271_tx_write_burst(struct wl1271 *wl, u32 buf_len,
+				 enum wl1271_aggr_flush_reason reason)
+{
+	int ret;
+
+	if (!wl->tx_sg_nents) {
+		ret = wl1271_write(wl, WL1271_SLV_MEM_DATA, wl->tx_aggr_buf,
+				   buf_len, true);
+		if (ret < 0)
+			return ret;
+
+		trace_wl12xx_tx_burst(wl, buf_len, reason);
+		wl->stats.tx_copy_bursts++;
+		wl->stats.tx_copy_bytes += buf_len;
+		wl1271_aggr_stats_add(wl->stats.tx_aggr_hist,
+				      wl->stats.tx_aggr_flush, buf_len, reason);
+		return 0;
+	}
+
+	sg_mark_end(&wl->tx_sg[wl->tx_sg_nents - 1]);
+	ret = wl1271_write_sg(wl, WL1271_SLV_MEM_DATA, wl->tx_sg,
+			      wl->tx_sg_nents, buf_len, true);
+	if (ret == -EOPNOTSUPP) {
+		wl1271_warning("bus can't send TX scatter-gather list (%u "
+			       "entries, %u bytes), disabling zero-copy TX",
+			       wl->tx_sg_nents, buf_len);
+		wl->tx_sg_enabled = false;
+		wl1271_tx_sg_linearize(wl);
+		wl->tx_sg_nents = 0;
+		return wl1271_tx_write_burst(wl, buf_len, reason);
+	}
+
+	wl->tx_sg_nents = 0;
+	if (ret < 0)
+		return ret;
+
+	trace_wl12xx_tx_burst(wl, buf_len, reason);
+	wl->stats.tx_sg_bursts++;
+	wl->stats.tx_sg_bytes += buf_len;
+	wl1271_aggr_stats_add(wl->stats.tx_aggr_hist, wl->stats.tx_aggr_flush,
+			      buf_len, reason);
+	return 0;
+}
+
 /* caller must hold wl->mutex */
 static int wl1271_prepare_tx_frame(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 				   struct sk_buff *skb, u32 buf_offset)
@@ -441,8 +534,13 @@ static int wl1271_prepare_tx_frame(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 	 */
 	total_len = wl12xx_calc_packet_alignment(wl, skb->len);
 
-	memcpy(wl->aggr_buf + buf_offset, skb->data, skb->len);
-	memset(wl->aggr_buf + buf_offset + skb->len, 0, total_len - skb->len);
+	if (wl->tx_sg_enabled) {
+		wl1271_tx_sg_add_frame(wl, skb, buf_offset, total_len);
+	} else {
+		memcpy(wl->tx_aggr_buf + buf_offset, skb->data, skb->len);
+		memset(wl->tx_aggr_buf + buf_offset + skb->len, 0,
+		       total_len - skb->len);
+	}
 
 	/* Revert side effects in the dummy packet skb, so it can be reused */
 	if (is_dummy)
@@ -479,18 +577,16 @@ u32 wl1271_tx_enabled_rates_get(struct wl1271 *wl, u32 rate_set,
 
 void wl1271_handle_tx_low_watermark(struct wl1271 *wl)
 {
-	unsigned long flags;
 	int i;
 
 	for (i = 0; i < NUM_TX_QUEUES; i++) {
 		if (test_bit(i, &wl->stopped_queues_map) &&
-		    wl->tx_queue_count[i] <= WL1271_TX_QUEUE_LOW_WATERMARK) {
+		    atomic_read(&wl->tx_queue_count[i]) <=
+		    WL1271_TX_QUEUE_LOW_WATERMARK &&
+		    test_and_clear_bit(i, &wl->stopped_queues_map)) {
 			/* firmware buffer has space, restart queues */
-			spin_lock_irqsave(&wl->wl_lock, flags);
 			ieee80211_wake_queue(wl->hw,
 					     wl1271_tx_get_mac80211_queue(i));
-			clear_bit(i, &wl->stopped_queues_map);
-			spin_unlock_irqrestore(&wl->wl_lock, flags);
 		}
 	}
 }
@@ -527,7 +623,6 @@ static struct sk_buff *wl12xx_lnk_skb_dequeue(struct wl1271 *wl,
 					      struct wl1271_link *lnk)
 {
 	struct sk_buff *skb;
-	unsigned long flags;
 	struct sk_buff_head *queue;
 
 	queue = wl1271_select_queue(wl, lnk->tx_queue);
@@ -537,15 +632,126 @@ static struct sk_buff *wl12xx_lnk_skb_dequeue(struct wl1271 *wl,
 	skb = skb_dequeue(queue);
 	if (skb) {
 		int q = wl1271_tx_get_queue(skb_get_queue_mapping(skb));
-		spin_lock_irqsave(&wl->wl_lock, flags);
-		WARN_ON(wl->tx_queue_count[q] <= 0);
-		wl->tx_queue_count[q]--;
-		spin_unlock_irqrestore(&wl->wl_lock, flags);
+		WARN_ON(atomic_dec_return(&wl->tx_queue_count[q]) < 0);
 	}
 
 	return skb;
 }
 
+/* PHY rate of each CONF_HW_RXTX_RATE_* in 100 kbps units */
+static const u16 wl12xx_tx_rate_100kbps[CONF_HW_RXTX_RATE_MAX] = {
+	722, 650, 585, 520, 390, 260, 195, 130, 65,	/* MCS7 SGI - MCS0 */
+	540, 480, 360, 240, 220, 180, 120, 110,		/* 54 - 11 */
+	90, 60, 55, 20, 10,				/* 9 - 1 */
+};
+
+/* Airtime cost of len bytes to lnk, in bytes at the reference rate */
+static u32 wl12xx_tx_airtime_cost(struct wl1271_link *lnk, u32 len)
+{
+	if (!lnk->tx_rate)
+		return len;
+
+	return DIV_ROUND_UP(len * WL12XX_TX_DRR_REF_RATE, lnk->tx_rate);
+}
+
+/*
+ * Pick the AC to serve next, like wl1271_select_queue() but over all the
+ * backlogged links: the non-empty AC with the least packets allocated in
+ * the FW, in VO>VI>BE>BK order on ties.
+ */
+static int wl12xx_drr_select_ac(struct wl1271 *wl)
+{
+	int i, q = -1, ac;
+	u32 min_pkts = 0xffffffff;
+
+	for (i = 0; i < NUM_TX_QUEUES; i++) {
+		ac = wl1271_tx_get_queue(i);
+		if (!bitmap_empty(wl->tx_backlog[ac], WL12XX_MAX_LINKS) &&
+		    wl->tx_allocated_pkts[ac] < min_pkts) {
+			q = ac;
+			min_pkts = wl->tx_allocated_pkts[q];
+		}
+	}
+
+	return q;
+}
+
+/*
+ * Deficit round robin over the links backlogged in an AC. A link keeps
+ * sending while its credit covers the airtime cost of its next frame, and
+ * gets a quantum of credit each time it is passed over. Returns NULL only
+ * once every backlogged link turned out to be empty.
+ */
+static struct sk_buff *wl12xx_drr_ac_dequeue(struct wl1271 *wl, int ac)
+{
+	unsigned long *backlog = wl->tx_backlog[ac];
+	struct wl1271_link *lnk;
+	struct sk_buff_head *queue;
+	struct sk_buff *skb;
+	unsigned long flags;
+	unsigned int h = wl->tx_drr_hlid[ac];
+	u32 cost;
+
+	while (true) {
+		h = find_next_bit(backlog, WL12XX_MAX_LINKS, h);
+		if (h >= WL12XX_MAX_LINKS) {
+			h = find_first_bit(backlog, WL12XX_MAX_LINKS);
+			if (h >= WL12XX_MAX_LINKS)
+				return NULL;
+		}
+
+		lnk = &wl->links[h];
+		queue = &lnk->tx_queue[ac];
+
+		/*
+		 * Only the TX work removes frames, so the head is stable.
+		 * Frames left on a link that is not (or no longer) connected
+		 * wait for the link reset, like in wl12xx_vif_skb_dequeue().
+		 */
+		skb = test_bit(h, wl->links_map) ? skb_peek(queue) : NULL;
+		if (!skb) {
+			/* op_tx sets the bit under the same lock */
+			spin_lock_irqsave(&queue->lock, flags);
+			if (skb_queue_empty(queue) ||
+			    !test_bit(h, wl->links_map))
+				clear_bit(h, backlog);
+			spin_unlock_irqrestore(&queue->lock, flags);
+
+			lnk->tx_deficit[ac] = 0;
+			h++;
+			continue;
+		}
+
+		cost = wl12xx_tx_airtime_cost(lnk, skb->len);
+		if (lnk->tx_deficit[ac] < cost) {
+			lnk->tx_deficit[ac] += WL12XX_TX_DRR_QUANTUM;
+			h++;
+			continue;
+		}
+
+		lnk->tx_deficit[ac] -= cost;
+		wl->tx_drr_hlid[ac] = h;
+
+		skb = skb_dequeue(queue);
+		WARN_ON(atomic_dec_return(&wl->tx_queue_count[ac]) < 0);
+		return skb;
+	}
+}
+
+static struct sk_buff *wl12xx_drr_skb_dequeue(struct wl1271 *wl)
+{
+	struct sk_buff *skb;
+	int ac;
+
+	while ((ac = wl12xx_drr_select_ac(wl)) >= 0) {
+		skb = wl12xx_drr_ac_dequeue(wl, ac);
+		if (skb)
+			return skb;
+	}
+
+	return NULL;
+}
+
 static struct sk_buff *wl12xx_vif_skb_dequeue(struct wl1271 *wl,
 					      struct wl12xx_vif *wlvif)
 {
@@ -577,9 +783,8 @@ static struct sk_buff *wl12xx_vif_skb_dequeue(struct wl1271 *wl,
 	return skb;
 }
 
-static struct sk_buff *wl1271_skb_dequeue(struct wl1271 *wl)
+static struct sk_buff *wl12xx_rr_skb_dequeue(struct wl1271 *wl)
 {
-	unsigned long flags;
 	struct wl12xx_vif *wlvif = wl->last_wlvif;
 	struct sk_buff *skb = NULL;
 
@@ -616,16 +821,25 @@ static struct sk_buff *wl1271_skb_dequeue(struct wl1271 *wl)
 		}
 	}
 
+	return skb;
+}
+
+static struct sk_buff *wl1271_skb_dequeue(struct wl1271 *wl)
+{
+	struct sk_buff *skb;
+
+	if (wl->tx_sched == WL12XX_TX_SCHED_DRR)
+		skb = wl12xx_drr_skb_dequeue(wl);
+	else
+		skb = wl12xx_rr_skb_dequeue(wl);
+
 	if (!skb &&
 	    test_and_clear_bit(WL1271_FLAG_DUMMY_PACKET_PENDING, &wl->flags)) {
 		int q;
 
 		skb = wl->dummy_packet;
 		q = wl1271_tx_get_queue(skb_get_queue_mapping(skb));
-		spin_lock_irqsave(&wl->wl_lock, flags);
-		WARN_ON(wl->tx_queue_count[q] <= 0);
-		wl->tx_queue_count[q]--;
-		spin_unlock_irqrestore(&wl->wl_lock, flags);
+		WARN_ON(atomic_dec_return(&wl->tx_queue_count[q]) < 0);
 	}
 
 	return skb;
@@ -634,23 +848,28 @@ static struct sk_buff *wl1271_skb_dequeue(struct wl1271 *wl)
 static void wl1271_skb_queue_head(struct wl1271 *wl, struct wl12xx_vif *wlvif,
 				  struct sk_buff *skb)
 {
-	unsigned long flags;
 	int q = wl1271_tx_get_queue(skb_get_queue_mapping(skb));
 
 	if (wl12xx_is_dummy_packet(wl, skb)) {
 		set_bit(WL1271_FLAG_DUMMY_PACKET_PENDING, &wl->flags);
 	} else {
 		u8 hlid = wl12xx_tx_get_hlid(wl, wlvif, skb);
-		skb_queue_head(&wl->links[hlid].tx_queue[q], skb);
+		struct wl1271_link *lnk = &wl->links[hlid];
+
+		skb_queue_head(&lnk->tx_queue[q], skb);
+		set_bit(hlid, wl->tx_backlog[q]);
 
 		/* make sure we dequeue the same packet next time */
 		wlvif->last_tx_hlid = (hlid + WL12XX_MAX_LINKS - 1) %
 				      WL12XX_MAX_LINKS;
+
+		/* and give back the credit it was charged */
+		if (wl->tx_sched == WL12XX_TX_SCHED_DRR)
+			lnk->tx_deficit[q] +=
+				wl12xx_tx_airtime_cost(lnk, skb->len);
 	}
 
-	spin_lock_irqsave(&wl->wl_lock, flags);
-	wl->tx_queue_count[q]++;
-	spin_unlock_irqrestore(&wl->wl_lock, flags);
+	atomic_inc(&wl->tx_queue_count[q]);
 }
 
 static bool wl1271_tx_is_data_present(struct sk_buff *skb)
@@ -696,6 +915,17 @@ void wl12xx_rearm_rx_streaming(struct wl1271 *wl, unsigned long *active_hlids)
 	}
 }
 
+/* skb was handed to the FW, its data starts with the HW descriptor */
+static void wl1271_tx_count_packet(struct wl1271 *wl, struct sk_buff *skb)
+{
+	struct wl1271_tx_hw_descr *desc = (struct wl1271_tx_hw_descr *)skb->data;
+	int ac = wl1271_tx_get_queue(skb_get_queue_mapping(skb));
+
+	wl12xx_pcpu_inc(wl, tx_packets[desc->hlid][ac]);
+	wl12xx_pcpu_add(wl, tx_bytes[desc->hlid][ac],
+			skb->len - sizeof(*desc));
+}
+
 /*
  * Returns failure values only in case of failed bus ops within this function.
  * wl1271_prepare_tx_frame retvals won't be returned in order to avoid
@@ -714,6 +944,7 @@ int wl1271_tx_work_locked(struct wl1271 *wl)
 	u32 buf_offset = 0;
 	bool sent_packets = false;
 	unsigned long active_hlids[BITS_TO_LONGS(WL12XX_MAX_LINKS)] = {0};
+	enum wl1271_aggr_flush_reason reason = WL1271_AGGR_FLUSH_QUEUE_EMPTY;
 	int ret = 0;
 	int bus_ret = 0;
 
@@ -736,8 +967,8 @@ int wl1271_tx_work_locked(struct wl1271 *wl)
 			 * Flush buffer and try again.
 			 */
 			wl1271_skb_queue_head(wl, wlvif, skb);
-			bus_ret = wl1271_write(wl, WL1271_SLV_MEM_DATA,
-					       wl->aggr_buf, buf_offset, true);
+			bus_ret = wl1271_tx_write_burst(wl, buf_offset,
+						WL1271_AGGR_FLUSH_BUF_FULL);
 			if (bus_ret < 0)
 				goto out;
 
@@ -752,6 +983,7 @@ int wl1271_tx_work_locked(struct wl1271 *wl)
 			wl1271_skb_queue_head(wl, wlvif, skb);
 			/* No work left, avoid scheduling redundant tx work */
 			set_bit(WL1271_FLAG_FW_TX_BUSY, &wl->flags);
+			reason = WL1271_AGGR_FLUSH_FW_BUSY;
 			goto out_ack;
 		} else if (ret < 0) {
 			if (wl12xx_is_dummy_packet(wl, skb))
@@ -760,22 +992,26 @@ int wl1271_tx_work_locked(struct wl1271 *wl)
 				 * so re-enqueue it
 				 */
 				wl1271_skb_queue_head(wl, wlvif, skb);
-			else
+			else {
+				wl12xx_pcpu_inc(wl,
+					drops[WL12XX_DROP_TX_PREPARE]);
 				ieee80211_free_txskb(wl->hw, skb);
+			}
+			reason = WL1271_AGGR_FLUSH_OTHER;
 			goto out_ack;
 		}
 		buf_offset += ret;
 		wl->tx_packets_count++;
-		if (has_data) {
-			desc = (struct wl1271_tx_hw_descr *) skb->data;
+		desc = (struct wl1271_tx_hw_descr *) skb->data;
+		trace_wl12xx_tx_prepare(wl, skb, desc->id, desc->hlid);
+		wl1271_tx_count_packet(wl, skb);
+		if (has_data)
 			__set_bit(desc->hlid, active_hlids);
-		}
 	}
 
 out_ack:
 	if (buf_offset) {
-		bus_ret = wl1271_write(wl, WL1271_SLV_MEM_DATA, wl->aggr_buf,
-				       buf_offset, true);
+		bus_ret = wl1271_tx_write_burst(wl, buf_offset, reason);
 		if (bus_ret < 0)
 			goto out;
 
@@ -798,6 +1034,8 @@ out_ack:
 	wl12xx_rearm_rx_streaming(wl, active_hlids);
 
 out:
+	/* a failed burst must not leave stale entries for the next one */
+	wl->tx_sg_nents = 0;
 	return bus_ret;
 }
 
@@ -807,7 +1045,12 @@ void wl1271_tx_work(struct work_struct *work)
 	int ret;
 
 	mutex_lock(&wl->mutex);
-	ret = wl1271_ps_elp_wakeup(wl);
+
+	/*
+	 * Don't wait for the chip here, the first burst is dequeued and
+	 * prepared while it wakes up. Its bus write waits for what is left.
+	 */
+	ret = wl1271_ps_elp_wakeup_start(wl);
 	if (ret < 0)
 		goto out;
 
@@ -834,6 +1077,19 @@ static u8 wl1271_tx_get_rate_flags(u8 rate_class_index)
 	return flags;
 }
 
+/* Remember the rate a link was last served at, for the DRR airtime cost */
+static void wl12xx_tx_update_link_rate(struct wl1271 *wl, struct sk_buff *skb,
+				       u8 rate_class_index)
+{
+	struct wl1271_tx_hw_descr *desc = (struct wl1271_tx_hw_descr *)skb->data;
+
+	if (desc->hlid >= WL12XX_MAX_LINKS ||
+	    rate_class_index >= CONF_HW_RXTX_RATE_MAX)
+		return;
+
+	wl->links[desc->hlid].tx_rate = wl12xx_tx_rate_100kbps[rate_class_index];
+}
+
 static void wl1271_tx_complete_packet(struct wl1271 *wl,
 				      struct wl1271_tx_hw_res_descr *result)
 {
@@ -855,6 +1111,9 @@ static void wl1271_tx_complete_packet(struct wl1271 *wl,
 	skb = wl->tx_frames[id];
 	info = IEEE80211_SKB_CB(skb);
 
+	trace_wl12xx_tx_complete(wl, skb, id, result->status,
+				 result->ack_failures);
+
 	if (wl12xx_is_dummy_packet(wl, skb)) {
 		wl1271_free_tx_id(wl, id);
 		return;
@@ -866,14 +1125,19 @@ static void wl1271_tx_complete_packet(struct wl1271 *wl,
 
 	/* update the TX status info */
 	if (result->status == TX_SUCCESS) {
+		if (unlikely(wl->ttff_pending))
+			wl12xx_ttff_done(wl);
+
 		if (!(info->flags & IEEE80211_TX_CTL_NO_ACK))
 			info->flags |= IEEE80211_TX_STAT_ACK;
 		rate = wl1271_rate_to_idx(result->rate_class_index,
 					  wlvif->band);
 		rate_flags = wl1271_tx_get_rate_flags(result->rate_class_index);
 		retries = result->ack_failures;
+		wl12xx_tx_update_link_rate(wl, skb, result->rate_class_index);
 	} else if (result->status == TX_RETRY_EXCEEDED) {
 		wl->stats.excessive_retries++;
+		wl12xx_pcpu_inc(wl, drops[WL12XX_DROP_TX_RETRIES]);
 		retries = result->ack_failures;
 	}
 
@@ -926,6 +1190,27 @@ static void wl1271_tx_complete_packet(struct wl1271 *wl,
 	wl1271_free_tx_id(wl, result->id);
 }
 
+/* write the host counter to the chipset to ack the processed TX results */
+int wl1271_tx_ack_results(struct wl1271 *wl)
+{
+	struct wl1271_acx_mem_map *memmap =
+		(struct wl1271_acx_mem_map *)wl->target_mem_map;
+	int ret;
+
+	if (wl->tx_results_acked == wl->tx_results_count)
+		return 0;
+
+	ret = wl1271_write32(wl, le32_to_cpu(memmap->tx_result) +
+			     offsetof(struct wl1271_tx_hw_res_if,
+				      tx_result_host_counter),
+			     wl->tx_results_count);
+	if (ret < 0)
+		return ret;
+
+	wl->tx_results_acked = wl->tx_results_count;
+	return 0;
+}
+
 /* Called upon reception of a TX complete interrupt */
 int wl1271_tx_complete(struct wl1271 *wl)
 {
@@ -943,13 +1228,6 @@ int wl1271_tx_complete(struct wl1271 *wl)
 
 	fw_counter = le32_to_cpu(wl->tx_res_if->tx_result_fw_counter);
 
-	/* write host counter to chipset (to ack) */
-	ret = wl1271_write32(wl, le32_to_cpu(memmap->tx_result) +
-			     offsetof(struct wl1271_tx_hw_res_if,
-				      tx_result_host_counter), fw_counter);
-	if (ret < 0)
-		goto out;
-
 	count = fw_counter - wl->tx_results_count;
 	wl1271_debug(DEBUG_TX, "tx_complete received, packets: %d", count);
 
@@ -969,6 +1247,20 @@ int wl1271_tx_complete(struct wl1271 *wl)
 		wl->tx_results_count++;
 	}
 
+	/*
+	 * While frames are still in flight their completion will come with
+	 * another interrupt, so the ack can ride along with that one as long
+	 * as the FW keeps enough free room in its result queue.
+	 */
+	if (wl->tx_frames_cnt > 0 &&
+	    wl->tx_results_count - wl->tx_results_acked <
+	    TX_HW_RESULT_QUEUE_LEN / 2) {
+		wl->stats.tx_result_acks_deferred++;
+		goto out;
+	}
+
+	ret = wl1271_tx_ack_results(wl);
+
 out:
 	return ret;
 }
@@ -977,7 +1269,6 @@ void wl1271_tx_reset_link_queues(struct wl1271 *wl, u8 hlid)
 {
 	struct sk_buff *skb;
 	int i;
-	unsigned long flags;
 	struct ieee80211_tx_info *info;
 	int total[NUM_TX_QUEUES];
 
@@ -991,16 +1282,16 @@ void wl1271_tx_reset_link_queues(struct wl1271 *wl, u8 hlid)
 				info->status.rates[0].idx = -1;
 				info->status.rates[0].count = 0;
 				ieee80211_tx_status_ni(wl->hw, skb);
+				wl12xx_pcpu_inc(wl,
+						drops[WL12XX_DROP_TX_FLUSH]);
 			}
 
 			total[i]++;
 		}
 	}
 
-	spin_lock_irqsave(&wl->wl_lock, flags);
 	for (i = 0; i < NUM_TX_QUEUES; i++)
-		wl->tx_queue_count[i] -= total[i];
-	spin_unlock_irqrestore(&wl->wl_lock, flags);
+		atomic_sub(total[i], &wl->tx_queue_count[i]);
 
 	wl1271_handle_tx_low_watermark(wl);
 }
@@ -1026,9 +1317,11 @@ void wl12xx_tx_reset_wlvif(struct wl1271 *wl, struct wl12xx_vif *wlvif)
 /* caller must hold wl->mutex and TX must be stopped */
 void wl12xx_tx_reset(struct wl1271 *wl, bool reset_tx_queues)
 {
-	int i;
+	int i, h;
 	struct sk_buff *skb;
+	struct sk_buff_head *queue;
 	struct ieee80211_tx_info *info;
+	unsigned long flags;
 
 	/* only reset the queues if something bad happened */
 	if (WARN_ON(wl1271_tx_total_queue_count(wl) != 0)) {
@@ -1036,8 +1329,20 @@ void wl12xx_tx_reset(struct wl1271 *wl, bool reset_tx_queues)
 			wl1271_tx_reset_link_queues(wl, i);
 
 		for (i = 0; i < NUM_TX_QUEUES; i++)
-			wl->tx_queue_count[i] = 0;
+			atomic_set(&wl->tx_queue_count[i], 0);
+	}
+
+	/* op_tx may still be setting bits, under the queue locks */
+	for (i = 0; i < NUM_TX_QUEUES; i++) {
+		for (h = 0; h < WL12XX_MAX_LINKS; h++) {
+			queue = &wl->links[h].tx_queue[i];
+			spin_lock_irqsave(&queue->lock, flags);
+			if (skb_queue_empty(queue))
+				clear_bit(h, wl->tx_backlog[i]);
+			spin_unlock_irqrestore(&queue->lock, flags);
+		}
 	}
+	memset(wl->tx_drr_hlid, 0, sizeof(wl->tx_drr_hlid));
 
 	wl->stopped_queues_map = 0;
 
@@ -1077,6 +1382,7 @@ void wl12xx_tx_reset(struct wl1271 *wl, bool reset_tx_queues)
 			info->status.rates[0].count = 0;
 
 			ieee80211_tx_status_ni(wl->hw, skb);
+			wl12xx_pcpu_inc(wl, drops[WL12XX_DROP_TX_FLUSH]);
 		}
 	}
 }
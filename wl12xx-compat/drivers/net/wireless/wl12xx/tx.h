@@ -202,7 +202,7 @@ static inline int wl1271_tx_total_queue_count(struct wl1271 *wl)
 	int i, count = 0;
 
 	for (i = 0; i < NUM_TX_QUEUES; i++)
-		count += wl->tx_queue_count[i];
+		count += atomic_read(&wl->tx_queue_count[i]);
 
 	return count;
 }
@@ -210,6 +210,7 @@ static inline int wl1271_tx_total_queue_count(struct wl1271 *wl)
 void wl1271_tx_work(struct work_struct *work);
 int wl1271_tx_work_locked(struct wl1271 *wl);
 int wl1271_tx_complete(struct wl1271 *wl);
+int wl1271_tx_ack_results(struct wl1271 *wl);
 void wl12xx_tx_reset_wlvif(struct wl1271 *wl, struct wl12xx_vif *wlvif);
 void wl12xx_tx_reset(struct wl1271 *wl, bool reset_tx_queues);
 void wl1271_tx_flush(struct wl1271 *wl);
@@ -30,6 +30,11 @@
 #include <linux/spinlock.h>
 #include <linux/list.h>
 #include <linux/bitops.h>
+#include <linux/scatterlist.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/netdevice.h>
 #include <net/mac80211.h>
 #ifdef CONFIG_HAS_WAKELOCK
 #include <linux/wakelock.h>
@@ -94,7 +99,39 @@
 
 #define ACX_TX_DESCRIPTORS         16
 
-#define WL1271_AGGR_BUFFER_SIZE (4 * PAGE_SIZE)
+/*
+ * Default, minimum and maximum size of the TX/RX aggregation buffers. The
+ * minimum must hold the largest RX frame, since a burst is never split.
+ */
+#define WL1271_AGGR_BUFFER_SIZE     (4 * PAGE_SIZE)
+#define WL1271_AGGR_BUFFER_SIZE_MIN (2 * PAGE_SIZE)
+#define WL1271_AGGR_BUFFER_SIZE_MAX (8 * PAGE_SIZE)
+
+/*
+ * Bytes per bus transaction histogram: bucket 0 counts [0, 512), bucket i
+ * [256 << i, 512 << i) and the last one everything above.
+ */
+#define WL1271_AGGR_HIST_SHIFT 9
+#define WL1271_AGGR_HIST_LEN   8
+
+/* Why an aggregated burst was sent to / read from the bus */
+enum wl1271_aggr_flush_reason {
+	WL1271_AGGR_FLUSH_BUF_FULL,
+	WL1271_AGGR_FLUSH_FW_BUSY,
+	WL1271_AGGR_FLUSH_QUEUE_EMPTY,
+	WL1271_AGGR_FLUSH_OTHER,
+
+	WL1271_AGGR_FLUSH_MAX
+};
+
+/*
+ * Each frame in a TX burst takes one scatter-gather entry for its data and
+ * possibly a second one for the bus alignment padding.
+ */
+#define WL1271_TX_SG_MAX_ENTRIES (2 * ACX_TX_DESCRIPTORS)
+
+/* Number of burst buffers in the zero-copy RX ring */
+#define WL1271_RX_PAGE_RING_SIZE 4
 
 enum wl1271_state {
 	WL1271_STATE_OFF,
@@ -107,6 +144,7 @@ enum wl12xx_fw_type {
 	WL12XX_FW_TYPE_NORMAL,
 	WL12XX_FW_TYPE_MULTI,
 	WL12XX_FW_TYPE_PLT,
+	WL12XX_FW_TYPE_MAX
 };
 
 enum wl1271_partition_type {
@@ -158,17 +196,281 @@ struct wl1271_chip {
 	unsigned int fw_ver[NUM_FW_VER];
 };
 
+/*
+ * Recovery tiers: a light one that keeps the FW running, and the full one
+ * that reboots the chip and restarts mac80211.
+ */
+enum wl12xx_recovery_tier {
+	WL12XX_RECOVERY_LIGHT,
+	WL12XX_RECOVERY_FULL,
+	WL12XX_RECOVERY_TIER_MAX
+};
+
+/* how long the light tier waits for the FW to release TX blocks (msecs) */
+#define WL12XX_RECOVERY_LIGHT_TIMEOUT	500
+
+/* Boot phases whose duration is tracked in wl1271_stats */
+enum wl12xx_boot_phase {
+	WL12XX_BOOT_PHASE_NVS,
+	WL12XX_BOOT_PHASE_FW,
+	WL12XX_BOOT_PHASE_RUN_FW,
+	WL12XX_BOOT_PHASE_HW_INIT,
+	WL12XX_BOOT_PHASE_MAX
+};
+
+struct wl1271_cmd_lat_stats;
+
+/* ELP wakeup latency buckets: below 128us, then doubling */
+#define WL1271_ELP_WAKE_HIST_SHIFT 7
+#define WL1271_ELP_WAKE_HIST_LEN   10
+
+/* bus transactions per threaded IRQ run, the last bucket is "or more" */
+#define WL12XX_IRQ_BUS_OPS_HIST_LEN 10
+
+/* frames per RX NAPI poll: 0, 1, 2-3, 4-7, ..., the last is "or more" */
+#define WL12XX_RX_NAPI_HIST_LEN 9
+
+/*
+ * A piece of the firmware image, at most one bus transfer long, kept in
+ * kmalloc'd memory so it can be written to the chip without a bounce copy.
+ */
+struct wl12xx_fw_chunk {
+	u32 addr;
+	u32 len;
+	u8 *data;
+};
+
+/* A parsed firmware image, ready to be uploaded */
+struct wl12xx_fw_image {
+	struct wl12xx_fw_chunk *chunks;
+	int num_chunks;
+	size_t len;
+};
+
 struct wl1271_stats {
 	struct acx_statistics *fw_stats;
 	unsigned long fw_stats_update;
 
+	/* FW command latencies, allocated with the debugfs entries */
+	struct wl1271_cmd_lat_stats *cmd_lat;
+
+	/* commands completed on the IRQ / found complete by polling */
+	unsigned int cmd_irq_completions;
+	unsigned int cmd_poll_completions;
+
 	unsigned int retry_count;
 	unsigned int excessive_retries;
+
+	/* TX bursts sent straight from the skbs and the bytes they carried */
+	unsigned int tx_sg_bursts;
+	u64 tx_sg_bytes;
+
+	/* TX bursts copied into the aggregation buffer and their bytes */
+	unsigned int tx_copy_bursts;
+	u64 tx_copy_bytes;
+
+	/*
+	 * zero-copy RX buffers reused from the ring / newly allocated /
+	 * bursts copied because the stack still held every buffer
+	 */
+	unsigned int rx_zc_recycled;
+	unsigned int rx_zc_allocated;
+	unsigned int rx_zc_busy;
+
+	/* bytes per bus transaction and burst flush reasons */
+	unsigned int tx_aggr_hist[WL1271_AGGR_HIST_LEN];
+	unsigned int rx_aggr_hist[WL1271_AGGR_HIST_LEN];
+	unsigned int tx_aggr_flush[WL1271_AGGR_FLUSH_MAX];
+	unsigned int rx_aggr_flush[WL1271_AGGR_FLUSH_MAX];
+
+	/* last and worst duration of each boot phase, in usecs */
+	u32 boot_phase_us[WL12XX_BOOT_PHASE_MAX];
+	u32 boot_phase_max_us[WL12XX_BOOT_PHASE_MAX];
+
+	/* partition switches done by the last firmware upload */
+	unsigned int fw_upload_part_switches;
+
+	/*
+	 * recoveries per tier, their last and worst duration, light ones
+	 * that had to be escalated and recovery-to-booted time, in msecs
+	 */
+	unsigned int recoveries[WL12XX_RECOVERY_TIER_MAX];
+	u32 recovery_ms[WL12XX_RECOVERY_TIER_MAX];
+	u32 recovery_max_ms[WL12XX_RECOVERY_TIER_MAX];
+	unsigned int recovery_escalations;
+	u32 recovery_boot_ms;
+	u32 recovery_boot_max_ms;
+
+	/* firmware images found in / loaded into the cache, preloads done */
+	unsigned int fw_cache_hits;
+	unsigned int fw_cache_misses;
+	unsigned int fw_preloads;
+
+	/* scans that found their probe request template already set */
+	unsigned int scan_templ_reused;
+
+	/*
+	 * scans, the FW commands they took, their duration in msecs and the
+	 * time to their first candidate (beacon or probe response) in usecs
+	 */
+	unsigned int scans;
+	unsigned int scan_cmds;
+	unsigned int scans_no_candidate;
+	u32 scan_ms;
+	u32 scan_max_ms;
+	u32 scan_ttfc_us;
+	u32 scan_ttfc_max_us;
+	u64 scan_ttfc_total_us;
+	unsigned int scan_ttfc_count;
+
+	/* bus transactions, threaded IRQ runs and what they cost and moved */
+	u64 bus_ops;
+	unsigned int irq_runs;
+	u64 irq_bus_ops;
+	u64 irq_packets;
+	unsigned int irq_bus_ops_hist[WL12XX_IRQ_BUS_OPS_HIST_LEN];
+
+	/*
+	 * IRQ passes ended early at the coalescing threshold, passes that
+	 * left RX for the NAPI poll, polls run, the frames they delivered,
+	 * polls that used up their budget and frames per poll
+	 */
+	unsigned int rx_napi_coalesce_kicks;
+	unsigned int rx_napi_kicks;
+	unsigned int rx_napi_polls;
+	u64 rx_napi_frames;
+	unsigned int rx_napi_exhausted;
+	unsigned int rx_napi_hist[WL12XX_RX_NAPI_HIST_LEN];
+
+	/* ELP wakeups: latency histogram, worst case and rate */
+	unsigned int elp_wakeups;
+	unsigned int elp_wakeups_per_sec;
+	unsigned int elp_wake_hist[WL1271_ELP_WAKE_HIST_LEN];
+	u32 elp_wake_max_us;
+	/* wakeups that were complete by the time the bus was needed */
+	unsigned int elp_wake_overlapped;
+
+	/* TX result acks postponed to a later completion */
+	unsigned int tx_result_acks_deferred;
+
+	/* event mailboxes read, reads that took both, acks sent with a cmd */
+	unsigned int event_mboxes;
+	unsigned int event_dual_reads;
+	unsigned int event_acks_folded;
+	/* event work runs and the events they handled */
+	unsigned int event_work_runs;
+	unsigned int event_work_events;
+
+	/* time from interface up to the first frame TXed or RXed, in msecs */
+	u32 ttff_ms;
+	u32 ttff_max_ms;
 };
 
+static inline void wl1271_aggr_stats_add(unsigned int *hist,
+					 unsigned int *flush, u32 len,
+					 enum wl1271_aggr_flush_reason reason)
+{
+	int bucket = fls(len >> WL1271_AGGR_HIST_SHIFT);
+
+	hist[min(bucket, WL1271_AGGR_HIST_LEN - 1)]++;
+	flush[reason]++;
+}
+
 #define NUM_TX_QUEUES              4
 #define NUM_RX_PKT_DESC            8
 
+#define WL12XX_FWLOG_RING_MAGIC    0x574c4652	/* "WLFR" */
+#define WL12XX_FWLOG_RING_VERSION  1
+/* data area of the FW log ring, a power of two */
+#define WL12XX_FWLOG_DATA_SIZE     (16 * PAGE_SIZE)
+#define WL12XX_FWLOG_RING_SIZE     (PAGE_SIZE + WL12XX_FWLOG_DATA_SIZE)
+
+/*
+ * The FW log ring is what the sysfs fwlog file maps: this header in the
+ * first page, records from data_offset on. head and tail are free-running
+ * byte counts into the data area. The driver appends at head, a reader
+ * consumes from tail and then stores the new tail. Unconsumed records are
+ * never overwritten, what doesn't fit is counted in overruns/lost_bytes
+ * and still uses up a sequence number, so the loss shows as a gap in seq.
+ * The fwlog_head sysfs file is notified whenever head may have moved.
+ */
+struct wl12xx_fwlog_ring {
+	u32 magic;
+	u32 version;
+	u32 data_offset;
+	u32 data_size;
+	u32 head;
+	u32 tail;
+	/* sequence number of the next record */
+	u32 seq;
+	u32 overruns;
+	u32 lost_bytes;
+} __packed;
+
+/*
+ * Records are 8 byte aligned and never wrap around the end of the data
+ * area. A record of length 0, or less than a record header left before the
+ * end, means the reader continues at the start.
+ */
+struct wl12xx_fwlog_rec {
+	u32 seq;
+	u32 len;
+	/* CLOCK_MONOTONIC time the record was received, in nsecs */
+	u64 timestamp_ns;
+	u8 data[0];
+} __packed;
+
+enum wl12xx_drop_reason {
+	WL12XX_DROP_TX_NO_LINK,		/* no valid link for the frame */
+	WL12XX_DROP_TX_PREPARE,		/* descriptor or FW blocks failed */
+	WL12XX_DROP_TX_RETRIES,		/* FW gave up retransmitting */
+	WL12XX_DROP_TX_FLUSH,		/* pending frames freed on reset */
+	WL12XX_DROP_RX_INVALID,		/* corrupted or bad status */
+	WL12XX_DROP_RX_NOMEM,
+	WL12XX_DROP_MAX
+};
+
+/*
+ * Data path counters, one copy per CPU so they are bumped without locks or
+ * shared cache lines and only summed when read. Links are indexed by hlid,
+ * ACs in CONF_TX_AC_* order. Only u64 members, the snapshot sums the
+ * structure as an array.
+ */
+struct wl12xx_pcpu_stats {
+	u64 tx_packets[WL12XX_MAX_LINKS][NUM_TX_QUEUES];
+	u64 tx_bytes[WL12XX_MAX_LINKS][NUM_TX_QUEUES];
+	u64 rx_packets[WL12XX_MAX_LINKS][NUM_TX_QUEUES];
+	u64 rx_bytes[WL12XX_MAX_LINKS][NUM_TX_QUEUES];
+	u64 bus_ops;
+	u64 bus_bytes;
+	u64 drops[WL12XX_DROP_MAX];
+};
+
+/*
+ * 32 bit CPUs update the u64 counters in two halves. The per CPU syncp lets
+ * the snapshot retry a torn read, and interrupts are kept off so that the
+ * softirq TX path doesn't nest into another update on the same CPU.
+ */
+#if BITS_PER_LONG == 32
+#define wl12xx_pcpu_add(wl, field, val)					\
+do {									\
+	struct u64_stats_sync *__syncp;					\
+	unsigned long __flags;						\
+									\
+	local_irq_save(__flags);					\
+	__syncp = this_cpu_ptr((wl)->pcpu_syncp);			\
+	u64_stats_update_begin(__syncp);				\
+	__this_cpu_add((wl)->pcpu_stats->field, (val));			\
+	u64_stats_update_end(__syncp);					\
+	local_irq_restore(__flags);					\
+} while (0)
+#else
+#define wl12xx_pcpu_add(wl, field, val)					\
+	this_cpu_add((wl)->pcpu_stats->field, (val))
+#endif
+
+#define wl12xx_pcpu_inc(wl, field) wl12xx_pcpu_add(wl, field, 1)
+
 #define AP_MAX_STATIONS            8
 
 /* FW status registers */
@@ -219,7 +521,15 @@ struct wl1271_rx_mem_pool_addr {
 #define WL1271_MAX_CHANNELS 64
 struct wl1271_scan {
 	struct cfg80211_scan_request *req;
-	unsigned long scanned_ch[BITS_TO_LONGS(WL1271_MAX_CHANNELS)];
+	/* the CMD_SCANs planned in buf->steps and the next one to send */
+	u8 n_steps;
+	u8 cur_step;
+	/* scan start, waiting for the first beacon or probe response */
+	ktime_t start;
+	bool ttfc_pending;
+	/* bands whose probe request template in buf->probe_templ is set */
+	unsigned long probe_templ_valid;
+	struct wl1271_scan_buf *buf;
 	bool failed;
 	u8 state;
 	u8 ssid[IEEE80211_MAX_SSID_LEN+1];
@@ -231,6 +541,15 @@ struct wl1271_if_operations {
 				 size_t len, bool fixed);
 	int __must_check (*write)(struct device *child, int addr, void *buf,
 				  size_t len, bool fixed);
+	/*
+	 * Optional. Write a scatter-gather list in a single bus transaction.
+	 * Returns -EOPNOTSUPP, without touching the bus, if the list cannot
+	 * be mapped by the host controller.
+	 */
+	int __must_check (*write_sg)(struct device *child, int addr,
+				     struct scatterlist *sgl,
+				     unsigned int nents, size_t len,
+				     bool fixed);
 	void (*reset)(struct device *child);
 	void (*init)(struct device *child);
 	int (*power)(struct device *child, bool enable);
@@ -258,6 +577,7 @@ enum wl12xx_flags {
 	WL1271_FLAG_TX_PENDING,
 	WL1271_FLAG_IN_ELP,
 	WL1271_FLAG_ELP_REQUESTED,
+	WL1271_FLAG_ELP_WAKING,
 	WL1271_FLAG_WAKE_LOCK,
 	WL1271_FLAG_IRQ_RUNNING,
 	WL1271_FLAG_FW_TX_BUSY,
@@ -270,6 +590,7 @@ enum wl12xx_flags {
 	WL1271_FLAG_INTENDED_FW_RECOVERY,
 	WL1271_FLAG_RECOVERY_WORK_PENDING,
 	WL1271_FLAG_IO_FAILED,
+	WL1271_FLAG_CMD_COMPLETE_IRQ,
 };
 
 enum wl12xx_vif_flags {
@@ -298,6 +619,19 @@ struct wl1271_link {
 
 	/* bitmap of TIDs where RX BA sessions are active for this link */
 	u8 ba_bitmap;
+
+	/* DRR scheduler - airtime credit per AC */
+	int tx_deficit[NUM_TX_QUEUES];
+
+	/* last successful TX rate in 100 kbps units, 0 if unknown */
+	u16 tx_rate;
+};
+
+enum wl12xx_tx_sched {
+	/* strict AC priority, round robin over vifs and their links */
+	WL12XX_TX_SCHED_RR,
+	/* deficit round robin by airtime over the backlogged links */
+	WL12XX_TX_SCHED_DRR,
 };
 
 struct ap_peers {
@@ -371,8 +705,17 @@ struct wl1271 {
 	int cmd_box_addr;
 	int event_box_addr;
 
-	u8 *fw;
-	size_t fw_len;
+	/*
+	 * Parsed firmware images by type. They survive stop and recovery,
+	 * a boot only keeps the image it uploads and its role switch
+	 * counterpart.
+	 */
+	struct wl12xx_fw_image fw_cache[WL12XX_FW_TYPE_MAX];
+	/* the image the next boot uploads, points into fw_cache */
+	struct wl12xx_fw_image *fw;
+	/* done while no request for fw_preload_type is in flight */
+	struct completion fw_preload_compl;
+	enum wl12xx_fw_type fw_preload_type;
 	void *nvs;
 	size_t nvs_len;
 
@@ -405,6 +748,8 @@ struct wl1271 {
 	u32 tx_blocks_available;
 	u32 tx_allocated_blocks;
 	u32 tx_results_count;
+	/* last TX result counter written back to the FW */
+	u32 tx_results_acked;
 
 	/* Accounting for allocated / available Tx packets in HW */
 	u32 tx_pkts_freed[NUM_TX_QUEUES];
@@ -416,10 +761,21 @@ struct wl1271 {
 	/* Time-offset between host and chipset clocks */
 	s64 time_offset;
 
-	/* Frames scheduled for transmission, not handled yet */
-	int tx_queue_count[NUM_TX_QUEUES];
+	/*
+	 * Frames scheduled for transmission, not handled yet. Updated
+	 * without wl_lock, the link queues are protected by their own locks.
+	 */
+	atomic_t tx_queue_count[NUM_TX_QUEUES];
 	long stopped_queues_map;
 
+	/*
+	 * TX scheduler. tx_backlog has a bit per link with queued frames
+	 * in each AC, set under the link queue lock.
+	 */
+	enum wl12xx_tx_sched tx_sched;
+	unsigned long tx_backlog[NUM_TX_QUEUES][BITS_TO_LONGS(WL12XX_MAX_LINKS)];
+	u8 tx_drr_hlid[NUM_TX_QUEUES];
+
 	/* Frames received, not handled yet by mac80211 */
 	struct sk_buff_head deferred_rx_queue;
 
@@ -440,8 +796,28 @@ struct wl1271 {
 	/* Rx memory pool address */
 	struct wl1271_rx_mem_pool_addr *rx_mem_pool_addr;
 
-	/* Intermediate buffer, used for packet aggregation */
-	u8 *aggr_buf;
+	/* preallocated ACX command buffer, see wl1271_acx_alloc() */
+	void *acx_buf;
+	bool acx_buf_used;
+
+	/* Intermediate buffers, used for TX and RX packet aggregation */
+	u8 *tx_aggr_buf;
+	u32 tx_aggr_buf_size;
+	u8 *rx_aggr_buf;
+	u32 rx_aggr_buf_size;
+
+	/* Zero-copy TX - the burst is described by tx_sg, not tx_aggr_buf */
+	bool tx_sg_enabled;
+	struct scatterlist tx_sg[WL1271_TX_SG_MAX_ENTRIES];
+	unsigned int tx_sg_nents;
+
+	/* Zeroed buffer used to pad zero-copy TX frames to the bus alignment */
+	u8 *tx_pad_buf;
+
+	/* Zero-copy RX - bursts are read into a ring of page buffers */
+	bool rx_zerocopy;
+	struct page *rx_pages[WL1271_RX_PAGE_RING_SIZE];
+	unsigned int rx_page_idx;
 
 	/* Reusable dummy packet template */
 	struct sk_buff *dummy_packet;
@@ -449,11 +825,26 @@ struct wl1271 {
 	/* Network stack work  */
 	struct work_struct netstack_work;
 
-	/* FW log buffer */
-	u8 *fwlog;
+	/*
+	 * RX frames are delivered from a NAPI poll instead of netstack_work.
+	 * The IRQ thread schedules it once it released wl->mutex, and ends
+	 * its pass early once rx_napi_coalesce frames are pending. napi_dev
+	 * is a dummy device only there to host it.
+	 */
+	bool rx_napi;
+	unsigned int rx_napi_coalesce;
+	struct net_device napi_dev;
+	struct napi_struct napi;
+
+	/* FW log ring, see struct wl12xx_fwlog_ring */
+	struct wl12xx_fwlog_ring *fwlog;
 
-	/* Number of valid bytes in the FW log buffer */
-	ssize_t fwlog_size;
+	/* The device is going away, FW log readers must leave */
+	bool fwlog_closed;
+
+	/* bytes of the record at fwlog_rec_tail read() already returned */
+	u32 fwlog_rec_tail;
+	u32 fwlog_rec_off;
 
 	/* Sysfs FW log entry readers wait queue */
 	wait_queue_head_t fwlog_waitq;
@@ -461,9 +852,19 @@ struct wl1271 {
 	/* Hardware recovery work */
 	struct work_struct recovery_work;
 
-	/* Pointer that holds DMA-friendly block for the mailbox */
+	/* Pointer that holds DMA-friendly block for both mailboxes */
 	struct event_mailbox *mbox;
 
+	/* mailboxes read but not acked yet, see wl1271_event_ack_flush() */
+	u8 event_acks_pending;
+
+	/* events left to wl1271_event_work() and the mailbox data they need */
+	struct work_struct event_work;
+	u32 event_work_vector;
+	s8 event_rssi_metric;
+	u8 event_ba_roles;
+	u8 event_ba_allowed;
+
 	/* The mbox event mask */
 	u32 event_mask;
 
@@ -481,6 +882,32 @@ struct wl1271 {
 	enum ieee80211_band band;
 
 	struct completion *elp_compl;
+
+	/*
+	 * Adaptive ELP: when the chip was last allowed to sleep, averages of
+	 * the idle gaps and of the wakeup latency (usecs), the ELP entry
+	 * delay last chosen (msecs) and the current wakeup rate window.
+	 */
+	ktime_t elp_idle_start;
+	bool elp_idle_valid;
+
+	/*
+	 * A wakeup in progress: completed by the hardirq, which also stamps
+	 * when the chip came up, and waited for before the next bus access.
+	 */
+	struct completion elp_wake_compl;
+	ktime_t elp_wake_start;
+	ktime_t elp_wake_done;
+	u32 elp_gap_avg_us;
+	u32 elp_wake_avg_us;
+	u32 elp_entry_delay;
+	unsigned long elp_rate_start;
+	unsigned int elp_rate_count;
+
+	/* completed by the hardirq while a FW command is in flight */
+	struct completion *cmd_compl;
+	/* nesting of wl1271_disable_interrupts(), the IRQ is live at 0 */
+	atomic_t irq_disable_depth;
 	struct delayed_work elp_work;
 
 	struct completion fw_compl;
@@ -494,6 +921,20 @@ struct wl1271 {
 #endif
 
 	struct wl1271_stats stats;
+	struct wl12xx_pcpu_stats __percpu *pcpu_stats;
+#if BITS_PER_LONG == 32
+	struct u64_stats_sync __percpu *pcpu_syncp;
+#endif
+
+	/*
+	 * FW statistics are read into fw_stats_buf and copied to
+	 * stats.fw_stats under fw_stats_lock, so readers get a consistent
+	 * copy without wl->mutex. fw_stats_work refreshes them periodically
+	 * while the chip is awake.
+	 */
+	struct acx_statistics *fw_stats_buf;
+	spinlock_t fw_stats_lock;
+	struct delayed_work fw_stats_work;
 
 	__le32 *buffer_32;
 	u32 buffer_cmd;
@@ -571,6 +1012,18 @@ struct wl1271 {
 	struct delayed_work tx_watchdog_work;
 
 	struct timeval start_recovery_time;
+
+	/* a recovery restarted the HW and the next boot closes it */
+	bool recovery_boot_pending;
+
+	/* the queued recovery may try the light tier first */
+	bool recovery_light_ok;
+	/* when the last light recovery succeeded, in jiffies */
+	unsigned long recovery_light_last;
+
+	/* interface brought the chip up, waiting for its first frame */
+	bool ttff_pending;
+	unsigned long ttff_start;
 };
 
 struct wl1271_station {
@@ -734,6 +1187,7 @@ int wl1271_plt_stop(struct wl1271 *wl);
 int wl1271_recalc_rx_streaming(struct wl1271 *wl, struct wl12xx_vif *wlvif);
 void wl12xx_queue_recovery_work(struct wl1271 *wl);
 size_t wl12xx_copy_fwlog(struct wl1271 *wl, u8 *memblock, size_t maxlen);
+void wl12xx_fwlog_notify(struct wl1271 *wl);
 int wl1271_rx_filter_alloc_field(struct wl12xx_rx_data_filter *filter,
 					u16 offset, u8 flags,
 					u8 *pattern, u8 len);
@@ -750,6 +1204,9 @@ void wl12xx_update_sta_state(struct wl1271 *wl,
 			     enum ieee80211_sta_state state);
 int wl12xx_init_pll_clock(struct wl1271 *wl, int *selected_clock);
 int wl12xx_request_irq(struct wl1271 *wl);
+int wl12xx_set_aggr_buf_size(struct wl1271 *wl, bool tx, u32 size);
+void wl12xx_ttff_done(struct wl1271 *wl);
+int wl12xx_update_fw_stats(struct wl1271 *wl);
 void wl12xx_free_irq(struct wl1271 *wl);
 
 #define JOIN_TIMEOUT 5000 /* 5000 milliseconds to join */
@@ -762,6 +1219,13 @@ void wl12xx_free_irq(struct wl1271 *wl);
 #define WL1271_TX_QUEUE_LOW_WATERMARK  32
 #define WL1271_TX_QUEUE_HIGH_WATERMARK 256
 
+/*
+ * DRR credit a link gets per round, in bytes at the reference rate (54
+ * Mbps). Frames to slower links cost proportionally more.
+ */
+#define WL12XX_TX_DRR_QUANTUM  1536
+#define WL12XX_TX_DRR_REF_RATE 540
+
 #define WL1271_DEFERRED_QUEUE_LIMIT    64
 
 /* WL1271 needs a 200ms sleep after power on, and a 20ms sleep before power
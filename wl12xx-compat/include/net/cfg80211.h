@@ -595,7 +595,8 @@ struct sta_bss_parameters {
 /**
  * struct station_info - station information
  *
- * Station information filled by driver for get_station() and dump_station.
+ * Station information filled by driver for get_station(), dump_station()
+ * and dump_stations().
  *
  * @filled: bitflag of flags from &enum station_info_flags
  * @connected_time: time(in secs) since a station is last connected
@@ -661,6 +662,34 @@ struct station_info {
 	 */
 };
 
+/**
+ * struct station_dump_cursor - resume point of a station dump
+ *
+ * Passed to dump_stations() so the driver can continue right after the
+ * last station reported instead of counting its way there from the start
+ * of its list.
+ *
+ * @idx: number of stations reported so far, 0 at the start of the dump
+ * @generation: station list generation of the last station reported
+ * @mac: address of the last station reported, valid when @idx is nonzero
+ */
+struct station_dump_cursor {
+	int idx;
+	int generation;
+	u8 mac[ETH_ALEN];
+};
+
+/**
+ * struct station_dump_entry - station reported by dump_stations()
+ *
+ * @mac: address of the station
+ * @sinfo: station information, as get_station() would fill it
+ */
+struct station_dump_entry {
+	u8 mac[ETH_ALEN];
+	struct station_info sinfo;
+};
+
 /**
  * enum monitor_flags - monitor flags
  *
@@ -1373,6 +1402,11 @@ struct cfg80211_gtk_rekey_data {
  *	for anything but TDLS peers.
  * @get_station: get station information for the station identified by @mac
  * @dump_station: dump station callback -- resume dump at index @idx
+ * @dump_stations: dump stations in batches -- fill up to @n_entries of
+ *	@entries with the stations following the one at @cursor, all from a
+ *	single walk of the station list. Returns the number of entries filled,
+ *	0 once there are no stations left, or a negative error code. Used
+ *	instead of @dump_station when implemented.
  *
  * @add_mpath: add a fixed mesh path
  * @del_mpath: delete a given mesh path
@@ -1546,6 +1580,10 @@ struct cfg80211_ops {
 			       u8 *mac, struct station_info *sinfo);
 	int	(*dump_station)(struct wiphy *wiphy, struct net_device *dev,
 			       int idx, u8 *mac, struct station_info *sinfo);
+	int	(*dump_stations)(struct wiphy *wiphy, struct net_device *dev,
+				 const struct station_dump_cursor *cursor,
+				 struct station_dump_entry *entries,
+				 int n_entries);
 
 	int	(*add_mpath)(struct wiphy *wiphy, struct net_device *dev,
 			       u8 *dst, u8 *next_hop);
@@ -2519,12 +2557,16 @@ int ieee80211_data_from_8023(struct sk_buff *skb, const u8 *addr,
  * 802.3 frames. The @list will be empty if the decode fails. The
  * @skb is consumed after the function returns.
  *
+ * The payload is not copied: the subframes of a linear @skb are clones
+ * sharing its buffer, those of a non-linear one reference its pages.
+ *
  * @skb: The input IEEE 802.11n A-MSDU frame.
  * @list: The output list of 802.3 frames. It must be allocated and
  *	initialized by by the caller.
  * @addr: The device MAC address.
  * @iftype: The device interface type.
- * @extra_headroom: The hardware extra headroom for SKBs in the @list.
+ * @extra_headroom: The hardware extra headroom for SKBs in the @list
+ *	that get a buffer of their own.
  * @has_80211_header: Set it true if SKB is with IEEE 802.11 header.
  */
 void ieee80211_amsdu_to_8023s(struct sk_buff *skb, struct sk_buff_head *list,
@@ -2541,6 +2541,43 @@ static inline void ieee80211_rx_ni(struct ieee80211_hw *hw,
 	local_bh_enable();
 }
 
+/**
+ * ieee80211_rx_list - receive a burst of frames
+ *
+ * Like ieee80211_rx() but takes all frames the hardware handed over in one
+ * go. The transmitter lookup is shared between consecutive frames from the
+ * same station and the frames are passed to the network stack together once
+ * all of them went through the receive handlers, via GRO when @napi is set.
+ *
+ * This function may not be called in IRQ context. Calls to this function,
+ * ieee80211_rx() and ieee80211_rx_ni() may be mixed for a single hardware,
+ * calls to this function and ieee80211_rx_irqsafe() may not.
+ *
+ * @hw: the hardware the frames came in on
+ * @skbs: the frames to receive, in order, the list is empty on return
+ *	and the buffers are owned by mac80211
+ * @napi: the NAPI context the driver is polling in, or %NULL
+ */
+void ieee80211_rx_list(struct ieee80211_hw *hw, struct sk_buff_head *skbs,
+		       struct napi_struct *napi);
+
+/**
+ * ieee80211_rx_list_ni - receive a burst of frames (in process context)
+ *
+ * Like ieee80211_rx_list() but can be called in process context
+ * (internally disables bottom halves).
+ *
+ * @hw: the hardware the frames came in on
+ * @skbs: the frames to receive, the list is empty on return
+ */
+static inline void ieee80211_rx_list_ni(struct ieee80211_hw *hw,
+					struct sk_buff_head *skbs)
+{
+	local_bh_disable();
+	ieee80211_rx_list(hw, skbs, NULL);
+	local_bh_enable();
+}
+
 /**
  * ieee80211_sta_ps_transition - PS transition for connected sta
  *
@@ -460,6 +460,30 @@ static int ieee80211_dump_station(struct wiphy *wiphy, struct net_device *dev,
 	return ret;
 }
 
+static int ieee80211_dump_stations(struct wiphy *wiphy,
+				   struct net_device *dev,
+				   const struct station_dump_cursor *cursor,
+				   struct station_dump_entry *entries,
+				   int n_entries)
+{
+	struct ieee80211_sub_if_data *sdata = IEEE80211_DEV_TO_SUB_IF(dev);
+	struct sta_info *sta;
+	int n = 0;
+
+	rcu_read_lock();
+
+	for (sta = sta_info_dump_resume(sdata, cursor);
+	     sta && n < n_entries;
+	     sta = sta_info_dump_next(sdata, sta), n++) {
+		memcpy(entries[n].mac, sta->sta.addr, ETH_ALEN);
+		sta_set_sinfo(sta, &entries[n].sinfo);
+	}
+
+	rcu_read_unlock();
+
+	return n;
+}
+
 static int ieee80211_dump_survey(struct wiphy *wiphy, struct net_device *dev,
 				 int idx, struct survey_info *survey)
 {
@@ -2740,6 +2764,7 @@ struct cfg80211_ops mac80211_config_ops = {
 	.change_station = ieee80211_change_station,
 	.get_station = ieee80211_get_station,
 	.dump_station = ieee80211_dump_station,
+	.dump_stations = ieee80211_dump_stations,
 	.dump_survey = ieee80211_dump_survey,
 #ifdef CONFIG_MAC80211_MESH
 	.add_mpath = ieee80211_add_mpath,
@@ -10,6 +10,10 @@
 
 #include <linux/debugfs.h>
 #include <linux/rtnetlink.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/log2.h>
+#include <linux/ktime.h>
 #include "ieee80211_i.h"
 #include "driver-ops.h"
 #include "rate.h"
@@ -291,6 +295,292 @@ static ssize_t queues_read(struct file *file, char __user *user_buf,
 	return simple_read_from_buffer(user_buf, count, ppos, buf, res);
 }
 
+/* chains of this length and longer share the last histogram bucket */
+#define STA_HASH_HIST_LEN 8
+
+static ssize_t sta_hash_read(struct file *file, char __user *user_buf,
+			     size_t count, loff_t *ppos)
+{
+	struct ieee80211_local *local = file->private_data;
+	unsigned int hist[STA_HASH_HIST_LEN] = {};
+	unsigned int i, len, size, stations, used = 0, longest = 0;
+	struct sta_hash_table *tbl;
+	struct sta_info *sta;
+	u64 cost = 0;
+	char buf[256];
+	int res;
+
+	rcu_read_lock();
+	tbl = rcu_dereference(local->sta_hash);
+	size = tbl->size;
+	stations = tbl->count;
+	for (i = 0; i < size; i++) {
+		len = 0;
+		for (sta = rcu_dereference(tbl->buckets[i]); sta;
+		     sta = rcu_dereference(sta->hnext[tbl->idx]))
+			len++;
+
+		if (len)
+			used++;
+		longest = max(longest, len);
+		/* entries visited by the lookups of all stations of a chain */
+		cost += len * (len + 1) / 2;
+		hist[min_t(unsigned int, len, STA_HASH_HIST_LEN - 1)]++;
+	}
+	rcu_read_unlock();
+
+	res = scnprintf(buf, sizeof(buf),
+			"buckets: %u stations: %u resizes: %u\n"
+			"used buckets: %u longest chain: %u\n"
+			"entries per lookup (x100): %llu\n"
+			"chain length histogram:",
+			size, stations, local->sta_hash_resizes, used, longest,
+			stations ? div_u64(cost * 100, stations) : 0ULL);
+	for (i = 0; i < STA_HASH_HIST_LEN; i++)
+		res += scnprintf(buf + res, sizeof(buf) - res, " %u", hist[i]);
+	res += scnprintf(buf + res, sizeof(buf) - res, "\n");
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, res);
+}
+
+/*
+ * Station hash benchmark: stations with MAC addresses laid out the way
+ * they show up in practice go into the former 256 bucket table indexed by
+ * addr[5] and into a jhash table sized like local->sta_hash would be, then
+ * each of them is looked up. Opening the file runs it, reads return the
+ * report.
+ */
+#define STA_BENCH_LOOKUPS	100000
+#define STA_BENCH_LEGACY_SIZE	256
+
+enum sta_bench_dist {
+	STA_BENCH_RANDOM,
+	STA_BENCH_SEQUENTIAL,
+	STA_BENCH_STRIDE16,
+	STA_BENCH_STRIDE256,
+	STA_BENCH_DIST_MAX
+};
+
+static const char * const sta_bench_dist_names[STA_BENCH_DIST_MAX] = {
+	[STA_BENCH_RANDOM]	= "random",
+	[STA_BENCH_SEQUENTIAL]	= "sequential",
+	[STA_BENCH_STRIDE16]	= "stride16",
+	[STA_BENCH_STRIDE256]	= "stride256",
+};
+
+static const unsigned int sta_bench_stations[] = { 64, 256, 1024 };
+
+struct sta_bench {
+	struct sta_info *stas;
+	unsigned int num;
+	struct sta_info *legacy[STA_BENCH_LEGACY_SIZE];
+	struct sta_hash_table *tbl;
+};
+
+/*
+ * random: clients of a few vendors, sequential: one vendor allocating in
+ * order, stride16/256: devices that reserve a block of addresses each
+ */
+static void sta_bench_addr(u8 *addr, enum sta_bench_dist dist,
+			   unsigned int i)
+{
+	static const u8 ouis[][3] = {
+		{ 0x00, 0x1a, 0x11 }, { 0x3c, 0x5a, 0xb4 },
+		{ 0xf0, 0x9f, 0xc2 }, { 0x00, 0x24, 0xd7 },
+	};
+	u32 nic;
+
+	switch (dist) {
+	case STA_BENCH_RANDOM:
+		memcpy(addr, ouis[i % ARRAY_SIZE(ouis)], 3);
+		get_random_bytes(addr + 3, 3);
+		return;
+	case STA_BENCH_SEQUENTIAL:
+		nic = 0x123400 + i;
+		break;
+	case STA_BENCH_STRIDE16:
+		nic = 0x123400 + i * 16;
+		break;
+	default:
+		nic = 0x120056 + i * 256;
+		break;
+	}
+
+	memcpy(addr, ouis[0], 3);
+	addr[3] = nic >> 16;
+	addr[4] = nic >> 8;
+	addr[5] = nic;
+}
+
+static int sta_bench_build(struct sta_bench *b, enum sta_bench_dist dist,
+			   unsigned int num)
+{
+	unsigned int i, bucket, size;
+	struct sta_info *sta;
+
+	size = clamp_t(unsigned int, roundup_pow_of_two(num),
+		       STA_HASH_MIN_SIZE, STA_HASH_MAX_SIZE);
+	b->tbl = kzalloc(sizeof(*b->tbl) + size * sizeof(b->tbl->buckets[0]),
+			 GFP_KERNEL);
+	if (!b->tbl)
+		return -ENOMEM;
+
+	b->tbl->size = size;
+	get_random_bytes(&b->tbl->seed, sizeof(b->tbl->seed));
+	memset(b->legacy, 0, sizeof(b->legacy));
+	b->num = num;
+
+	/* hnext[0] chains the jhash table, hnext[1] the legacy one */
+	for (i = 0; i < num; i++) {
+		sta = &b->stas[i];
+		sta_bench_addr(sta->sta.addr, dist, i);
+
+		bucket = sta_hash_bucket(b->tbl, sta->sta.addr);
+		RCU_INIT_POINTER(sta->hnext[0], b->tbl->buckets[bucket]);
+		RCU_INIT_POINTER(b->tbl->buckets[bucket], sta);
+
+		sta->hnext[1] = b->legacy[sta->sta.addr[5]];
+		b->legacy[sta->sta.addr[5]] = sta;
+	}
+
+	return 0;
+}
+
+static u64 sta_bench_lookup(struct sta_bench *b, bool legacy, u64 *entries,
+			    unsigned int *lookups)
+{
+	unsigned int rounds = DIV_ROUND_UP(STA_BENCH_LOOKUPS, b->num);
+	unsigned int r, i;
+	struct sta_info *sta;
+	const u8 *addr;
+	ktime_t start;
+
+	*entries = 0;
+	*lookups = rounds * b->num;
+
+	start = ktime_get();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < b->num; i++) {
+			addr = b->stas[i].sta.addr;
+			if (legacy)
+				sta = b->legacy[addr[5]];
+			else
+				sta = rcu_dereference_raw(b->tbl->buckets[
+					sta_hash_bucket(b->tbl, addr)]);
+
+			for (; sta; sta = rcu_dereference_raw(
+					sta->hnext[legacy ? 1 : 0])) {
+				(*entries)++;
+				if (memcmp(sta->sta.addr, addr, ETH_ALEN) == 0)
+					break;
+			}
+		}
+	}
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int sta_hash_bench_open(struct inode *inode, struct file *file)
+{
+	unsigned int offset = 0, buf_size = PAGE_SIZE, lookups, n;
+	struct sta_bench *b;
+	enum sta_bench_dist dist;
+	u64 ns[2], entries[2];
+	int legacy, err = 0;
+	char *buf;
+
+	buf = kzalloc(buf_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	b = kzalloc(sizeof(*b), GFP_KERNEL);
+	if (!b) {
+		err = -ENOMEM;
+		goto out_buf;
+	}
+
+	n = sta_bench_stations[ARRAY_SIZE(sta_bench_stations) - 1];
+	b->stas = vzalloc(n * sizeof(*b->stas));
+	if (!b->stas) {
+		err = -ENOMEM;
+		goto out_bench;
+	}
+
+	offset += scnprintf(buf + offset, buf_size - offset,
+			    "addresses  stations buckets "
+			    "legacy ns/lookup entries/lookup(x100) "
+			    "jhash ns/lookup entries/lookup(x100)\n");
+
+	for (dist = 0; dist < STA_BENCH_DIST_MAX && !err; dist++) {
+		for (n = 0; n < ARRAY_SIZE(sta_bench_stations); n++) {
+			err = sta_bench_build(b, dist, sta_bench_stations[n]);
+			if (err)
+				break;
+
+			for (legacy = 0; legacy <= 1; legacy++)
+				ns[legacy] = sta_bench_lookup(b, legacy,
+							      &entries[legacy],
+							      &lookups);
+
+			offset += scnprintf(buf + offset, buf_size - offset,
+					    "%-10s %8u %7u %16llu %23llu "
+					    "%15llu %22llu\n",
+					    sta_bench_dist_names[dist], b->num,
+					    b->tbl->size,
+					    div_u64(ns[1], lookups),
+					    div_u64(entries[1] * 100, lookups),
+					    div_u64(ns[0], lookups),
+					    div_u64(entries[0] * 100, lookups));
+
+			kfree(b->tbl);
+		}
+	}
+
+	vfree(b->stas);
+
+	if (err)
+		offset += scnprintf(buf + offset, buf_size - offset,
+				    "failed: %d\n", err);
+	kfree(b);
+
+	file->private_data = buf;
+	return 0;
+
+ out_bench:
+	kfree(b);
+ out_buf:
+	kfree(buf);
+	return err;
+}
+
+static ssize_t sta_hash_bench_read(struct file *file, char __user *user_buf,
+				   size_t count, loff_t *ppos)
+{
+	char *buf = file->private_data;
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf,
+				       strlen(buf));
+}
+
+static int sta_hash_bench_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations sta_hash_ops = {
+	.read = sta_hash_read,
+	.open = mac80211_open_file_generic,
+	.llseek = default_llseek,
+};
+
+static const struct file_operations sta_hash_bench_ops = {
+	.read = sta_hash_bench_read,
+	.open = sta_hash_bench_open,
+	.release = sta_hash_bench_release,
+	.llseek = default_llseek,
+};
+
 DEBUGFS_READONLY_FILE_OPS(hwflags);
 DEBUGFS_READONLY_FILE_OPS(channel_type);
 DEBUGFS_READONLY_FILE_OPS(queues);
@@ -370,6 +660,8 @@ void debugfs_hw_add(struct ieee80211_local *local)
 	DEBUGFS_ADD(hwflags);
 	DEBUGFS_ADD(user_power);
 	DEBUGFS_ADD(power);
+	DEBUGFS_ADD(sta_hash);
+	DEBUGFS_ADD(sta_hash_bench);
 
 	statsd = debugfs_create_dir("statistics", phyd);
 
@@ -428,6 +720,10 @@ void debugfs_hw_add(struct ieee80211_local *local)
 		local->rx_handlers_fragments);
 	DEBUGFS_STATS_ADD(tx_status_drop,
 		local->tx_status_drop);
+	DEBUGFS_STATS_ADD(rx_list_frames,
+		local->rx_list_frames);
+	DEBUGFS_STATS_ADD(rx_list_sta_cached,
+		local->rx_list_sta_cached);
 #endif
 	DEBUGFS_DEVSTATS_ADD(dot11ACKFailureCount);
 	DEBUGFS_DEVSTATS_ADD(dot11RTSFailureCount);
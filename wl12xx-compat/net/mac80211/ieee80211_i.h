@@ -219,6 +219,9 @@ struct ieee80211_rx_data {
 
 	u32 tkip_iv32;
 	u16 tkip_iv16;
+
+	/* frames for the local stack are queued here instead, if set */
+	struct sk_buff_head *deliver;
 };
 
 struct beacon_data {
@@ -869,7 +872,10 @@ struct ieee80211_local {
 	spinlock_t tim_lock;
 	unsigned long num_sta;
 	struct list_head sta_list;
-	struct sta_info __rcu *sta_hash[STA_HASH_SIZE];
+	struct sta_hash_table __rcu *sta_hash;
+	/* the previous table may still be walked, don't resize yet */
+	atomic_t sta_hash_resize_pending;
+	unsigned int sta_hash_resizes;
 	struct timer_list sta_cleanup;
 	int sta_generation;
 
@@ -966,6 +972,8 @@ struct ieee80211_local {
 	unsigned int rx_expand_skb_head2;
 	unsigned int rx_handlers_fragments;
 	unsigned int tx_status_drop;
+	unsigned int rx_list_frames;
+	unsigned int rx_list_sta_cached;
 #define I802_DEBUG_INC(c) (c)++
 #else /* CONFIG_MAC80211_DEBUG_COUNTERS */
 #define I802_DEBUG_INC(c) do { } while (0)
@@ -286,7 +286,8 @@ u32 ieee80211_reset_erp_info(struct ieee80211_sub_if_data *sdata)
 static void ieee80211_tasklet_handler(unsigned long data)
 {
 	struct ieee80211_local *local = (struct ieee80211_local *) data;
-	struct sta_info *sta, *tmp;
+	struct sta_hash_table *tbl;
+	struct sta_info *sta;
 	struct skb_eosp_msg_data *eosp_data;
 	struct sk_buff *skb;
 
@@ -305,7 +306,7 @@ static void ieee80211_tasklet_handler(unsigned long data)
 			break;
 		case IEEE80211_EOSP_MSG:
 			eosp_data = (void *)skb->cb;
-			for_each_sta_info(local, eosp_data->sta, sta, tmp) {
+			for_each_sta_info(local, eosp_data->sta, sta, tbl) {
 				/* skip wrong virtual interface */
 				if (memcmp(eosp_data->iface,
 					   sta->sdata->vif.addr, ETH_ALEN))
@@ -662,7 +663,11 @@ struct ieee80211_hw *ieee80211_alloc_hw(size_t priv_data_len,
 	/* preallocate at least one entry */
 	idr_pre_get(&local->ack_status_frames, GFP_KERNEL);
 
-	sta_info_init(local);
+	if (sta_info_init(local)) {
+		idr_destroy(&local->ack_status_frames);
+		wiphy_free(wiphy);
+		return NULL;
+	}
 
 	for (i = 0; i < IEEE80211_MAX_QUEUES; i++) {
 		skb_queue_head_init(&local->pending[i]);
@@ -1069,6 +1074,8 @@ void ieee80211_free_hw(struct ieee80211_hw *hw)
 		     ieee80211_free_ack_frame, NULL);
 	idr_destroy(&local->ack_status_frames);
 
+	sta_info_deinit(local);
+
 	wiphy_free(local->hw.wiphy);
 }
 EXPORT_SYMBOL(ieee80211_free_hw);
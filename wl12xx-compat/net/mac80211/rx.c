@@ -1822,7 +1822,10 @@ ieee80211_deliver_skb(struct ieee80211_rx_data *rx)
 			/* deliver to local stack */
 			skb->protocol = eth_type_trans(skb, dev);
 			memset(skb->cb, 0, sizeof(skb->cb));
-			netif_receive_skb(skb);
+			if (rx->deliver)
+				__skb_queue_tail(rx->deliver, skb);
+			else
+				netif_receive_skb(skb);
 		}
 	}
 
@@ -1869,9 +1872,7 @@ ieee80211_rx_h_amsdu(struct ieee80211_rx_data *rx)
 	skb->dev = dev;
 	__skb_queue_head_init(&frame_list);
 
-	if (skb_linearize(skb))
-		return RX_DROP_UNUSABLE;
-
+	/* the subframes reference the A-MSDU buffer, it needn't be linear */
 	ieee80211_amsdu_to_8023s(skb, &frame_list, dev->dev_addr,
 				 rx->sdata->vif.type,
 				 rx->local->hw.extra_tx_headroom, true);
@@ -2924,12 +2925,24 @@ static bool ieee80211_prepare_and_rx_handle(struct ieee80211_rx_data *rx,
 	return true;
 }
 
+/*
+ * Station a burst of frames handed over through ieee80211_rx_list() was
+ * last received from, valid for as long as the RCU read-side section the
+ * whole burst is processed in.
+ */
+struct ieee80211_rx_cache {
+	struct sta_info *sta;
+	u8 addr[ETH_ALEN];
+};
+
 /*
  * This is the actual Rx frames handler. as it blongs to Rx path it must
  * be called with rcu_read_lock protection.
  */
 static void __ieee80211_rx_handle_packet(struct ieee80211_hw *hw,
-					 struct sk_buff *skb)
+					 struct sk_buff *skb,
+					 struct ieee80211_rx_cache *cache,
+					 struct sk_buff_head *deliver)
 {
 	struct ieee80211_rx_status *status = IEEE80211_SKB_RXCB(skb);
 	struct ieee80211_local *local = hw_to_local(hw);
@@ -2938,13 +2951,16 @@ static void __ieee80211_rx_handle_packet(struct ieee80211_hw *hw,
 	__le16 fc;
 	struct ieee80211_rx_data rx;
 	struct ieee80211_sub_if_data *prev;
-	struct sta_info *sta, *tmp, *prev_sta;
+	struct sta_hash_table *tbl;
+	struct sta_info *sta, *prev_sta;
+	bool shared;
 	int err = 0;
 
 	fc = ((struct ieee80211_hdr *)skb->data)->frame_control;
 	memset(&rx, 0, sizeof(rx));
 	rx.skb = skb;
 	rx.local = local;
+	rx.deliver = deliver;
 
 	if (ieee80211_is_data(fc) || ieee80211_is_mgmt(fc))
 		local->dot11ReceivedFragmentCount++;
@@ -2968,9 +2984,27 @@ static void __ieee80211_rx_handle_packet(struct ieee80211_hw *hw,
 	ieee80211_verify_alignment(&rx);
 
 	if (ieee80211_is_data(fc)) {
+		/*
+		 * Consecutive data frames of a burst nearly always come
+		 * from the same transmitter, skip the hash walk for them.
+		 * Per-TID state hangs off the station, so that is all
+		 * there is to look up.
+		 */
+		if (cache && cache->sta &&
+		    !compare_ether_addr(cache->addr, hdr->addr2)) {
+			I802_DEBUG_INC(local->rx_list_sta_cached);
+			rx.sta = cache->sta;
+			rx.sdata = cache->sta->sdata;
+
+			if (ieee80211_prepare_and_rx_handle(&rx, skb, true))
+				return;
+			goto out;
+		}
+
 		prev_sta = NULL;
+		shared = false;
 
-		for_each_sta_info_rx(local, hdr->addr2, sta, tmp) {
+		for_each_sta_info_rx(local, hdr->addr2, sta, tbl) {
 			if (!prev_sta) {
 				prev_sta = sta;
 				continue;
@@ -2981,6 +3015,14 @@ static void __ieee80211_rx_handle_packet(struct ieee80211_hw *hw,
 			ieee80211_prepare_and_rx_handle(&rx, skb, false);
 
 			prev_sta = sta;
+			shared = true;
+		}
+
+		/* only a station known on a single interface is cached */
+		if (cache) {
+			cache->sta = shared ? NULL : prev_sta;
+			if (cache->sta)
+				memcpy(cache->addr, hdr->addr2, ETH_ALEN);
 		}
 
 		if (prev_sta) {
@@ -3034,18 +3076,19 @@ static void __ieee80211_rx_handle_packet(struct ieee80211_hw *hw,
 }
 
 /*
- * This is the receive path handler. It is called by a low level driver when an
- * 802.11 MPDU is received from the hardware.
+ * Validates a frame received from the hardware and passes it through the
+ * monitor interfaces and on to the handlers, must be called with
+ * rcu_read_lock protection.
  */
-void ieee80211_rx(struct ieee80211_hw *hw, struct sk_buff *skb)
+static void ieee80211_rx_one(struct ieee80211_hw *hw, struct sk_buff *skb,
+			     struct ieee80211_rx_cache *cache,
+			     struct sk_buff_head *deliver)
 {
 	struct ieee80211_local *local = hw_to_local(hw);
 	struct ieee80211_rate *rate = NULL;
 	struct ieee80211_supported_band *sband;
 	struct ieee80211_rx_status *status = IEEE80211_SKB_RXCB(skb);
 
-	WARN_ON_ONCE(softirq_count() == 0);
-
 	if (WARN_ON(status->band < 0 ||
 		    status->band >= IEEE80211_NUM_BANDS))
 		goto drop;
@@ -3110,13 +3153,6 @@ void ieee80211_rx(struct ieee80211_hw *hw, struct sk_buff *skb)
 
 	status->rx_flags = 0;
 
-	/*
-	 * key references and virtual interfaces are protected using RCU
-	 * and this requires that we are in a read-side RCU section during
-	 * receive processing
-	 */
-	rcu_read_lock();
-
 	/*
 	 * Frames with failed FCS/PLCP checksum are not returned,
 	 * all other frames are returned without radiotap header
@@ -3124,28 +3160,79 @@ void ieee80211_rx(struct ieee80211_hw *hw, struct sk_buff *skb)
 	 * Also, frames with less than 16 bytes are dropped.
 	 */
 	skb = ieee80211_rx_monitor(local, skb, rate);
-	if (!skb) {
-		rcu_read_unlock();
+	if (!skb)
 		return;
-	}
 
 	ieee80211_tpt_led_trig_rx(local,
 			((struct ieee80211_hdr *)skb->data)->frame_control,
 			skb->len);
-	__ieee80211_rx_handle_packet(hw, skb);
-
-	rcu_read_unlock();
+	__ieee80211_rx_handle_packet(hw, skb, cache, deliver);
 
 	return;
  drop:
 	kfree_skb(skb);
 }
+
+/*
+ * This is the receive path handler. It is called by a low level driver when an
+ * 802.11 MPDU is received from the hardware.
+ */
+void ieee80211_rx(struct ieee80211_hw *hw, struct sk_buff *skb)
+{
+	WARN_ON_ONCE(softirq_count() == 0);
+
+	/*
+	 * key references and virtual interfaces are protected using RCU
+	 * and this requires that we are in a read-side RCU section during
+	 * receive processing
+	 */
+	rcu_read_lock();
+	ieee80211_rx_one(hw, skb, NULL, NULL);
+	rcu_read_unlock();
+}
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,32))
 EXPORT_SYMBOL(ieee80211_rx);
 #else
 EXPORT_SYMBOL(mac80211_ieee80211_rx);
 #endif
 
+/*
+ * Receive path handler for a burst of MPDUs. The whole burst is handled in
+ * one RCU read-side section, the transmitter lookup is shared between
+ * consecutive frames and the resulting frames only go up to the network
+ * stack once the burst is through the handlers, through GRO if the driver
+ * polls with NAPI.
+ */
+void ieee80211_rx_list(struct ieee80211_hw *hw, struct sk_buff_head *skbs,
+		       struct napi_struct *napi)
+{
+	struct ieee80211_local *local = hw_to_local(hw);
+	struct ieee80211_rx_cache cache = { .sta = NULL };
+	struct sk_buff_head deliver;
+	struct sk_buff *skb;
+
+	WARN_ON_ONCE(softirq_count() == 0);
+
+	__skb_queue_head_init(&deliver);
+
+	rcu_read_lock();
+
+	while ((skb = __skb_dequeue(skbs))) {
+		I802_DEBUG_INC(local->rx_list_frames);
+		ieee80211_rx_one(hw, skb, &cache, &deliver);
+	}
+
+	while ((skb = __skb_dequeue(&deliver))) {
+		if (napi)
+			napi_gro_receive(napi, skb);
+		else
+			netif_receive_skb(skb);
+	}
+
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL(ieee80211_rx_list);
+
 
 /* This is a version of the rx handler that can be called from hard irq
  * context. Post the skb on the queue and schedule the tasklet */
@@ -16,6 +16,7 @@
 #include <linux/if_arp.h>
 #include <linux/timer.h>
 #include <linux/rtnetlink.h>
+#include <linux/random.h>
 
 #include <net/mac80211.h>
 #include "ieee80211_i.h"
@@ -62,70 +63,142 @@
  * freed before they are done using it.
  */
 
+static struct sta_hash_table *sta_hash_alloc(struct ieee80211_local *local,
+					     unsigned int size, u8 idx)
+{
+	struct sta_hash_table *tbl;
+
+	/* may be called with the RCU read lock held */
+	tbl = kzalloc(sizeof(*tbl) + size * sizeof(tbl->buckets[0]),
+		      GFP_ATOMIC);
+	if (!tbl)
+		return NULL;
+
+	tbl->local = local;
+	tbl->size = size;
+	tbl->idx = idx;
+	get_random_bytes(&tbl->seed, sizeof(tbl->seed));
+
+	return tbl;
+}
+
+static void sta_hash_free_rcu(struct rcu_head *h)
+{
+	struct sta_hash_table *tbl =
+		container_of(h, struct sta_hash_table, rcu_head);
+
+	atomic_set(&tbl->local->sta_hash_resize_pending, 0);
+	kfree(tbl);
+}
+
+/* Caller must hold local->sta_mtx */
+static void sta_info_hash_resize(struct ieee80211_local *local,
+				 unsigned int size)
+{
+	struct sta_hash_table *old, *new;
+	struct sta_info *sta, *next;
+	unsigned int i, bucket;
+
+	if (atomic_read(&local->sta_hash_resize_pending))
+		return;
+
+	old = rcu_dereference_protected(local->sta_hash,
+					lockdep_is_held(&local->sta_mtx));
+	new = sta_hash_alloc(local, size, !old->idx);
+	if (!new)
+		return;
+
+	for (i = 0; i < old->size; i++) {
+		sta = rcu_dereference_protected(old->buckets[i],
+					lockdep_is_held(&local->sta_mtx));
+		for (; sta; sta = next) {
+			next = rcu_dereference_protected(sta->hnext[old->idx],
+					lockdep_is_held(&local->sta_mtx));
+			bucket = sta_hash_bucket(new, sta->sta.addr);
+			RCU_INIT_POINTER(sta->hnext[new->idx],
+					 new->buckets[bucket]);
+			RCU_INIT_POINTER(new->buckets[bucket], sta);
+		}
+	}
+	new->count = old->count;
+
+	atomic_set(&local->sta_hash_resize_pending, 1);
+	rcu_assign_pointer(local->sta_hash, new);
+	call_rcu(&old->rcu_head, sta_hash_free_rcu);
+	local->sta_hash_resizes++;
+}
+
 /* Caller must hold local->sta_mtx */
 static int sta_info_hash_del(struct ieee80211_local *local,
 			     struct sta_info *sta)
 {
+	struct sta_hash_table *tbl;
+	struct sta_info __rcu **prev;
 	struct sta_info *s;
 
-	s = rcu_dereference_protected(local->sta_hash[STA_HASH(sta->sta.addr)],
-				      lockdep_is_held(&local->sta_mtx));
+	tbl = rcu_dereference_protected(local->sta_hash,
+					lockdep_is_held(&local->sta_mtx));
+	prev = &tbl->buckets[sta_hash_bucket(tbl, sta->sta.addr)];
+
+	while ((s = rcu_dereference_protected(*prev,
+				lockdep_is_held(&local->sta_mtx)))) {
+		if (s == sta)
+			break;
+		prev = &s->hnext[tbl->idx];
+	}
+
 	if (!s)
 		return -ENOENT;
-	if (s == sta) {
-		RCU_INIT_POINTER(local->sta_hash[STA_HASH(sta->sta.addr)],
-				   s->hnext);
-		return 0;
-	}
 
-	while (rcu_access_pointer(s->hnext) &&
-	       rcu_access_pointer(s->hnext) != sta)
-		s = rcu_dereference_protected(s->hnext,
-					lockdep_is_held(&local->sta_mtx));
-	if (rcu_access_pointer(s->hnext)) {
-		RCU_INIT_POINTER(s->hnext, sta->hnext);
-		return 0;
-	}
+	RCU_INIT_POINTER(*prev, sta->hnext[tbl->idx]);
+
+	if (--tbl->count < tbl->size / 4 && tbl->size > STA_HASH_MIN_SIZE)
+		sta_info_hash_resize(local, tbl->size / 2);
 
-	return -ENOENT;
+	return 0;
 }
 
-/* protected by RCU */
-struct sta_info *sta_info_get(struct ieee80211_sub_if_data *sdata,
-			      const u8 *addr)
+/*
+ * Look up a station in the current table, under RCU or local->sta_mtx.
+ * With @bss the station may also belong to one of the vlans of @sdata,
+ * dummy stations are only returned with @dummy.
+ */
+static struct sta_info *__sta_info_get(struct ieee80211_sub_if_data *sdata,
+				       const u8 *addr, bool bss, bool dummy)
 {
 	struct ieee80211_local *local = sdata->local;
+	struct sta_hash_table *tbl;
 	struct sta_info *sta;
 
-	sta = rcu_dereference_check(local->sta_hash[STA_HASH(addr)],
+	tbl = rcu_dereference_check(local->sta_hash,
+				    lockdep_is_held(&local->sta_mtx));
+	sta = rcu_dereference_check(tbl->buckets[sta_hash_bucket(tbl, addr)],
 				    lockdep_is_held(&local->sta_mtx));
 	while (sta) {
-		if (sta->sdata == sdata && !sta->dummy &&
+		if ((sta->sdata == sdata ||
+		     (bss && sta->sdata->bss &&
+		      sta->sdata->bss == sdata->bss)) &&
+		    (dummy || !sta->dummy) &&
 		    memcmp(sta->sta.addr, addr, ETH_ALEN) == 0)
 			break;
-		sta = rcu_dereference_check(sta->hnext,
+		sta = rcu_dereference_check(sta->hnext[tbl->idx],
 					    lockdep_is_held(&local->sta_mtx));
 	}
 	return sta;
 }
 
+/* protected by RCU */
+struct sta_info *sta_info_get(struct ieee80211_sub_if_data *sdata,
+			      const u8 *addr)
+{
+	return __sta_info_get(sdata, addr, false, false);
+}
+
 /* get a station info entry even if it is a dummy station*/
 struct sta_info *sta_info_get_rx(struct ieee80211_sub_if_data *sdata,
 			      const u8 *addr)
 {
-	struct ieee80211_local *local = sdata->local;
-	struct sta_info *sta;
-
-	sta = rcu_dereference_check(local->sta_hash[STA_HASH(addr)],
-				    lockdep_is_held(&local->sta_mtx));
-	while (sta) {
-		if (sta->sdata == sdata &&
-		    memcmp(sta->sta.addr, addr, ETH_ALEN) == 0)
-			break;
-		sta = rcu_dereference_check(sta->hnext,
-					    lockdep_is_held(&local->sta_mtx));
-	}
-	return sta;
+	return __sta_info_get(sdata, addr, false, true);
 }
 
 /*
@@ -135,21 +208,7 @@ struct sta_info *sta_info_get_rx(struct ieee80211_sub_if_data *sdata,
 struct sta_info *sta_info_get_bss(struct ieee80211_sub_if_data *sdata,
 				  const u8 *addr)
 {
-	struct ieee80211_local *local = sdata->local;
-	struct sta_info *sta;
-
-	sta = rcu_dereference_check(local->sta_hash[STA_HASH(addr)],
-				    lockdep_is_held(&local->sta_mtx));
-	while (sta) {
-		if ((sta->sdata == sdata ||
-		     (sta->sdata->bss && sta->sdata->bss == sdata->bss)) &&
-		    !sta->dummy &&
-		    memcmp(sta->sta.addr, addr, ETH_ALEN) == 0)
-			break;
-		sta = rcu_dereference_check(sta->hnext,
-					    lockdep_is_held(&local->sta_mtx));
-	}
-	return sta;
+	return __sta_info_get(sdata, addr, true, false);
 }
 
 /*
@@ -159,20 +218,7 @@ struct sta_info *sta_info_get_bss(struct ieee80211_sub_if_data *sdata,
 struct sta_info *sta_info_get_bss_rx(struct ieee80211_sub_if_data *sdata,
 				  const u8 *addr)
 {
-	struct ieee80211_local *local = sdata->local;
-	struct sta_info *sta;
-
-	sta = rcu_dereference_check(local->sta_hash[STA_HASH(addr)],
-				    lockdep_is_held(&local->sta_mtx));
-	while (sta) {
-		if ((sta->sdata == sdata ||
-		     (sta->sdata->bss && sta->sdata->bss == sdata->bss)) &&
-		    memcmp(sta->sta.addr, addr, ETH_ALEN) == 0)
-			break;
-		sta = rcu_dereference_check(sta->hnext,
-					    lockdep_is_held(&local->sta_mtx));
-	}
-	return sta;
+	return __sta_info_get(sdata, addr, true, true);
 }
 
 struct sta_info *sta_info_get_by_idx(struct ieee80211_sub_if_data *sdata,
@@ -195,6 +241,46 @@ struct sta_info *sta_info_get_by_idx(struct ieee80211_sub_if_data *sdata,
 	return NULL;
 }
 
+/*
+ * Next station of @sdata after @sta in local->sta_list, or %NULL at the
+ * end of the list. Must be called under RCU.
+ */
+struct sta_info *sta_info_dump_next(struct ieee80211_sub_if_data *sdata,
+				    struct sta_info *sta)
+{
+	list_for_each_entry_continue_rcu(sta, &sdata->local->sta_list, list) {
+		if (sta->sdata == sdata)
+			return sta;
+	}
+
+	return NULL;
+}
+
+/*
+ * First station of @sdata that a dump stopped at @cursor has not reported
+ * yet, or %NULL when it is complete. Must be called under RCU.
+ */
+struct sta_info *sta_info_dump_resume(struct ieee80211_sub_if_data *sdata,
+				      const struct station_dump_cursor *cursor)
+{
+	struct sta_info *sta;
+
+	if (!cursor->idx)
+		return sta_info_get_by_idx(sdata, 0);
+
+	/*
+	 * New stations go to the head of sta_list, so continuing after the
+	 * last one reported neither skips nor repeats any. Only when that one
+	 * is gone as well count from the start again; the generation change
+	 * tells userspace the dump may not be exact.
+	 */
+	sta = sta_info_get_rx(sdata, cursor->mac);
+	if (!sta)
+		return sta_info_get_by_idx(sdata, cursor->idx);
+
+	return sta_info_dump_next(sdata, sta);
+}
+
 /**
  * sta_info_free - free STA
  *
@@ -224,9 +310,19 @@ void sta_info_free(struct ieee80211_local *local, struct sta_info *sta)
 static void sta_info_hash_add(struct ieee80211_local *local,
 			      struct sta_info *sta)
 {
+	struct sta_hash_table *tbl;
+	unsigned int bucket;
+
 	lockdep_assert_held(&local->sta_mtx);
-	sta->hnext = local->sta_hash[STA_HASH(sta->sta.addr)];
-	RCU_INIT_POINTER(local->sta_hash[STA_HASH(sta->sta.addr)], sta);
+
+	tbl = rcu_dereference_protected(local->sta_hash,
+					lockdep_is_held(&local->sta_mtx));
+	bucket = sta_hash_bucket(tbl, sta->sta.addr);
+	RCU_INIT_POINTER(sta->hnext[tbl->idx], tbl->buckets[bucket]);
+	rcu_assign_pointer(tbl->buckets[bucket], sta);
+
+	if (++tbl->count > tbl->size && tbl->size < STA_HASH_MAX_SIZE)
+		sta_info_hash_resize(local, tbl->size * 2);
 }
 
 static void sta_unblock(struct work_struct *wk)
@@ -901,14 +997,31 @@ static void sta_info_cleanup(unsigned long data)
 		  round_jiffies(jiffies + STA_INFO_CLEANUP_INTERVAL));
 }
 
-void sta_info_init(struct ieee80211_local *local)
+int sta_info_init(struct ieee80211_local *local)
 {
+	struct sta_hash_table *tbl;
+
+	tbl = sta_hash_alloc(local, STA_HASH_MIN_SIZE, 0);
+	if (!tbl)
+		return -ENOMEM;
+
+	RCU_INIT_POINTER(local->sta_hash, tbl);
+	atomic_set(&local->sta_hash_resize_pending, 0);
+
 	spin_lock_init(&local->tim_lock);
 	mutex_init(&local->sta_mtx);
 	INIT_LIST_HEAD(&local->sta_list);
 
 	setup_timer(&local->sta_cleanup, sta_info_cleanup,
 		    (unsigned long)local);
+	return 0;
+}
+
+void sta_info_deinit(struct ieee80211_local *local)
+{
+	/* a replaced table may still be waiting to be freed */
+	rcu_barrier();
+	kfree(rcu_dereference_raw(local->sta_hash));
 }
 
 void sta_info_stop(struct ieee80211_local *local)
@@ -965,13 +1078,14 @@ struct ieee80211_sta *ieee80211_find_sta_by_ifaddr(struct ieee80211_hw *hw,
 					       const u8 *addr,
 					       const u8 *localaddr)
 {
-	struct sta_info *sta, *nxt;
+	struct sta_hash_table *tbl;
+	struct sta_info *sta;
 
 	/*
 	 * Just return a random station if localaddr is NULL
 	 * ... first in list.
 	 */
-	for_each_sta_info(hw_to_local(hw), addr, sta, nxt) {
+	for_each_sta_info(hw_to_local(hw), addr, sta, tbl) {
 		if (localaddr &&
 		    compare_ether_addr(sta->sdata->vif.addr, localaddr) != 0)
 			continue;
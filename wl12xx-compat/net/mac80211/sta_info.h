@@ -14,6 +14,8 @@
 #include <linux/if_ether.h>
 #include <linux/workqueue.h>
 #include <linux/average.h>
+#include <linux/jhash.h>
+#include <asm/unaligned.h>
 #include "key.h"
 
 /**
@@ -206,7 +208,8 @@ struct sta_ampdu_mlme {
  * mac80211 is communicating with.
  *
  * @list: global linked list entry
- * @hnext: hash table linked list pointer
+ * @hnext: hash table linked list pointers, the table in use picks one of
+ *	them so the next one can be built while readers walk it
  * @local: pointer to the global information
  * @sdata: virtual interface this station belongs to
  * @ptk: peer key negotiated with this station, if any
@@ -271,7 +274,7 @@ struct sta_ampdu_mlme {
 struct sta_info {
 	/* General information, mostly static */
 	struct list_head list;
-	struct sta_info __rcu *hnext;
+	struct sta_info __rcu *hnext[2];
 	struct ieee80211_local *local;
 	struct ieee80211_sub_if_data *sdata;
 	struct ieee80211_key __rcu *gtk[NUM_DEFAULT_KEYS + NUM_DEFAULT_MGMT_KEYS];
@@ -438,8 +441,46 @@ rcu_dereference_protected_tid_tx(struct sta_info *sta, int tid)
 					 lockdep_is_held(&sta->ampdu_mlme.mtx));
 }
 
-#define STA_HASH_SIZE 256
-#define STA_HASH(sta) (sta[5])
+/*
+ * The station hash table doubles when there are more stations than buckets
+ * and halves when they drop below a quarter, within these bounds.
+ */
+#define STA_HASH_MIN_SIZE	16
+#define STA_HASH_MAX_SIZE	2048
+
+/**
+ * struct sta_hash_table - station hash table
+ *
+ * Written under local->sta_mtx, read under RCU. A resize links all stations
+ * into a new table through their other @hnext pointer, publishes it, and
+ * frees the old one after a grace period; until then there is no further
+ * resize, readers may still be walking the old chains.
+ *
+ * @rcu_head: frees the table once it has been replaced
+ * @local: the owner, to allow the next resize once freed
+ * @size: number of buckets, a power of two
+ * @count: number of stations in the table
+ * @seed: hash seed, random per table
+ * @idx: which of the stations' @hnext pointers chains this table
+ * @buckets: chain heads
+ */
+struct sta_hash_table {
+	struct rcu_head rcu_head;
+	struct ieee80211_local *local;
+	unsigned int size;
+	unsigned int count;
+	u32 seed;
+	u8 idx;
+	struct sta_info __rcu *buckets[0];
+};
+
+static inline unsigned int sta_hash_bucket(const struct sta_hash_table *tbl,
+					   const u8 *addr)
+{
+	return jhash_2words(get_unaligned((const u32 *)addr),
+			    get_unaligned((const u16 *)(addr + 4)),
+			    tbl->seed) & (tbl->size - 1);
+}
 
 
 /* Maximum number of frames to buffer per power saving station per AC */
@@ -472,37 +513,41 @@ static inline
 void for_each_sta_info_type_check(struct ieee80211_local *local,
 				  const u8 *addr,
 				  struct sta_info *sta,
-				  struct sta_info *nxt)
+				  struct sta_hash_table *tbl)
 {
 }
 
-#define for_each_sta_info(local, _addr, _sta, nxt) 			\
+/*
+ * The table is looked up once, a resize in the middle of the walk must not
+ * move us onto the chains of the new one.
+ */
+#define for_each_sta_info(local, _addr, _sta, _tbl)			\
 	for (	/* initialise loop */					\
-		_sta = rcu_dereference(local->sta_hash[STA_HASH(_addr)]),\
-		nxt = _sta ? rcu_dereference(_sta->hnext) : NULL;	\
+		_tbl = rcu_dereference(local->sta_hash),		\
+		_sta = rcu_dereference(					\
+			_tbl->buckets[sta_hash_bucket(_tbl, _addr)]);	\
 		/* typecheck */						\
-		for_each_sta_info_type_check(local, (_addr), _sta, nxt),\
+		for_each_sta_info_type_check(local, (_addr), _sta, _tbl),\
 		/* continue condition */				\
 		_sta;							\
 		/* advance loop */					\
-		_sta = nxt,						\
-		nxt = _sta ? rcu_dereference(_sta->hnext) : NULL	\
+		_sta = rcu_dereference(_sta->hnext[_tbl->idx])		\
 	     )								\
 	/* run code only if address matches and it's not a dummy sta */	\
 	if (memcmp(_sta->sta.addr, (_addr), ETH_ALEN) == 0 &&		\
 		!_sta->dummy)
 
-#define for_each_sta_info_rx(local, _addr, _sta, nxt)			\
+#define for_each_sta_info_rx(local, _addr, _sta, _tbl)			\
 	for (	/* initialise loop */					\
-		_sta = rcu_dereference(local->sta_hash[STA_HASH(_addr)]),\
-		nxt = _sta ? rcu_dereference(_sta->hnext) : NULL;	\
+		_tbl = rcu_dereference(local->sta_hash),		\
+		_sta = rcu_dereference(					\
+			_tbl->buckets[sta_hash_bucket(_tbl, _addr)]);	\
 		/* typecheck */						\
-		for_each_sta_info_type_check(local, (_addr), _sta, nxt),\
+		for_each_sta_info_type_check(local, (_addr), _sta, _tbl),\
 		/* continue condition */				\
 		_sta;							\
 		/* advance loop */					\
-		_sta = nxt,						\
-		nxt = _sta ? rcu_dereference(_sta->hnext) : NULL	\
+		_sta = rcu_dereference(_sta->hnext[_tbl->idx])		\
 	     )								\
 	/* compare address and run code only if it matches */		\
 	if (memcmp(_sta->sta.addr, (_addr), ETH_ALEN) == 0)
@@ -512,6 +557,15 @@ void for_each_sta_info_type_check(struct ieee80211_local *local,
  */
 struct sta_info *sta_info_get_by_idx(struct ieee80211_sub_if_data *sdata,
 				     int idx);
+
+/*
+ * Walk the stations of an interface for a dump that may be resumed later,
+ * see struct station_dump_cursor.
+ */
+struct sta_info *sta_info_dump_resume(struct ieee80211_sub_if_data *sdata,
+				      const struct station_dump_cursor *cursor);
+struct sta_info *sta_info_dump_next(struct ieee80211_sub_if_data *sdata,
+				    struct sta_info *sta);
 /*
  * Create a new STA info, caller owns returned structure
  * until sta_info_insert().
@@ -540,7 +594,8 @@ int sta_info_destroy_addr_bss(struct ieee80211_sub_if_data *sdata,
 
 void sta_info_recalc_tim(struct sta_info *sta);
 
-void sta_info_init(struct ieee80211_local *local);
+int sta_info_init(struct ieee80211_local *local);
+void sta_info_deinit(struct ieee80211_local *local);
 void sta_info_stop(struct ieee80211_local *local);
 int sta_info_flush(struct ieee80211_local *local,
 		   struct ieee80211_sub_if_data *sdata);
@@ -10,6 +10,8 @@
  */
 
 #include <linux/slab.h>
+#include <linux/etherdevice.h>
+#include <linux/ktime.h>
 #include "core.h"
 #include "debugfs.h"
 
@@ -106,6 +108,193 @@ static const struct file_operations ht40allow_map_ops = {
 	.llseek = default_llseek,
 };
 
+/*
+ * A-MSDU deaggregation microbenchmark: synthetic A-MSDUs of 3 to 7 subframes
+ * are taken apart by ieee80211_amsdu_to_8023s(), once in a linear skb and
+ * once with all but the first bytes in a page fragment, like drivers doing
+ * zero-copy RX pass them. Reading the file runs it.
+ */
+#define AMSDU_BENCH_MSDU_LEN	1024
+#define AMSDU_BENCH_MIN		3
+#define AMSDU_BENCH_MAX		7
+#define AMSDU_BENCH_HEAD_LEN	64
+#define AMSDU_BENCH_ITERATIONS	1000
+#define AMSDU_BENCH_ORDER	get_order(AMSDU_BENCH_MAX * \
+					  (sizeof(struct ethhdr) + 8 + \
+					   AMSDU_BENCH_MSDU_LEN + 3))
+
+struct amsdu_bench_result {
+	u64 ns;
+	unsigned int subframes;
+	unsigned int skbs;
+	/* bytes put into buffers of their own, the Ethernet header included */
+	u64 copied;
+};
+
+static int amsdu_bench_build(u8 *buf, int subframes)
+{
+	static const u8 da[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 0x01 };
+	static const u8 sa[ETH_ALEN] = { 0x02, 0, 0, 0, 0, 0x02 };
+	struct ethhdr *eth;
+	int i, len = 0;
+
+	for (i = 0; i < subframes; i++) {
+		len = ALIGN(len, 4);
+		eth = (struct ethhdr *)(buf + len);
+		memcpy(eth->h_dest, da, ETH_ALEN);
+		memcpy(eth->h_source, sa, ETH_ALEN);
+		eth->h_proto = htons(8 + AMSDU_BENCH_MSDU_LEN);
+		len += sizeof(*eth);
+
+		/* RFC1042 encapsulated IPv4 */
+		memcpy(buf + len, rfc1042_header, sizeof(rfc1042_header));
+		buf[len + 6] = ETH_P_IP >> 8;
+		buf[len + 7] = ETH_P_IP & 0xff;
+		memset(buf + len + 8, i, AMSDU_BENCH_MSDU_LEN);
+		len += 8 + AMSDU_BENCH_MSDU_LEN;
+	}
+
+	return len;
+}
+
+static struct sk_buff *amsdu_bench_skb(struct page *page, int len, bool paged)
+{
+	int head = paged ? AMSDU_BENCH_HEAD_LEN : len;
+	struct sk_buff *skb;
+
+	skb = dev_alloc_skb(head);
+	if (!skb)
+		return NULL;
+
+	memcpy(skb_put(skb, head), page_address(page), head);
+	if (paged) {
+		get_page(page);
+		skb_add_rx_frag(skb, 0, page, head, len - head, len - head);
+	}
+
+	return skb;
+}
+
+static int amsdu_bench_run(struct page *page, int subframes, bool paged,
+			   struct amsdu_bench_result *res)
+{
+	struct sk_buff_head list;
+	struct sk_buff *skb, *frame;
+	ktime_t start;
+	int i, len;
+
+	memset(res, 0, sizeof(*res));
+	__skb_queue_head_init(&list);
+	len = amsdu_bench_build(page_address(page), subframes);
+
+	for (i = 0; i < AMSDU_BENCH_ITERATIONS; i++) {
+		skb = amsdu_bench_skb(page, len, paged);
+		if (!skb)
+			return -ENOMEM;
+
+		start = ktime_get();
+		ieee80211_amsdu_to_8023s(skb, &list, NULL,
+					 NL80211_IFTYPE_STATION, 0, false);
+		res->ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (skb_queue_len(&list) != subframes) {
+			__skb_queue_purge(&list);
+			return -EINVAL;
+		}
+
+		/* skb itself is only valid here if it was reused */
+		while ((frame = __skb_dequeue(&list))) {
+			res->subframes++;
+			if (frame != skb) {
+				res->skbs++;
+				if (!skb_cloned(frame))
+					res->copied += skb_headlen(frame);
+			}
+			dev_kfree_skb(frame);
+		}
+	}
+
+	return 0;
+}
+
+/* the benchmark runs on open, reads return its report */
+static int amsdu_bench_open(struct inode *inode, struct file *file)
+{
+	struct amsdu_bench_result res;
+	struct page *page;
+	unsigned int offset = 0, buf_size = PAGE_SIZE;
+	int subframes, paged, err;
+	char *buf;
+
+	buf = kzalloc(buf_size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	page = alloc_pages(GFP_KERNEL | __GFP_COMP, AMSDU_BENCH_ORDER);
+	if (!page) {
+		kfree(buf);
+		return -ENOMEM;
+	}
+
+	offset += scnprintf(buf + offset, buf_size - offset,
+			    "subframes layout ns/subframe skbs/subframe "
+			    "copied/subframe\n");
+
+	for (subframes = AMSDU_BENCH_MIN; subframes <= AMSDU_BENCH_MAX;
+	     subframes++) {
+		for (paged = 0; paged <= 1; paged++) {
+			err = amsdu_bench_run(page, subframes, paged, &res);
+			if (err) {
+				offset += scnprintf(buf + offset,
+						    buf_size - offset,
+						    "%9d %-6s failed: %d\n",
+						    subframes,
+						    paged ? "paged" : "linear",
+						    err);
+				continue;
+			}
+
+			offset += scnprintf(buf + offset, buf_size - offset,
+					    "%9d %-6s %12llu %10u.%02u %15llu\n",
+					    subframes,
+					    paged ? "paged" : "linear",
+					    div_u64(res.ns, res.subframes),
+					    res.skbs / res.subframes,
+					    (res.skbs * 100 / res.subframes) %
+						100,
+					    div_u64(res.copied,
+						    res.subframes));
+		}
+	}
+
+	__free_pages(page, AMSDU_BENCH_ORDER);
+
+	file->private_data = buf;
+	return 0;
+}
+
+static ssize_t amsdu_bench_read(struct file *file, char __user *user_buf,
+				size_t count, loff_t *ppos)
+{
+	char *buf = file->private_data;
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf,
+				       strlen(buf));
+}
+
+static int amsdu_bench_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations amsdu_bench_ops = {
+	.read = amsdu_bench_read,
+	.open = amsdu_bench_open,
+	.release = amsdu_bench_release,
+	.llseek = default_llseek,
+};
+
 #define DEBUGFS_ADD(name)						\
 	debugfs_create_file(#name, S_IRUGO, phyd, &rdev->wiphy, &name## _ops);
 
@@ -118,4 +307,8 @@ void cfg80211_debugfs_rdev_add(struct cfg80211_registered_device *rdev)
 	DEBUGFS_ADD(short_retry_limit);
 	DEBUGFS_ADD(long_retry_limit);
 	DEBUGFS_ADD(ht40allow_map);
+
+	/* root only, every open allocates and splits thousands of A-MSDUs */
+	debugfs_create_file("amsdu_bench", 0400, phyd, &rdev->wiphy,
+			    &amsdu_bench_ops);
 }
@@ -2374,7 +2374,8 @@ nla_put_failure:
 	return false;
 }
 
-static int nl80211_send_station(struct sk_buff *msg, u32 pid, u32 seq,
+static int nl80211_send_station(struct sk_buff *msg,
+				struct netlink_callback *cb, u32 pid, u32 seq,
 				int flags, struct net_device *dev,
 				const u8 *mac_addr, struct station_info *sinfo)
 {
@@ -2385,6 +2386,9 @@ static int nl80211_send_station(struct sk_buff *msg, u32 pid, u32 seq,
 	if (!hdr)
 		return -1;
 
+	if (cb)
+		genl_dump_check_consistent(cb, hdr, &nl80211_fam);
+
 	NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, dev->ifindex);
 	NLA_PUT(msg, NL80211_ATTR_MAC, ETH_ALEN, mac_addr);
 
@@ -2481,6 +2485,82 @@ static int nl80211_send_station(struct sk_buff *msg, u32 pid, u32 seq,
 	return -EMSGSIZE;
 }
 
+/* stations fetched from the driver per dump_stations() call */
+#define NL80211_STA_DUMP_BATCH	32
+
+/* the station dump cursor lives in cb->args[1] to cb->args[4] */
+static void nl80211_sta_cursor_load(struct netlink_callback *cb,
+				    struct station_dump_cursor *cursor)
+{
+	BUILD_BUG_ON(ETH_ALEN > 2 * sizeof(cb->args[0]));
+
+	cursor->idx = cb->args[1];
+	cursor->generation = cb->args[2];
+	memcpy(cursor->mac, &cb->args[3], ETH_ALEN);
+}
+
+static void nl80211_sta_cursor_store(struct netlink_callback *cb,
+				     const struct station_dump_cursor *cursor)
+{
+	cb->args[1] = cursor->idx;
+	cb->args[2] = cursor->generation;
+	memcpy(&cb->args[3], cursor->mac, ETH_ALEN);
+}
+
+/*
+ * Fetch the stations from the driver a batch at a time and send as many
+ * as fit, the cursor then points at the last one sent.
+ */
+static int nl80211_dump_station_batch(struct sk_buff *skb,
+				      struct netlink_callback *cb,
+				      struct cfg80211_registered_device *dev,
+				      struct net_device *netdev)
+{
+	struct station_dump_cursor cursor;
+	struct station_dump_entry *entries;
+	int i, n, err = 0;
+
+	entries = kmalloc(NL80211_STA_DUMP_BATCH * sizeof(*entries),
+			  GFP_KERNEL);
+	if (!entries)
+		return -ENOMEM;
+
+	nl80211_sta_cursor_load(cb, &cursor);
+
+	do {
+		memset(entries, 0, NL80211_STA_DUMP_BATCH * sizeof(*entries));
+		n = dev->ops->dump_stations(&dev->wiphy, netdev, &cursor,
+					    entries, NL80211_STA_DUMP_BATCH);
+		if (n < 0) {
+			err = n;
+			goto out;
+		}
+
+		for (i = 0; i < n; i++) {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,1,0))
+			/* flags the dump as interrupted if the list changed */
+			cb->seq = entries[i].sinfo.generation;
+#endif
+
+			if (nl80211_send_station(skb, cb,
+					NETLINK_CB_PID,
+					cb->nlh->nlmsg_seq, NLM_F_MULTI,
+					netdev, entries[i].mac,
+					&entries[i].sinfo) < 0)
+				goto out;
+
+			cursor.idx++;
+			cursor.generation = entries[i].sinfo.generation;
+			memcpy(cursor.mac, entries[i].mac, ETH_ALEN);
+		}
+	} while (n == NL80211_STA_DUMP_BATCH);
+
+ out:
+	nl80211_sta_cursor_store(cb, &cursor);
+	kfree(entries);
+	return err;
+}
+
 static int nl80211_dump_station(struct sk_buff *skb,
 				struct netlink_callback *cb)
 {
@@ -2495,6 +2575,13 @@ static int nl80211_dump_station(struct sk_buff *skb,
 	if (err)
 		return err;
 
+	if (dev->ops->dump_stations) {
+		err = nl80211_dump_station_batch(skb, cb, dev, netdev);
+		if (!err)
+			err = skb->len;
+		goto out_err;
+	}
+
 	if (!dev->ops->dump_station) {
 		err = -EOPNOTSUPP;
 		goto out_err;
@@ -2509,7 +2596,7 @@ static int nl80211_dump_station(struct sk_buff *skb,
 		if (err)
 			goto out_err;
 
-		if (nl80211_send_station(skb,
+		if (nl80211_send_station(skb, NULL,
 				NETLINK_CB_PID,
 				cb->nlh->nlmsg_seq, NLM_F_MULTI,
 				netdev, mac_addr,
@@ -2556,7 +2643,7 @@ static int nl80211_get_station(struct sk_buff *skb, struct genl_info *info)
 	if (!msg)
 		return -ENOMEM;
 
-	if (nl80211_send_station(msg, INFO_SND_PID, info->snd_seq, 0,
+	if (nl80211_send_station(msg, NULL, INFO_SND_PID, info->snd_seq, 0,
 				 dev, mac_addr, &sinfo) < 0) {
 		nlmsg_free(msg);
 		return -ENOBUFS;
@@ -7636,7 +7723,7 @@ void nl80211_send_sta_event(struct cfg80211_registered_device *rdev,
 	if (!msg)
 		return;
 
-	if (nl80211_send_station(msg, 0, 0, 0, dev, mac_addr, sinfo) < 0) {
+	if (nl80211_send_station(msg, NULL, 0, 0, 0, dev, mac_addr, sinfo) < 0) {
 		nlmsg_free(msg);
 		return;
 	}
@@ -538,17 +538,125 @@ int ieee80211_data_from_8023(struct sk_buff *skb, const u8 *addr,
 EXPORT_SYMBOL(ieee80211_data_from_8023);
 
 
+/*
+ * Bytes of a subframe copied into the head of a new skb when the rest of it
+ * stays in the page fragments, enough for the protocol headers.
+ */
+#define AMSDU_SUBFRAME_HEAD_LEN	32
+
+/*
+ * Subframes of a linear A-MSDU up to this size are copied, a clone would
+ * keep the whole buffer pinned and charged for a few bytes of payload.
+ */
+#define AMSDU_SUBFRAME_COPY_LEN	256
+
+/*
+ * Make an skb of the @len bytes at @offset, without copying the payload
+ * where that pays off: larger subframes of a linear A-MSDU are clones
+ * sharing its buffer, those of a paged one get their first bytes copied and
+ * the pages referenced. Each keeps the truesize of the memory it holds on
+ * to, the whole buffer for a clone, its share of the A-MSDU for fragments.
+ *
+ * The caller writes the Ethernet header of a clone into the shared buffer,
+ * over the A-MSDU subframe header in front of @offset and the LLC header
+ * after it. That is safe because the regions are disjoint: a clone only
+ * writes the headers of its own subframe, which the caller has copied out
+ * before, and no other subframe covers them.
+ */
+static struct sk_buff *
+__ieee80211_amsdu_subframe(struct sk_buff *skb, unsigned int hlen,
+			   int offset, int len)
+{
+	struct skb_shared_info *sh = skb_shinfo(skb);
+	struct sk_buff *frame;
+	const skb_frag_t *frag;
+	int head, frag_offset, start, size, i;
+
+	if (!skb_is_nonlinear(skb) && len > AMSDU_SUBFRAME_COPY_LEN) {
+		frame = skb_clone(skb, GFP_ATOMIC);
+		if (!frame)
+			return NULL;
+
+		skb_pull(frame, offset);
+		skb_trim(frame, len);
+		return frame;
+	}
+
+	/*
+	 * Copy what is in the linear part anyway, but at least the first
+	 * bytes. A frag list is not worth walking, copy it all then.
+	 */
+	if (skb_has_frag_list(skb))
+		head = len;
+	else
+		head = min_t(int, len, max_t(int, AMSDU_SUBFRAME_HEAD_LEN,
+					     skb_headlen(skb) - offset));
+
+	/*
+	 * Allocate and reserve two bytes more for payload
+	 * alignment since sizeof(struct ethhdr) is 14.
+	 */
+	frame = dev_alloc_skb(hlen + sizeof(struct ethhdr) + 2 + head);
+	if (!frame)
+		return NULL;
+
+	skb_reserve(frame, hlen + sizeof(struct ethhdr) + 2);
+	if (skb_copy_bits(skb, offset, skb_put(frame, head), head))
+		goto err;
+
+	offset += head;
+	len -= head;
+
+	/* what is left lies past the linear part */
+	frag_offset = skb_headlen(skb);
+	for (i = 0; len > 0 && i < sh->nr_frags; i++) {
+		frag = &sh->frags[i];
+		size = skb_frag_size(frag);
+
+		if (offset >= frag_offset + size) {
+			frag_offset += size;
+			continue;
+		}
+
+		if (skb_shinfo(frame)->nr_frags == MAX_SKB_FRAGS)
+			goto err;
+
+		start = offset - frag_offset;
+		size = min_t(int, len, size - start);
+
+		get_page(skb_frag_page(frag));
+		skb_add_rx_frag(frame, skb_shinfo(frame)->nr_frags,
+				skb_frag_page(frag), frag->page_offset + start,
+				size, div_u64((u64)size * skb->truesize,
+					      skb->len));
+
+		offset += size;
+		len -= size;
+		frag_offset += skb_frag_size(frag);
+	}
+
+	if (len)
+		goto err;
+
+	return frame;
+
+ err:
+	dev_kfree_skb(frame);
+	return NULL;
+}
+
 void ieee80211_amsdu_to_8023s(struct sk_buff *skb, struct sk_buff_head *list,
 			      const u8 *addr, enum nl80211_iftype iftype,
 			      const unsigned int extra_headroom,
 			      bool has_80211_header)
 {
+	unsigned int hlen = ALIGN(extra_headroom, 4);
 	struct sk_buff *frame = NULL;
 	u16 ethertype;
 	u8 *payload;
-	const struct ethhdr *eth;
-	int remaining, err;
-	u8 dst[ETH_ALEN], src[ETH_ALEN];
+	struct ethhdr eth;
+	int offset = 0, remaining, err;
+	bool last = false;
 
 	if (has_80211_header) {
 		err = ieee80211_data_to_8023(skb, addr, iftype);
@@ -556,57 +664,48 @@ void ieee80211_amsdu_to_8023s(struct sk_buff *skb, struct sk_buff_head *list,
 			goto out;
 
 		/* skip the wrapping header */
-		eth = (struct ethhdr *) skb_pull(skb, sizeof(struct ethhdr));
-		if (!eth)
+		if (!skb_pull(skb, sizeof(struct ethhdr)))
 			goto out;
-	} else {
-		eth = (struct ethhdr *) skb->data;
 	}
 
-	while (skb != frame) {
+	while (!last) {
 		u8 padding;
-		__be16 len = eth->h_proto;
-		unsigned int subframe_len = sizeof(struct ethhdr) + ntohs(len);
+		int len;
+		unsigned int subframe_len;
 
-		remaining = skb->len;
-		memcpy(dst, eth->h_dest, ETH_ALEN);
-		memcpy(src, eth->h_source, ETH_ALEN);
+		if (skb_copy_bits(skb, offset, &eth, sizeof(eth)))
+			goto purge;
+
+		len = ntohs(eth.h_proto);
+		subframe_len = sizeof(struct ethhdr) + len;
+		remaining = skb->len - offset;
 
 		padding = (4 - subframe_len) & 0x3;
 		/* the last MSDU has no padding */
 		if (subframe_len > remaining)
 			goto purge;
 
-		skb_pull(skb, sizeof(struct ethhdr));
+		offset += sizeof(struct ethhdr);
+		last = remaining <= subframe_len + padding;
+
 		/* reuse skb for the last subframe */
-		if (remaining <= subframe_len + padding)
+		if (last && !skb_is_nonlinear(skb)) {
+			skb_pull(skb, offset);
 			frame = skb;
-		else {
-			unsigned int hlen = ALIGN(extra_headroom, 4);
-			/*
-			 * Allocate and reserve two bytes more for payload
-			 * alignment since sizeof(struct ethhdr) is 14.
-			 */
-			frame = dev_alloc_skb(hlen + subframe_len + 2);
+		} else {
+			frame = __ieee80211_amsdu_subframe(skb, hlen, offset,
+							   len);
 			if (!frame)
 				goto purge;
 
-			skb_reserve(frame, hlen + sizeof(struct ethhdr) + 2);
-			memcpy(skb_put(frame, ntohs(len)), skb->data,
-				ntohs(len));
-
-			eth = (struct ethhdr *)skb_pull(skb, ntohs(len) +
-							padding);
-			if (!eth) {
-				dev_kfree_skb(frame);
-				goto purge;
-			}
+			offset += len + padding;
 		}
 
 		skb_reset_network_header(frame);
 		frame->dev = skb->dev;
 		frame->priority = skb->priority;
 
+		/* clones: see __ieee80211_amsdu_subframe() */
 		payload = frame->data;
 		ethertype = (payload[6] << 8) | payload[7];
 
@@ -617,17 +716,23 @@ void ieee80211_amsdu_to_8023s(struct sk_buff *skb, struct sk_buff_head *list,
 			/* remove RFC1042 or Bridge-Tunnel
 			 * encapsulation and replace EtherType */
 			skb_pull(frame, 6);
-			memcpy(skb_push(frame, ETH_ALEN), src, ETH_ALEN);
-			memcpy(skb_push(frame, ETH_ALEN), dst, ETH_ALEN);
+			memcpy(skb_push(frame, ETH_ALEN), eth.h_source,
+			       ETH_ALEN);
+			memcpy(skb_push(frame, ETH_ALEN), eth.h_dest, ETH_ALEN);
 		} else {
-			memcpy(skb_push(frame, sizeof(__be16)), &len,
+			memcpy(skb_push(frame, sizeof(__be16)), &eth.h_proto,
 				sizeof(__be16));
-			memcpy(skb_push(frame, ETH_ALEN), src, ETH_ALEN);
-			memcpy(skb_push(frame, ETH_ALEN), dst, ETH_ALEN);
+			memcpy(skb_push(frame, ETH_ALEN), eth.h_source,
+			       ETH_ALEN);
+			memcpy(skb_push(frame, ETH_ALEN), eth.h_dest, ETH_ALEN);
 		}
 		__skb_queue_tail(list, frame);
 	}
 
+	/* the frames hold their own references to a paged A-MSDU */
+	if (frame != skb)
+		dev_kfree_skb(skb);
+
 	return;
 
  purge: